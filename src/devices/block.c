@@ -1,9 +1,17 @@
 #include "devices/block.h"
 #include <list.h>
+#include <rusage.h>
 #include <string.h>
 #include <stdio.h>
+#include <vtime.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* A block device. */
 struct block
@@ -19,6 +27,15 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+
+    /* Detailed statistics.  Updated with interrupts off, since
+       requests complete in interrupt handlers. */
+    unsigned long long request_cnt;     /* Number of requests. */
+    unsigned long long sequential_cnt;  /* Requests continuing the last. */
+    block_sector_t next_sector;         /* Sector after the last request. */
+    unsigned long long queue_cycles;    /* Time requests spent queued. */
+    unsigned long long busy_cycles;     /* Time requests took in all. */
+    unsigned long long latency[IOSTAT_BUCKETS]; /* Latency histogram. */
   };
 
 /* List of all block devices. */
@@ -27,7 +44,19 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
+/* Kernel page through which transfers to and from user memory
+   are bounced, since drivers reach their buffers from interrupt
+   handlers, under whatever page directory is active then.
+   Allocated when the first block device is registered. */
+static uint8_t *bounce_page;
+static struct lock bounce_lock;
+
 static struct block *list_elem_to_block (struct list_elem *);
+static void transfer (struct block *, block_sector_t, size_t cnt,
+                      void *buffer, bool write);
+static void start_bio (struct block *, struct bio *);
+static void bounce_transfer (struct block *, block_sector_t, size_t cnt,
+                             uint8_t *buffer, bool write);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -113,6 +142,58 @@ check_sector (struct block *block, block_sector_t sector)
     }
 }
 
+/* Records a request to transfer CNT sectors starting at SECTOR
+   in BLOCK's statistics. */
+static void
+account_request (struct block *block, block_sector_t sector, size_t cnt,
+                 bool write)
+{
+  enum intr_level old_level = intr_disable ();
+  if (write)
+    block->write_cnt += cnt;
+  else
+    block->read_cnt += cnt;
+  block->request_cnt++;
+  if (sector == block->next_sector)
+    block->sequential_cnt++;
+  block->next_sector = sector + cnt;
+  intr_set_level (old_level);
+
+  /* Charge the thread that asked for the transfer.  Requests
+     submitted from interrupt context belong to no thread. */
+  if (!intr_context ())
+    {
+      struct rusage *ru = thread_rusage ();
+      if (ru != NULL)
+        {
+          if (write)
+            ru->block_writes += cnt;
+          else
+            ru->block_reads += cnt;
+        }
+    }
+}
+
+/* Records in BLOCK's statistics that a request submitted at
+   timestamp SUBMITTED, and started by the driver at STARTED, has
+   just completed. */
+static void
+account_time (struct block *block, uint64_t submitted, uint64_t started)
+{
+  uint64_t latency = vtime_rdtsc () - submitted;
+  enum intr_level old_level;
+  int bucket = 0;
+
+  while (bucket < IOSTAT_BUCKETS - 1 && (latency >> (bucket + 1)) != 0)
+    bucket++;
+
+  old_level = intr_disable ();
+  block->queue_cycles += started - submitted;
+  block->busy_cycles += latency;
+  block->latency[bucket]++;
+  intr_set_level (old_level);
+}
+
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
@@ -121,8 +202,7 @@ void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer (block, sector, 1, buffer, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -135,8 +215,215 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  transfer (block, sector, 1, (void *) buffer, true);
+}
+
+/* Has BLOCK's driver read CNT sectors starting at SECTOR into
+   BUFFER, in one request if the driver supports it. */
+static void
+read_sectors (struct block *block, block_sector_t sector, size_t cnt,
+              void *buffer_)
+{
+  uint8_t *buffer = buffer_;
+  size_t i;
+
+  if (block->ops->read_multiple != NULL)
+    block->ops->read_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->read (block->aux, sector + i,
+                        buffer + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Has BLOCK's driver write CNT sectors starting at SECTOR from
+   BUFFER, in one request if the driver supports it. */
+static void
+write_sectors (struct block *block, block_sector_t sector, size_t cnt,
+               const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+  size_t i;
+
+  if (block->ops->write_multiple != NULL)
+    block->ops->write_multiple (block->aux, sector, cnt, buffer);
+  else
+    for (i = 0; i < cnt; i++)
+      block->ops->write (block->aux, sector + i,
+                         buffer + i * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads CNT consecutive sectors starting at SECTOR from BLOCK
+   into BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it do so in a single request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                     void *buffer)
+{
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  transfer (block, sector, cnt, buffer, false);
+}
+
+/* Writes CNT consecutive sectors starting at SECTOR to BLOCK
+   from BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving the
+   data.  Drivers that support it do so in a single request.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector, size_t cnt,
+                      const void *buffer)
+{
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  transfer (block, sector, cnt, (void *) buffer, true);
+}
+
+/* Submits BIO, whose sector is relative to BLOCK, and returns
+   without waiting for it if BLOCK's driver can queue requests.
+   BIO->DONE is called when the transfer completes.  BIO->SECTOR
+   may be changed in the process, e.g. translated by a
+   partition.  BIO->BUFFER must be in kernel virtual memory. */
+void
+block_submit (struct block *block, struct bio *bio)
+{
+  ASSERT (bio->cnt > 0 && bio->cnt <= BIO_MAX_SECTORS);
+  ASSERT (is_kernel_vaddr (bio->buffer));
+  check_sector (block, bio->sector);
+  check_sector (block, bio->sector + bio->cnt - 1);
+  ASSERT (!bio->write || block->type != BLOCK_FOREIGN);
+
+  account_request (block, bio->sector, bio->cnt, bio->write);
+  start_bio (block, bio);
+}
+
+/* Called by a driver when it starts carrying out BIO. */
+void
+block_started (struct bio *bio)
+{
+  bio->started = vtime_rdtsc ();
+}
+
+/* Called by a driver when BIO has completed.  Accounts for the
+   time BIO took and calls BIO->DONE.  Drivers may also pass
+   requests of their own that did not come through the block
+   layer, provided that BIO->BLOCK is null. */
+void
+block_complete (struct bio *bio)
+{
+  if (bio->block != NULL)
+    account_time (bio->block, bio->submitted, bio->started);
+  bio->done (bio);
+}
+
+/* Stamps BIO as submitted to BLOCK and hands it to BLOCK's
+   driver, or carries it out synchronously if the driver cannot
+   queue requests. */
+static void
+start_bio (struct block *block, struct bio *bio)
+{
+  bio->block = block;
+  bio->submitted = bio->started = vtime_rdtsc ();
+  if (block->ops->submit != NULL)
+    block->ops->submit (block->aux, bio);
+  else
+    {
+      if (bio->write)
+        write_sectors (block, bio->sector, bio->cnt, bio->buffer);
+      else
+        read_sectors (block, bio->sector, bio->cnt, bio->buffer);
+      block_complete (bio);
+    }
+}
+
+/* Completion function for synchronous requests: wakes up the
+   thread waiting on the semaphore in BIO->AUX. */
+static void
+wake_waiter (struct bio *bio)
+{
+  sema_up (bio->aux);
+}
+
+/* Transfers CNT sectors starting at SECTOR between BLOCK and
+   BUFFER, writing to BLOCK if WRITE is true, and waits for the
+   transfer to complete.  Goes through the driver's request queue
+   when it has one, so that synchronous requests are timed like
+   asynchronous ones.  A BUFFER in user memory is bounced through
+   a kernel page, so drivers only ever see kernel buffers. */
+static void
+transfer (struct block *block, block_sector_t sector, size_t cnt,
+          void *buffer_, bool write)
+{
+  uint8_t *buffer = buffer_;
+
+  if (!is_kernel_vaddr (buffer))
+    {
+      bounce_transfer (block, sector, cnt, buffer, write);
+      return;
+    }
+
+  account_request (block, sector, cnt, write);
+  if (block->ops->submit != NULL)
+    while (cnt > 0)
+      {
+        struct semaphore done;
+        struct bio bio;
+
+        sema_init (&done, 0);
+        bio.sector = sector;
+        bio.cnt = cnt < BIO_MAX_SECTORS ? cnt : BIO_MAX_SECTORS;
+        bio.buffer = buffer;
+        bio.write = write;
+        bio.done = wake_waiter;
+        bio.aux = &done;
+        start_bio (block, &bio);
+        sema_down (&done);
+
+        buffer += bio.cnt * BLOCK_SECTOR_SIZE;
+        sector += bio.cnt;
+        cnt -= bio.cnt;
+      }
+  else
+    {
+      uint64_t start = vtime_rdtsc ();
+      if (write)
+        write_sectors (block, sector, cnt, buffer);
+      else
+        read_sectors (block, sector, cnt, buffer);
+      account_time (block, start, start);
+    }
+}
+
+/* Transfers CNT sectors starting at SECTOR between BLOCK and
+   user BUFFER a page at a time through BOUNCE_PAGE. */
+static void
+bounce_transfer (struct block *block, block_sector_t sector, size_t cnt,
+                 uint8_t *buffer, bool write)
+{
+  lock_acquire (&bounce_lock);
+  while (cnt > 0)
+    {
+      size_t n = cnt < PGSIZE / BLOCK_SECTOR_SIZE
+                 ? cnt : PGSIZE / BLOCK_SECTOR_SIZE;
+
+      if (write)
+        memcpy (bounce_page, buffer, n * BLOCK_SECTOR_SIZE);
+      transfer (block, sector, n, bounce_page, write);
+      if (!write)
+        memcpy (buffer, bounce_page, n * BLOCK_SECTOR_SIZE);
+
+      buffer += n * BLOCK_SECTOR_SIZE;
+      sector += n;
+      cnt -= n;
+    }
+  lock_release (&bounce_lock);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -160,15 +447,102 @@ block_type (struct block *block)
   return block->type;
 }
 
-/* Prints statistics for each block device used for a Pintos role. */
+/* Copies BLOCK's statistics into ST. */
+static void
+get_stats (struct block *block, struct iostat *st)
+{
+  enum intr_level old_level;
+
+  memset (st, 0, sizeof *st);
+  strlcpy (st->name, block->name, sizeof st->name);
+  strlcpy (st->type, block_type_name (block->type), sizeof st->type);
+  st->cycles_per_ms = timer_tsc_per_tick () * TIMER_FREQ / 1000;
+
+  old_level = intr_disable ();
+  st->read_bytes = block->read_cnt * BLOCK_SECTOR_SIZE;
+  st->write_bytes = block->write_cnt * BLOCK_SECTOR_SIZE;
+  st->requests = block->request_cnt;
+  st->sequential = block->sequential_cnt;
+  st->queue_cycles = block->queue_cycles;
+  st->busy_cycles = block->busy_cycles;
+  memcpy (st->latency, block->latency, sizeof st->latency);
+  intr_set_level (old_level);
+}
+
+/* Stores statistics for the block device with index IDX in
+   kernel probe order into ST.  Returns false if there are no
+   more than IDX block devices. */
+bool
+block_get_stats (int idx, struct iostat *st)
+{
+  struct block *block;
+
+  for (block = block_first (); block != NULL; block = block_next (block))
+    if (idx-- == 0)
+      {
+        get_stats (block, st);
+        return true;
+      }
+  return false;
+}
+
+/* Converts CYCLES to microseconds at CPM cycles per
+   millisecond, rounding up. */
+static unsigned long long
+cycles_to_us (uint64_t cycles, uint64_t cpm)
+{
+  return (cycles * 1000 + cpm - 1) / cpm;
+}
+
+/* Prints the latency histogram and other detailed statistics
+   for BLOCK, which must have done some I/O. */
+static void
+print_detailed_stats (struct block *block)
+{
+  struct iostat st;
+  unsigned long long completed = 0;
+  int i;
+
+  get_stats (block, &st);
+  printf ("%s: %llu requests, %llu%% sequential, ",
+          st.name, st.requests, st.sequential * 100 / st.requests);
+  print_human_readable_size (st.read_bytes);
+  printf (" read, ");
+  print_human_readable_size (st.write_bytes);
+  printf (" written\n");
+
+  for (i = 0; i < IOSTAT_BUCKETS; i++)
+    completed += st.latency[i];
+  if (completed == 0 || st.cycles_per_ms == 0)
+    return;
+  printf ("%s: average latency %llu us, of which %llu us queued\n",
+          st.name,
+          cycles_to_us (st.busy_cycles / completed, st.cycles_per_ms),
+          cycles_to_us (st.queue_cycles / completed, st.cycles_per_ms));
+  for (i = 0; i < IOSTAT_BUCKETS; i++)
+    if (st.latency[i] != 0)
+      {
+        if (i < IOSTAT_BUCKETS - 1)
+          printf ("  under %6llu us: %llu\n",
+                  cycles_to_us (2ULL << i, st.cycles_per_ms), st.latency[i]);
+        else
+          printf ("  %llu us or more: %llu\n",
+                  cycles_to_us (1ULL << i, st.cycles_per_ms), st.latency[i]);
+      }
+}
+
+/* Prints statistics for each block device used for a Pintos
+   role, then detailed statistics for each block device that has
+   done any I/O. */
 void
 block_print_stats (void)
 {
+  struct block *block;
   int i;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
-      struct block *block = block_by_role[i];
+      block = block_by_role[i];
       if (block != NULL)
         {
           printf ("%s (%s): %llu reads, %llu writes\n",
@@ -176,6 +550,10 @@ block_print_stats (void)
                   block->read_cnt, block->write_cnt);
         }
     }
+
+  for (block = block_first (); block != NULL; block = block_next (block))
+    if (block->request_cnt != 0)
+      print_detailed_stats (block);
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -188,18 +566,22 @@ block_register (const char *name, enum block_type type,
                 const char *extra_info, block_sector_t size,
                 const struct block_operations *ops, void *aux)
 {
-  struct block *block = malloc (sizeof *block);
+  struct block *block = calloc (1, sizeof *block);
   if (block == NULL)
     PANIC ("Failed to allocate memory for block device descriptor");
 
+  if (list_empty (&all_blocks))
+    {
+      bounce_page = palloc_get_page (PAL_ASSERT);
+      lock_init (&bounce_lock);
+    }
+
   list_push_back (&all_blocks, &block->list_elem);
   strlcpy (block->name, name, sizeof block->name);
   block->type = type;
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
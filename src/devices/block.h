@@ -3,6 +3,9 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <iostat.h>
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,22 +56,75 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, size_t cnt,
+                          void *);
+void block_write_multiple (struct block *, block_sector_t, size_t cnt,
+                           const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Most sectors in one asynchronous request. */
+#define BIO_MAX_SECTORS 256
+
+/* An asynchronous request to transfer CNT consecutive sectors
+   starting at SECTOR between a block device and BUFFER.  The
+   submitter fills in the first group of members and must keep
+   the request and BUFFER alive until DONE is called.  DONE may
+   run in an interrupt handler, so it must not sleep.
+
+   Drivers call block_started() when they hand a request to the
+   hardware and block_complete(), instead of DONE directly, when
+   it finishes, so that the block layer can account for its
+   time. */
+struct bio
+  {
+    block_sector_t sector;      /* First sector, relative to device. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    bool write;                 /* True to write, false to read. */
+    void (*done) (struct bio *); /* Completion function. */
+    void *aux;                  /* For use by DONE. */
+
+    /* Owned by the driver. */
+    struct list_elem elem;      /* Element in a request queue. */
+    void *driver;               /* Device handling the request. */
+    int64_t deadline;           /* Tick by which to serve request. */
+
+    /* Owned by the block layer. */
+    struct block *block;        /* Device accounting for the request. */
+    uint64_t submitted;         /* Timestamp when submitted. */
+    uint64_t started;           /* Timestamp when the driver started it. */
+  };
+
+void block_submit (struct block *, struct bio *);
+
 /* Statistics. */
 void block_print_stats (void);
+bool block_get_stats (int idx, struct iostat *);
 
 /* Lower-level interface to block device drivers. */
 
+/* READ_MULTIPLE and WRITE_MULTIPLE transfer CNT consecutive
+   sectors in one request.  Drivers that cannot do better may
+   leave them null, in which case the block layer loops over
+   READ and WRITE.  SUBMIT queues a request without waiting for
+   it; without it, the block layer performs the transfer
+   synchronously and then completes the request. */
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+    void (*read_multiple) (void *aux, block_sector_t, size_t cnt,
+                           void *buffer);
+    void (*write_multiple) (void *aux, block_sector_t, size_t cnt,
+                            const void *buffer);
+    void (*submit) (void *aux, struct bio *);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_started (struct bio *);
+void block_complete (struct bio *);
 
 #endif /* devices/block.h */
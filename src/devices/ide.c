@@ -5,13 +5,29 @@
 #include <stdio.h>
 #include "devices/block.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  When the
+   controller is a PCI bus-master IDE function, such as the PIIX
+   that QEMU emulates, data is moved by DMA; otherwise, and for
+   buffers whose physical address is unknown, by PIO.
+
+   Requests are queued per channel and run one command at a
+   time.  Whenever the channel goes idle, the next command is
+   chosen by a C-LOOK elevator: the lowest request at or past the
+   end of the previous command, wrapping around to the lowest
+   overall.  A request that has waited past its deadline goes
+   first instead.  Queued requests that continue the chosen one
+   on the same disk, in the same direction, join its command.
+   Commands are started and completed from the interrupt
+   handler, so submitters never wait for the channel. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -30,10 +46,24 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus-master IDE port addresses. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD table. */
+
+/* Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus-master Status Register bits. */
+#define BM_STA_ERROR 0x02       /* Transfer failed (write 1 to clear). */
+#define BM_STA_IRQ 0x04         /* Interrupt raised (write 1 to clear). */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +79,34 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* PCI class and subclass of an IDE controller. */
+#define PCI_CLASS_STORAGE 0x01
+#define PCI_SUBCLASS_IDE 0x01
+
+/* IDE programming interface bit for bus-master support. */
+#define PCI_IDE_BUS_MASTER 0x80
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus-master controller where to move data. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address of region. */
+    uint16_t size;              /* Bytes in region, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
+/* Most sectors that one command can transfer. */
+#define MAX_SECTORS_PER_CMD BIO_MAX_SECTORS
+
+/* Ticks a request may wait before it is served out of order. */
+#define IDE_DEADLINE (TIMER_FREQ / 2)
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +115,9 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    size_t block_sectors;       /* Sectors per interrupt, >1 if
+                                   READ/WRITE MULTIPLE is enabled. */
+    bool dma;                   /* Transfer by bus-master DMA? */
   };
 
 /* An ATA channel (aka controller).
@@ -66,12 +127,23 @@ struct channel
     char name[8];               /* Name, e.g. "ide0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus-master I/O port, 0 if none. */
+    struct prd *prd_table;      /* Bus-master PRD table. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
 
+    /* Request queue, protected by disabling interrupts. */
+    struct list queue;          /* Pending requests, oldest first. */
+    struct list active;         /* Requests in the running command. */
+    struct ata_disk *active_disk; /* Disk running a command, or null. */
+    bool active_write;          /* Is the running command a write? */
+    bool active_dma;            /* Is it using DMA? */
+    size_t active_cnt;          /* Sectors in the running command. */
+    size_t active_done;         /* Sectors moved so far by PIO. */
+    block_sector_t head;        /* Sector after the last command. */
+
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
 
@@ -84,14 +156,19 @@ static struct block_operations ide_operations;
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
+static void set_multiple_mode (struct ata_disk *, size_t block_sectors);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sectors (struct ata_disk *, block_sector_t, size_t cnt);
+static void start_command (struct channel *);
+static void finish_command (struct channel *);
+static void command_interrupt (struct channel *);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
 
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
+static bool wait_for_drq (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
@@ -101,8 +178,19 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  struct pci_dev pci;
+  uint16_t bm_base = 0;
   size_t chan_no;
 
+  /* Look for a bus-master IDE controller. */
+  if (pci_find_class (PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0, &pci)
+      && (pci.prog_if & PCI_IDE_BUS_MASTER))
+    {
+      bm_base = pci_read_io_bar (&pci, 4);
+      if (bm_base != 0)
+        pci_enable_bus_master (&pci);
+    }
+
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -123,9 +211,20 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      c->bm_base = 0;
+      c->prd_table = NULL;
+      if (bm_base != 0)
+        {
+          c->prd_table = palloc_get_page (0);
+          if (c->prd_table != NULL)
+            c->bm_base = bm_base + chan_no * 8;
+        }
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      list_init (&c->queue);
+      list_init (&c->active);
+      c->active_disk = NULL;
+      c->head = 0;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +235,8 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->block_sectors = 1;
+          d->dma = false;
         }
 
       /* Register interrupt handler. */
@@ -279,15 +380,18 @@ identify_ata_device (struct ata_disk *d)
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sectors (c, id, 1);
 
   /* Calculate capacity.
-     Read model name and serial number. */
+     Read model name and serial number.
+     Use DMA if both the controller and the disk support it. */
   capacity = *(uint32_t *) &id[60 * 2];
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
+  d->dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100) != 0;
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\"%s", model, serial,
+            d->dma ? ", DMA" : "");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -303,12 +407,36 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
 
+  /* Transfer as many sectors per interrupt as the disk allows. */
+  set_multiple_mode (d, (uint8_t) id[47 * 2]);
+
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
   partition_scan (block);
 }
 
+/* Enables READ MULTIPLE and WRITE MULTIPLE on disk D with
+   BLOCK_SECTORS sectors per interrupt.  Leaves D transferring a
+   sector per interrupt if BLOCK_SECTORS is less than 2 or the
+   disk rejects the command. */
+static void
+set_multiple_mode (struct ata_disk *d, size_t block_sectors)
+{
+  struct channel *c = d->channel;
+
+  if (block_sectors < 2)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), block_sectors);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if ((inb (reg_status (c)) & STA_ERR) == 0)
+    d->block_sectors = block_sectors;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,63 +465,126 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Queues BIO, whose CNT must not exceed MAX_SECTORS_PER_CMD,
+   on disk D's channel and returns at once.  BIO->DONE is called
+   from the interrupt handler when the transfer completes.
+   BIO->BUFFER must be in kernel virtual memory, since the
+   transfer may run from an interrupt handler in any process's
+   address space. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_submit (void *d_, struct bio *bio)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  enum intr_level old_level;
+
+  ASSERT (bio->cnt > 0 && bio->cnt <= MAX_SECTORS_PER_CMD);
+  ASSERT (is_kernel_vaddr (bio->buffer));
+
+  bio->driver = d;
+  bio->deadline = timer_ticks () + IDE_DEADLINE;
+  old_level = intr_disable ();
+  list_push_back (&c->queue, &bio->elem);
+  if (c->active_disk == NULL)
+    start_command (c);
+  intr_set_level (old_level);
+}
+
+/* Completion function for synchronous requests: wakes up the
+   thread waiting on the semaphore in BIO->AUX. */
+static void
+wake_waiter (struct bio *bio)
+{
+  sema_up (bio->aux);
+}
+
+/* Transfers CNT sectors starting at SEC_NO between disk D and
+   BUFFER, writing to the disk if WRITE is true, through the
+   request queue.  Waits for the transfer to complete. */
+static void
+ide_transfer (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+              void *buffer, bool write)
+{
+  while (cnt > 0)
+    {
+      struct semaphore done;
+      struct bio bio;
+
+      sema_init (&done, 0);
+      bio.sector = sec_no;
+      bio.cnt = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      bio.buffer = buffer;
+      bio.write = write;
+      bio.done = wake_waiter;
+      bio.aux = &done;
+      bio.block = NULL;
+      ide_submit (d, &bio);
+      sema_down (&done);
+
+      buffer = (uint8_t *) buffer + bio.cnt * BLOCK_SECTOR_SIZE;
+      sec_no += bio.cnt;
+      cnt -= bio.cnt;
+    }
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes. */
+static void
+ide_read_multiple (void *d, block_sector_t sec_no, size_t cnt, void *buffer)
+{
+  ide_transfer (d, sec_no, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving the data. */
+static void
+ide_write_multiple (void *d, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
+{
+  ide_transfer (d, sec_no, cnt, (void *) buffer, true);
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER, which must have
+   room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ide_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  ide_read_multiple (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+   acknowledged receiving the data. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  ide_write_multiple (d, sec_no, 1, buffer);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple,
+    ide_submit
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT, which must be between 1 and
+   MAX_SECTORS_PER_CMD, to the disk's sector selection
+   registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sectors (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_SECTORS_PER_CMD ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -401,6 +592,247 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
         DEV_MBS | DEV_LBA | (d->dev_no == 1 ? DEV_DEV : 0) | (sec_no >> 24));
 }
 
+/* Request queue. */
+
+/* Returns the queued request on channel C to serve next. */
+static struct bio *
+next_request (struct channel *c)
+{
+  struct bio *oldest = list_entry (list_front (&c->queue), struct bio, elem);
+  struct bio *next = NULL, *lowest = NULL;
+  struct list_elem *e;
+
+  if (timer_ticks () >= oldest->deadline)
+    return oldest;
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    {
+      struct bio *b = list_entry (e, struct bio, elem);
+      if (b->sector >= c->head && (next == NULL || b->sector < next->sector))
+        next = b;
+      if (lowest == NULL || b->sector < lowest->sector)
+        lowest = b;
+    }
+  return next != NULL ? next : lowest;
+}
+
+/* Returns a queued request on channel C that continues the
+   running command, and fits in it, or a null pointer. */
+static struct bio *
+find_merge (struct channel *c)
+{
+  block_sector_t end = c->head;
+  struct list_elem *e;
+
+  for (e = list_begin (&c->queue); e != list_end (&c->queue);
+       e = list_next (e))
+    {
+      struct bio *b = list_entry (e, struct bio, elem);
+      if (b->driver == c->active_disk && b->write == c->active_write
+          && b->sector == end && c->active_cnt + b->cnt <= MAX_SECTORS_PER_CMD)
+        return b;
+    }
+  return NULL;
+}
+
+/* Returns the address of the data for sector IDX of channel C's
+   running command. */
+static uint8_t *
+active_sector (struct channel *c, size_t idx)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&c->active); e != list_end (&c->active);
+       e = list_next (e))
+    {
+      struct bio *b = list_entry (e, struct bio, elem);
+      if (idx < b->cnt)
+        return (uint8_t *) b->buffer + idx * BLOCK_SECTOR_SIZE;
+      idx -= b->cnt;
+    }
+  NOT_REACHED ();
+}
+
+/* Moves the next block of sectors of channel C's running command
+   by PIO, in the direction of the command. */
+static void
+pio_transfer_block (struct channel *c)
+{
+  struct ata_disk *d = c->active_disk;
+  size_t left = c->active_cnt - c->active_done;
+  size_t n = left < d->block_sectors ? left : d->block_sectors;
+  size_t i;
+
+  if (!wait_for_drq (d))
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+           c->active_write ? "write" : "read",
+           c->head - c->active_cnt + c->active_done);
+  for (i = 0; i < n; i++)
+    {
+      uint8_t *sector = active_sector (c, c->active_done + i);
+      if (c->active_write)
+        output_sectors (c, sector, 1);
+      else
+        input_sectors (c, sector, 1);
+    }
+  c->active_done += n;
+}
+
+/* Fills channel C's PRD table to describe the data of its
+   running command.  Each region stays within one page, so that
+   none crosses a 64 kB boundary. */
+static void
+build_prd_table (struct channel *c)
+{
+  struct prd *prd = c->prd_table;
+  struct list_elem *e;
+
+  for (e = list_begin (&c->active); e != list_end (&c->active);
+       e = list_next (e))
+    {
+      struct bio *b = list_entry (e, struct bio, elem);
+      uint8_t *buffer = b->buffer;
+      size_t size = b->cnt * BLOCK_SECTOR_SIZE;
+
+      while (size > 0)
+        {
+          size_t n = PGSIZE - pg_ofs (buffer);
+          if (n > size)
+            n = size;
+          prd->addr = vtop (buffer);
+          prd->size = n;
+          prd->flags = 0;
+          prd++;
+          buffer += n;
+          size -= n;
+        }
+    }
+  prd[-1].flags = PRD_EOT;
+}
+
+/* Starts the next command on idle channel C, merging as many
+   queued requests into it as possible.  Does nothing if C's
+   queue is empty.  Interrupts must be off. */
+static void
+start_command (struct channel *c)
+{
+  struct ata_disk *d;
+  struct bio *b;
+  block_sector_t sec_no;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (c->active_disk == NULL);
+
+  if (list_empty (&c->queue))
+    return;
+
+  /* Choose the requests to run. */
+  b = next_request (c);
+  d = b->driver;
+  sec_no = b->sector;
+  c->active_disk = d;
+  c->active_write = b->write;
+  c->active_cnt = 0;
+  c->active_done = 0;
+  c->active_dma = d->dma;
+  c->head = sec_no;
+  do
+    {
+      list_remove (&b->elem);
+      list_push_back (&c->active, &b->elem);
+      block_started (b);
+      c->active_cnt += b->cnt;
+      c->head += b->cnt;
+    }
+  while ((b = find_merge (c)) != NULL);
+
+  /* Issue the command. */
+  if (c->active_dma)
+    {
+      uint8_t direction = c->active_write ? 0 : BM_CMD_READ;
+
+      build_prd_table (c);
+      outl (reg_bm_prdt (c), vtop (c->prd_table));
+      outb (reg_bm_command (c), direction);
+      outb (reg_bm_status (c),
+            inb (reg_bm_status (c)) | BM_STA_ERROR | BM_STA_IRQ);
+      select_sectors (d, sec_no, c->active_cnt);
+      outb (reg_command (c), c->active_write ? CMD_WRITE_DMA : CMD_READ_DMA);
+      outb (reg_bm_command (c), direction | BM_CMD_START);
+    }
+  else
+    {
+      select_sectors (d, sec_no, c->active_cnt);
+      if (c->active_write)
+        {
+          outb (reg_command (c), (d->block_sectors > 1
+                                  ? CMD_WRITE_MULTIPLE
+                                  : CMD_WRITE_SECTOR_RETRY));
+          pio_transfer_block (c);
+        }
+      else
+        outb (reg_command (c), (d->block_sectors > 1
+                                ? CMD_READ_MULTIPLE
+                                : CMD_READ_SECTOR_RETRY));
+    }
+}
+
+/* Completes every request in channel C's running command and
+   starts the next one. */
+static void
+finish_command (struct channel *c)
+{
+  c->active_disk = NULL;
+  while (!list_empty (&c->active))
+    {
+      struct bio *b = list_entry (list_pop_front (&c->active),
+                                  struct bio, elem);
+      block_complete (b);
+    }
+  start_command (c);
+}
+
+/* Handles an interrupt for channel C's running command. */
+static void
+command_interrupt (struct channel *c)
+{
+  struct ata_disk *d = c->active_disk;
+  uint8_t status;
+
+  if (c->active_dma)
+    {
+      uint8_t bm_status;
+
+      outb (reg_bm_command (c), 0);
+      bm_status = inb (reg_bm_status (c));
+      outb (reg_bm_status (c), bm_status | BM_STA_ERROR | BM_STA_IRQ);
+      status = inb (reg_status (c));    /* Acknowledge interrupt. */
+      if ((bm_status & BM_STA_ERROR) || (status & STA_ERR))
+        PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+               c->active_write ? "write" : "read", c->head - c->active_cnt);
+      finish_command (c);
+      return;
+    }
+
+  status = inb (reg_status (c));        /* Acknowledge interrupt. */
+  if (status & STA_ERR)
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+           c->active_write ? "write" : "read",
+           c->head - c->active_cnt + c->active_done);
+  if (!c->active_write)
+    pio_transfer_block (c);
+  if (c->active_done < c->active_cnt)
+    {
+      /* Reads wait for the next block's interrupt; writes send
+         the next block now. */
+      if (c->active_write)
+        pio_transfer_block (c);
+    }
+  else
+    finish_command (c);
+}
+
 /* Writes COMMAND to channel C and prepares for receiving a
    completion interrupt. */
 static void
@@ -414,20 +846,22 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for BLOCK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sectors (struct channel *c, void *sectors, size_t cnt) 
 {
-  insw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain BLOCK_SECTOR_SIZE bytes. */
+/* Writes CNT sectors from SECTORS to channel C's data register
+   in PIO mode.  SECTORS must contain CNT * BLOCK_SECTOR_SIZE
+   bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sectors (struct channel *c, const void *sectors, size_t cnt) 
 {
-  outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sectors, cnt * BLOCK_SECTOR_SIZE / 2);
 }
 
 /* Low-level ATA primitives. */
@@ -446,7 +880,7 @@ wait_until_idle (const struct ata_disk *d)
     {
       if ((inb (reg_status (d->channel)) & (STA_BSY | STA_DRQ)) == 0)
         return;
-      timer_usleep (10);
+      timer_udelay (10);
     }
 
   printf ("%s: idle timeout\n", d->name);
@@ -479,6 +913,24 @@ wait_while_busy (const struct ata_disk *d)
   return false;
 }
 
+/* Waits up to 100 ms, without sleeping, for disk D to clear BSY
+   and set DRQ, as it does when ready to transfer data.  Returns
+   false if it does not. */
+static bool
+wait_for_drq (const struct ata_disk *d)
+{
+  int i;
+
+  for (i = 0; i < 10000; i++)
+    {
+      uint8_t status = inb (reg_alt_status (d->channel));
+      if (!(status & STA_BSY))
+        return (status & STA_DRQ) != 0;
+      timer_udelay (10);
+    }
+  return false;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void
 select_device (const struct ata_disk *d)
@@ -489,7 +941,7 @@ select_device (const struct ata_disk *d)
     dev |= DEV_DEV;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
-  timer_nsleep (400);
+  timer_ndelay (400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -511,7 +963,9 @@ interrupt_handler (struct intr_frame *f)
   for (c = channels; c < channels + CHANNEL_CNT; c++)
     if (f->vec_no == c->irq)
       {
-        if (c->expecting_interrupt) 
+        if (c->active_disk != NULL)
+          command_interrupt (c);
+        else if (c->expecting_interrupt) 
           {
             inb (reg_status (c));               /* Acknowledge interrupt. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
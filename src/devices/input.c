@@ -2,15 +2,20 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/waitq.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
+/* Waiters to wake when a key arrives. */
+static struct waitq readers;
+
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
   intq_init (&buffer);
+  waitq_init (&readers);
 }
 
 /* Adds a key to the input buffer.
@@ -23,6 +28,7 @@ input_putc (uint8_t key)
 
   intq_putc (&buffer, key);
   serial_notify ();
+  waitq_wake (&readers);
 }
 
 /* Retrieves a key from the input buffer.
@@ -41,6 +47,45 @@ input_getc (void)
   return key;
 }
 
+/* Retrieves a key from the input buffer into *KEY without
+   waiting.  Returns false if the buffer is empty. */
+bool
+input_try_getc (uint8_t *key)
+{
+  enum intr_level old_level;
+  bool got;
+
+  old_level = intr_disable ();
+  got = !intq_empty (&buffer);
+  if (got)
+    {
+      *key = intq_getc (&buffer);
+      serial_notify ();
+    }
+  intr_set_level (old_level);
+
+  return got;
+}
+
+/* Returns true if a key is waiting in the input buffer, false
+   otherwise. */
+bool
+input_ready (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool ready = !intq_empty (&buffer);
+  intr_set_level (old_level);
+  return ready;
+}
+
+/* Returns the queue of waiters to wake when a key is added to
+   the input buffer. */
+struct waitq *
+input_waitq (void)
+{
+  return &readers;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -4,9 +4,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+struct waitq;
+
 void input_init (void);
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+bool input_try_getc (uint8_t *);
+bool input_ready (void);
+struct waitq *input_waitq (void);
 bool input_full (void);
 
 #endif /* devices/input.h */
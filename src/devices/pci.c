@@ -0,0 +1,173 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* The code in this file enumerates PCI functions through
+   configuration mechanism #1, the I/O port interface that every
+   PC chipset and emulator since the Pentium provides.  It does
+   just enough for drivers to find their controller and program
+   it; there is no resource assignment, since the BIOS has
+   already done that. */
+
+/* Configuration mechanism #1 ports. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Selects a configuration register. */
+#define PCI_CONFIG_DATA 0xcfc   /* Accesses the selected register. */
+
+/* Configuration space registers used for enumeration. */
+#define PCI_REG_ID 0x00         /* Vendor ID, device ID. */
+#define PCI_REG_CLASS 0x08      /* Revision, prog IF, subclass, class. */
+#define PCI_REG_HEADER 0x0c     /* Header type in bits 16...23. */
+
+#define PCI_BUS_CNT 256
+#define PCI_DEV_CNT 32
+#define PCI_FUNC_CNT 8
+
+static void select_config (int bus, int dev, int func, uint8_t reg);
+static uint32_t read_config (int bus, int dev, int func, uint8_t reg);
+static bool match_class (const struct pci_dev *, const void *);
+static bool match_device (const struct pci_dev *, const void *);
+static bool scan (bool (*match) (const struct pci_dev *, const void *),
+                  const void *aux, int nth, struct pci_dev *);
+
+/* Finds the NTH PCI function, counting from 0, with the given
+   CLASS and SUBCLASS and stores it in *PD.  Returns true if
+   successful, false if no such function exists. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, int nth,
+                struct pci_dev *pd)
+{
+  uint8_t key[2] = { class, subclass };
+  return scan (match_class, key, nth, pd);
+}
+
+/* Finds the NTH PCI function, counting from 0, with the given
+   VENDOR_ID and DEVICE_ID and stores it in *PD.  Returns true if
+   successful, false if no such function exists. */
+bool
+pci_find_device (uint16_t vendor_id, uint16_t device_id, int nth,
+                 struct pci_dev *pd)
+{
+  uint16_t key[2] = { vendor_id, device_id };
+  return scan (match_device, key, nth, pd);
+}
+
+/* Returns 32-bit configuration register REG of PD.  REG must be
+   a multiple of 4. */
+uint32_t
+pci_read_config (const struct pci_dev *pd, uint8_t reg)
+{
+  return read_config (pd->bus, pd->dev, pd->func, reg);
+}
+
+/* Writes VALUE to 32-bit configuration register REG of PD.  REG
+   must be a multiple of 4. */
+void
+pci_write_config (const struct pci_dev *pd, uint8_t reg, uint32_t value)
+{
+  select_config (pd->bus, pd->dev, pd->func, reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Returns the I/O port base of base address register BAR (0...5)
+   of PD, or 0 if BAR is unset or maps memory rather than I/O
+   ports. */
+uint16_t
+pci_read_io_bar (const struct pci_dev *pd, int bar)
+{
+  uint32_t value;
+
+  ASSERT (bar >= 0 && bar < 6);
+  value = pci_read_config (pd, PCI_REG_BAR0 + bar * 4);
+  return (value & 1) ? value & ~3u : 0;
+}
+
+/* Allows PD to respond to I/O accesses and to master the bus, as
+   a DMA-capable function requires. */
+void
+pci_enable_bus_master (const struct pci_dev *pd)
+{
+  uint32_t command = pci_read_config (pd, PCI_REG_COMMAND);
+  pci_write_config (pd, PCI_REG_COMMAND,
+                    command | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+}
+
+/* Returns true if PD has the class and subclass in KEY_, an
+   array of two bytes. */
+static bool
+match_class (const struct pci_dev *pd, const void *key_)
+{
+  const uint8_t *key = key_;
+  return pd->class == key[0] && pd->subclass == key[1];
+}
+
+/* Returns true if PD has the vendor and device IDs in KEY_, an
+   array of two 16-bit values. */
+static bool
+match_device (const struct pci_dev *pd, const void *key_)
+{
+  const uint16_t *key = key_;
+  return pd->vendor_id == key[0] && pd->device_id == key[1];
+}
+
+/* Points PCI_CONFIG_DATA at 32-bit configuration register REG
+   of function FUNC of device DEV on BUS. */
+static void
+select_config (int bus, int dev, int func, uint8_t reg)
+{
+  ASSERT (reg % 4 == 0);
+  outl (PCI_CONFIG_ADDR,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg);
+}
+
+/* Reads 32-bit configuration register REG of function FUNC of
+   device DEV on BUS. */
+static uint32_t
+read_config (int bus, int dev, int func, uint8_t reg)
+{
+  select_config (bus, dev, func, reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Walks every present PCI function in bus order, storing the
+   NTH one for which MATCH returns true, given AUX, in *PD.
+   Returns true if one was found. */
+static bool
+scan (bool (*match) (const struct pci_dev *, const void *), const void *aux,
+      int nth, struct pci_dev *pd)
+{
+  int bus, dev, func;
+
+  for (bus = 0; bus < PCI_BUS_CNT; bus++)
+    for (dev = 0; dev < PCI_DEV_CNT; dev++)
+      for (func = 0; func < PCI_FUNC_CNT; func++)
+        {
+          uint32_t id = read_config (bus, dev, func, PCI_REG_ID);
+          uint32_t class;
+
+          if ((id & 0xffff) == 0xffff)
+            {
+              /* No function 0 means no device at all. */
+              if (func == 0)
+                break;
+              continue;
+            }
+
+          class = read_config (bus, dev, func, PCI_REG_CLASS);
+          pd->bus = bus;
+          pd->dev = dev;
+          pd->func = func;
+          pd->vendor_id = id & 0xffff;
+          pd->device_id = id >> 16;
+          pd->class = class >> 24;
+          pd->subclass = class >> 16;
+          pd->prog_if = class >> 8;
+          if (match (pd, aux) && nth-- == 0)
+            return true;
+
+          /* Only multi-function devices have functions past 0. */
+          if (func == 0
+              && !(read_config (bus, dev, 0, PCI_REG_HEADER) & 0x800000))
+            break;
+        }
+  return false;
+}
@@ -0,0 +1,78 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device backed by memory, named "rd0".  It has no
+   partition table, so it is given a role by name, e.g.
+   "-swap=rd0".  Its contents do not survive a reboot. */
+
+/* Memory holding the disk's sectors. */
+static uint8_t *ramdisk;
+
+/* Reads CNT sectors starting at SECTOR into BUFFER. */
+static void
+ramdisk_read_multiple (void *aux UNUSED, block_sector_t sector, size_t cnt,
+                       void *buffer)
+{
+  memcpy (buffer, ramdisk + sector * BLOCK_SECTOR_SIZE,
+          cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Writes CNT sectors starting at SECTOR from BUFFER. */
+static void
+ramdisk_write_multiple (void *aux UNUSED, block_sector_t sector, size_t cnt,
+                        const void *buffer)
+{
+  memcpy (ramdisk + sector * BLOCK_SECTOR_SIZE, buffer,
+          cnt * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SECTOR into BUFFER. */
+static void
+ramdisk_read (void *aux, block_sector_t sector, void *buffer)
+{
+  ramdisk_read_multiple (aux, sector, 1, buffer);
+}
+
+/* Writes sector SECTOR from BUFFER. */
+static void
+ramdisk_write (void *aux, block_sector_t sector, const void *buffer)
+{
+  ramdisk_write_multiple (aux, sector, 1, buffer);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multiple,
+    ramdisk_write_multiple,
+    NULL
+  };
+
+/* Registers a RAM disk of SIZE_KB kilobytes, rounded up to whole
+   pages.  If MEMORY is non-null, it must be that many bytes
+   reserved for the disk, e.g. with palloc_reserve_high();
+   otherwise the disk is allocated from the kernel pool, and the
+   kernel panics if that fails.  Does nothing if SIZE_KB is 0. */
+void
+ramdisk_init (size_t size_kb, void *memory)
+{
+  size_t page_cnt = DIV_ROUND_UP (size_kb * 1024, PGSIZE);
+
+  if (page_cnt == 0)
+    return;
+  ramdisk = memory;
+  if (ramdisk == NULL)
+    ramdisk = palloc_get_multiple (PAL_ASSERT, page_cnt);
+  memset (ramdisk, 0, page_cnt * PGSIZE);
+
+  block_register ("rd0", BLOCK_RAW, memory != NULL ? "high memory" : NULL,
+                  page_cnt * PGSIZE / BLOCK_SECTOR_SIZE,
+                  &ramdisk_operations, NULL);
+}
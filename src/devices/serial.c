@@ -1,7 +1,7 @@
 #include "devices/serial.h"
 #include <debug.h>
+#include <list.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -37,6 +37,14 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+
+/* Bytes in the 16550A's transmit FIFO. */
+#define TX_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -46,17 +54,26 @@
 
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
-#define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_THRE 0x20           /* THR Empty (transmit FIFO empty). */
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Data to be transmitted, in a circular buffer.  TX_HEAD and
+   TX_TAIL run freely, so bytes TX_TAIL through TX_HEAD - 1
+   (modulo TXBUF_SIZE) are pending.  TXBUF_SIZE must be a power
+   of 2.  Accessed only with interrupts off. */
+#define TXBUF_SIZE 8192
+static uint8_t txbuf[TXBUF_SIZE];
+static size_t tx_head, tx_tail;
+
+/* Threads waiting for room in txbuf. */
+static struct list tx_waiters = LIST_INITIALIZER (tx_waiters);
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
+static void wake_tx_waiters (void);
 static intr_handler_func serial_interrupt;
 
 /* Initializes the serial port device for polling mode.
@@ -68,10 +85,9 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
-  set_serial (9600);                    /* 9.6 kbps, N-8-1. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
+  set_serial (115200);                  /* 115.2 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
   mode = POLL;
 } 
 
@@ -94,36 +110,85 @@ serial_init_queue (void)
   intr_set_level (old_level);
 }
 
+/* Returns true if txbuf is empty. */
+static bool
+tx_empty (void)
+{
+  return tx_head == tx_tail;
+}
+
+/* Returns true if txbuf is full. */
+static bool
+tx_full (void)
+{
+  return tx_head - tx_tail == TXBUF_SIZE;
+}
+
+/* Removes and returns the oldest byte in txbuf, which must not
+   be empty. */
+static uint8_t
+tx_getc (void)
+{
+  ASSERT (!tx_empty ());
+  return txbuf[tx_tail++ % TXBUF_SIZE];
+}
+
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) 
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  In
+   interrupt-driven mode, returns as soon as they have been
+   queued for transmission, waiting only if the transmit buffer
+   fills up.  BUFFER is read with interrupts off, so it must be
+   kernel memory, never user memory that could fault. */
+void
+serial_putbuf (const void *buffer_, size_t n)
+{
+  const uint8_t *buffer = buffer_;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*buffer++);
     }
-  else 
+  else
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      while (n > 0)
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          if (tx_full ())
+            {
+              if (old_level == INTR_ON)
+                {
+                  /* Wait for the interrupt handler to make room. */
+                  list_push_back (&tx_waiters, &thread_current ()->elem);
+                  thread_block ();
+                  continue;
+                }
+
+              /* Interrupts are off and the transmit buffer is
+                 full.  If we wanted to wait for it to drain,
+                 we'd have to reenable interrupts.  That's
+                 impolite, so we'll send a character via polling
+                 instead. */
+              putc_poll (tx_getc ());
+            }
+
+          while (n > 0 && !tx_full ())
+            {
+              txbuf[tx_head++ % TXBUF_SIZE] = *buffer++;
+              n--;
+            }
+          write_ier ();
         }
-
-      intq_putc (&txq, byte); 
-      write_ier ();
     }
   
   intr_set_level (old_level);
@@ -135,11 +200,22 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!tx_empty ())
+    putc_poll (tx_getc ());
+  wake_tx_waiters ();
   intr_set_level (old_level);
 }
 
+/* Wakes up all the threads waiting for room in txbuf. */
+static void
+wake_tx_waiters (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  while (!list_empty (&tx_waiters))
+    thread_unblock (list_entry (list_pop_front (&tx_waiters),
+                                struct thread, elem));
+}
+
 /* The fullness of the input buffer may have changed.  Reassess
    whether we should block receive interrupts.
    Called by the input buffer routines when characters are added
@@ -182,7 +258,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!tx_empty ())
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -218,10 +294,18 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmit FIFO is empty, refill it from the transmit
+     buffer, and once there is plenty of room in the buffer again,
+     wake up the threads waiting for it. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    {
+      int i;
+
+      for (i = 0; i < TX_FIFO_SIZE && !tx_empty (); i++)
+        outb (THR_REG, tx_getc ());
+      if (tx_head - tx_tail <= TXBUF_SIZE / 2)
+        wake_tx_waiters ();
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
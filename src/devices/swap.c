@@ -1,9 +1,11 @@
 #include "devices/swap.h"
 #include "devices/block.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <rusage.h>
 #include <stdio.h>
 
 /* Pointer to the swap device */
@@ -36,6 +38,20 @@ swap_init (void)
   lock_init (&swap_lock);
 }
 
+/* Charges the current thread with a page swapped in, if IN, or
+   out. */
+static void
+count_swap (bool in)
+{
+  struct rusage *ru = thread_rusage ();
+  if (ru == NULL)
+    return;
+  if (in)
+    ru->swap_ins++;
+  else
+    ru->swap_outs++;
+}
+
 /* Swaps page at VADDR out of memory, returns the swap-slot used */
 size_t
 swap_out (const void *vaddr) 
@@ -50,9 +66,9 @@ swap_out (const void *vaddr)
   // calculate block sector from swap-slot number
   size_t sector = slot * PAGE_SECTORS;
   
-  // loop over each sector of the page, copying it from memory into swap
-  for (size_t i = 0; i < PAGE_SECTORS; i++)
-    block_write (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  // copy the whole page from memory into swap in one request
+  block_write_multiple (swap_device, sector, PAGE_SECTORS, vaddr);
+  count_swap (false);
 
   return slot;
 }
@@ -64,9 +80,9 @@ swap_in (void *vaddr, size_t slot)
   // calculate block sector from swap-slot number
   size_t sector = slot * PAGE_SECTORS;
 
-  // loop over each sector of the page, copying it from swap into memory
-  for (size_t i = 0; i < PAGE_SECTORS; i++)
-    block_read (swap_device, sector + i, vaddr + i * BLOCK_SECTOR_SIZE);
+  // copy the whole page from swap into memory in one request
+  block_read_multiple (swap_device, sector, PAGE_SECTORS, vaddr);
+  count_swap (true);
   
   // clear the swap-slot previously used by this page
   swap_drop (slot);
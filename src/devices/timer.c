@@ -3,10 +3,13 @@
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
+#include <vtime.h>
 #include "devices/pit.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/gdt.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -24,20 +27,28 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* The time page that user processes map, padded to a page of
+   its own.  Only the timer interrupt writes it. */
+static union
+  {
+    struct vtime vtime;
+    uint8_t page[PGSIZE];
+  }
+time_page __attribute__ ((aligned (PGSIZE)));
+
+/* Timestamp counter at the first timer tick, from which the
+   counter's rate is measured. */
+static uint64_t first_tsc;
+
 static intr_handler_func timer_interrupt;
+static void update_time_page (void);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
 
-struct sleeping_thread
-{
-  int64_t wakeup_time;
-  struct semaphore *s;
-  struct list_elem elem;
-};
-
-struct list sleeping_list;
+/* Pending alarms, soonest first. */
+static struct list alarm_list;
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
@@ -46,7 +57,8 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init (&sleeping_list);
+  list_init (&alarm_list);
+  time_page.vtime.freq = TIMER_FREQ;
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -94,10 +106,44 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-static bool 
-compare_thread(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Returns true if alarm A goes off no later than alarm B. */
+static bool
+compare_alarm (const struct list_elem *a, const struct list_elem *b,
+               void *aux UNUSED)
+{
+  return (list_entry (a, struct timer_alarm, elem)->wakeup_time
+          <= list_entry (b, struct timer_alarm, elem)->wakeup_time);
+}
+
+/* Sets ALARM to wake WAITER at timer tick WAKEUP_TIME, or at the
+   next tick if that has passed.  ALARM must stay put until it
+   goes off, which clears its PENDING, or is cancelled. */
+void
+timer_alarm_set (struct timer_alarm *alarm, int64_t wakeup_time,
+                 struct waiter *waiter)
+{
+  enum intr_level old_level;
+
+  alarm->wakeup_time = wakeup_time;
+  alarm->waiter = waiter;
+  alarm->pending = true;
+
+  old_level = intr_disable ();
+  list_insert_ordered (&alarm_list, &alarm->elem, compare_alarm, NULL);
+  intr_set_level (old_level);
+}
+
+/* Cancels ALARM if it has not gone off yet. */
+void
+timer_alarm_cancel (struct timer_alarm *alarm)
 {
-  return (list_entry (a, struct sleeping_thread, elem)->wakeup_time <= list_entry (b, struct sleeping_thread, elem)->wakeup_time);
+  enum intr_level old_level = intr_disable ();
+  if (alarm->pending)
+    {
+      list_remove (&alarm->elem);
+      alarm->pending = false;
+    }
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
@@ -106,22 +152,17 @@ void
 timer_sleep (int64_t ticks)
 {
   int64_t start = timer_ticks ();
-
-  struct sleeping_thread thread = {
-      .s = &(struct semaphore) {},
-      .wakeup_time = start + ticks,
-  };
-
-  sema_init (thread.s, 0);
+  struct timer_alarm alarm;
+  struct waiter waiter;
 
   ASSERT (intr_get_level () == INTR_ON);
 
   if (timer_elapsed (start) < ticks)
   {
-    enum intr_level old_level = intr_disable ();
-    list_insert_ordered (&sleeping_list, &thread.elem, compare_thread, NULL);
-    sema_down (thread.s);
-    intr_set_level (old_level);
+    waiter_init (&waiter);
+    timer_alarm_set (&alarm, start + ticks, &waiter);
+    while (alarm.pending)
+      waiter_wait (&waiter);
   }
 }
 
@@ -188,6 +229,26 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/* Returns the timestamp counter's average rate in cycles per
+   timer tick, as published in the time page, or 0 until it has
+   been measured. */
+uint64_t
+timer_tsc_per_tick (void)
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t rate = time_page.vtime.tsc_per_tick;
+  intr_set_level (old_level);
+  return rate;
+}
+
+/* Returns the kernel address of the time page, described in
+   lib/vtime.h, for mapping read-only into user processes. */
+void *
+timer_time_page (void)
+{
+  return time_page.page;
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void)
@@ -197,20 +258,22 @@ timer_print_stats (void)
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
   ticks++;
-  thread_tick ();
+  update_time_page ();
+  thread_tick (args->cs == SEL_UCSEG);
 
-  for (struct list_elem *e = list_begin (&sleeping_list);
-       e != list_end (&sleeping_list);)
+  for (struct list_elem *e = list_begin (&alarm_list);
+       e != list_end (&alarm_list);)
   {
-    struct sleeping_thread *t = list_entry (e, struct sleeping_thread, elem);
+    struct timer_alarm *alarm = list_entry (e, struct timer_alarm, elem);
 
-    if (t->wakeup_time <= ticks)
+    if (alarm->wakeup_time <= ticks)
     {
       e = list_remove (e); // Remove the element and get the next one.
-      sema_up (t->s);
+      alarm->pending = false;
+      waiter_wake (alarm->waiter);
     }
     else
     {
@@ -219,6 +282,28 @@ timer_interrupt (struct intr_frame *args UNUSED)
   }
 }
 
+/* Publishes the new tick count in the time page, along with the
+   timestamp counter's value now and its average rate since the
+   first tick. */
+static void
+update_time_page (void)
+{
+  struct vtime *vt = &time_page.vtime;
+  uint64_t tsc = vtime_rdtsc ();
+
+  if (ticks == 1)
+    first_tsc = tsc;
+
+  vt->seq++;
+  barrier ();
+  vt->ticks = ticks;
+  vt->tsc = tsc;
+  if (ticks > 1)
+    vt->tsc_per_tick = (tsc - first_tsc) / (ticks - 1);
+  barrier ();
+  vt->seq++;
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -1,18 +1,34 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include "threads/waitq.h"
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* An alarm that wakes a waiter at a given timer tick. */
+struct timer_alarm
+  {
+    int64_t wakeup_time;        /* Tick at which to go off. */
+    struct waiter *waiter;      /* Waiter to wake. */
+    bool pending;               /* Not yet gone off or cancelled. */
+    struct list_elem elem;      /* Element in the list of alarms. */
+  };
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+void timer_alarm_set (struct timer_alarm *, int64_t wakeup_time,
+                      struct waiter *);
+void timer_alarm_cancel (struct timer_alarm *);
+
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -24,6 +40,8 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+uint64_t timer_tsc_per_tick (void);
+void *timer_time_page (void);
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,462 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The code in this file drives virtio block devices through the
+   legacy (0.9.5) PCI interface that QEMU offers with
+   "-drive if=virtio".  Each device has a single virtqueue.  A
+   request occupies a chain of three descriptors, for its header,
+   its data and its status byte, so as many requests can be in
+   flight as the queue has room for; requests that do not fit
+   wait in a pending list until earlier ones complete. */
+
+/* PCI identification. */
+#define VIRTIO_VENDOR_ID 0x1af4
+#define VIRTIO_BLK_DEVICE_ID 0x1001
+
+/* Legacy virtio I/O registers, relative to BAR 0. */
+#define reg_host_features(DEV) ((DEV)->io_base + 0x00) /* 32 bits. */
+#define reg_guest_features(DEV) ((DEV)->io_base + 0x04) /* 32 bits. */
+#define reg_queue_pfn(DEV) ((DEV)->io_base + 0x08)     /* 32 bits. */
+#define reg_queue_size(DEV) ((DEV)->io_base + 0x0c)    /* 16 bits. */
+#define reg_queue_select(DEV) ((DEV)->io_base + 0x0e)  /* 16 bits. */
+#define reg_queue_notify(DEV) ((DEV)->io_base + 0x10)  /* 16 bits. */
+#define reg_status(DEV) ((DEV)->io_base + 0x12)        /* 8 bits. */
+#define reg_isr(DEV) ((DEV)->io_base + 0x13)           /* 8 bits. */
+#define reg_capacity(DEV) ((DEV)->io_base + 0x14)      /* 64 bits. */
+
+/* Device status bits. */
+#define STATUS_ACKNOWLEDGE 0x01 /* Guest has noticed the device. */
+#define STATUS_DRIVER 0x02      /* Guest knows how to drive it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Driver gave up on the device. */
+
+/* Virtqueue alignment required by the legacy interface. */
+#define VRING_ALIGN PGSIZE
+
+/* A virtqueue descriptor. */
+struct vring_desc
+  {
+    uint64_t addr;              /* Physical address of buffer. */
+    uint32_t len;               /* Length of buffer in bytes. */
+    uint16_t flags;             /* VRING_DESC_F_*. */
+    uint16_t next;              /* Next descriptor if F_NEXT. */
+  };
+#define VRING_DESC_F_NEXT 1     /* Chain continues in NEXT. */
+#define VRING_DESC_F_WRITE 2    /* Buffer is written by the device. */
+
+/* Ring of descriptor chains made available to the device. */
+struct vring_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where the next entry goes. */
+    uint16_t ring[];
+  };
+
+/* Ring of descriptor chains the device has finished with. */
+struct vring_used_elem
+  {
+    uint32_t id;                /* Head of the chain. */
+    uint32_t len;               /* Bytes written to the chain. */
+  };
+struct vring_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Where the device puts the next entry. */
+    struct vring_used_elem ring[];
+  };
+
+/* virtio-blk request header. */
+struct virtio_blk_header
+  {
+    uint32_t type;              /* VIRTIO_BLK_T_*. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+#define VIRTIO_BLK_T_IN 0       /* Read. */
+#define VIRTIO_BLK_T_OUT 1      /* Write. */
+
+/* Descriptors used by each request. */
+#define DESCS_PER_REQUEST 3
+
+/* In-flight request state, indexed by the request's first
+   descriptor.  Lives in kernel memory so the device can reach
+   HEADER and STATUS. */
+struct request_slot
+  {
+    struct virtio_blk_header header;
+    uint8_t status;             /* 0 on success. */
+    struct bio *bio;            /* Request being served. */
+  };
+
+/* A virtio block device. */
+struct virtio_blk
+  {
+    char name[8];               /* Name, e.g. "vda". */
+    uint16_t io_base;           /* Base I/O port. */
+    uint8_t irq;                /* Interrupt vector. */
+
+    /* Virtqueue, protected by disabling interrupts. */
+    uint16_t queue_size;        /* Number of descriptors. */
+    struct vring_desc *desc;    /* Descriptor table. */
+    struct vring_avail *avail;  /* Available ring. */
+    struct vring_used *used;    /* Used ring. */
+    uint16_t free_head;         /* First free descriptor. */
+    uint16_t free_cnt;          /* Number of free descriptors. */
+    uint16_t last_used;         /* Used ring entries consumed. */
+    struct request_slot *slots; /* Per-descriptor request state. */
+    struct list pending;        /* Requests waiting for descriptors. */
+  };
+
+/* Most virtio block devices we drive. */
+#define MAX_DEVICES 4
+static struct virtio_blk devices[MAX_DEVICES];
+static size_t device_cnt;
+
+static struct block_operations virtio_blk_operations;
+
+static bool init_device (struct virtio_blk *, const struct pci_dev *);
+static void start_request (struct virtio_blk *, struct bio *);
+static void interrupt_handler (struct intr_frame *);
+
+/* Finds and registers virtio block devices. */
+void
+virtio_blk_init (void)
+{
+  struct pci_dev pci;
+
+  while (device_cnt < MAX_DEVICES
+         && pci_find_device (VIRTIO_VENDOR_ID, VIRTIO_BLK_DEVICE_ID,
+                             device_cnt, &pci))
+    {
+      struct virtio_blk *dev = &devices[device_cnt];
+      block_sector_t capacity;
+      struct block *block;
+      size_t i;
+
+      snprintf (dev->name, sizeof dev->name, "vd%c", 'a' + (int) device_cnt);
+      device_cnt++;
+      if (!init_device (dev, &pci))
+        {
+          printf ("%s: initialization failed\n", dev->name);
+          continue;
+        }
+
+      /* Devices may share an interrupt line.  Register each
+         vector once; the handler polls every device. */
+      for (i = 0; i + 1 < device_cnt; i++)
+        if (devices[i].slots != NULL && devices[i].irq == dev->irq)
+          break;
+      if (i + 1 == device_cnt)
+        intr_register_ext (dev->irq, interrupt_handler, dev->name);
+
+      /* Block devices are limited to 2^32 sectors anyway, so the
+         upper half of the 64-bit capacity is ignored. */
+      capacity = inl (reg_capacity (dev));
+      block = block_register (dev->name, BLOCK_RAW, "virtio", capacity,
+                              &virtio_blk_operations, dev);
+      partition_scan (block);
+    }
+}
+
+/* Resets DEV, found at PCI function PCI, and sets up its
+   virtqueue.  Returns true if successful. */
+static bool
+init_device (struct virtio_blk *dev, const struct pci_dev *pci)
+{
+  size_t desc_size, avail_size, used_size, page_cnt;
+  uint8_t *queue;
+  uint16_t i;
+
+  dev->io_base = pci_read_io_bar (pci, 0);
+  dev->irq = 0x20 + (pci_read_config (pci, PCI_REG_INTR) & 0xff);
+  if (dev->io_base == 0 || dev->irq >= 0x30)
+    return false;
+  pci_enable_bus_master (pci);
+
+  /* Reset, then announce ourselves.  We need no optional
+     features. */
+  outb (reg_status (dev), 0);
+  outb (reg_status (dev), STATUS_ACKNOWLEDGE);
+  outb (reg_status (dev), STATUS_ACKNOWLEDGE | STATUS_DRIVER);
+  inl (reg_host_features (dev));
+  outl (reg_guest_features (dev), 0);
+
+  /* Allocate queue 0 in physically contiguous, page-aligned
+     memory, laid out as the legacy interface dictates. */
+  outw (reg_queue_select (dev), 0);
+  dev->queue_size = inw (reg_queue_size (dev));
+  if (dev->queue_size < DESCS_PER_REQUEST)
+    goto fail;
+  desc_size = sizeof *dev->desc * dev->queue_size;
+  avail_size = sizeof *dev->avail + sizeof (uint16_t) * (dev->queue_size + 1);
+  used_size = (sizeof *dev->used
+               + sizeof (struct vring_used_elem) * dev->queue_size
+               + sizeof (uint16_t));
+  page_cnt = (ROUND_UP (desc_size + avail_size, VRING_ALIGN)
+              + ROUND_UP (used_size, VRING_ALIGN)) / PGSIZE;
+  queue = palloc_get_multiple (PAL_ZERO, page_cnt);
+  dev->slots = calloc (dev->queue_size, sizeof *dev->slots);
+  if (queue == NULL || dev->slots == NULL)
+    {
+      if (queue != NULL)
+        palloc_free_multiple (queue, page_cnt);
+      free (dev->slots);
+      dev->slots = NULL;
+      goto fail;
+    }
+  dev->desc = (struct vring_desc *) queue;
+  dev->avail = (struct vring_avail *) (queue + desc_size);
+  dev->used = (struct vring_used *) (queue + ROUND_UP (desc_size + avail_size,
+                                                       VRING_ALIGN));
+
+  /* Chain all descriptors into the free list. */
+  for (i = 0; i < dev->queue_size; i++)
+    dev->desc[i].next = i + 1;
+  dev->free_head = 0;
+  dev->free_cnt = dev->queue_size;
+  dev->last_used = 0;
+  list_init (&dev->pending);
+
+  outl (reg_queue_pfn (dev), vtop (queue) / PGSIZE);
+  outb (reg_status (dev),
+        STATUS_ACKNOWLEDGE | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+
+ fail:
+  outb (reg_status (dev), STATUS_FAILED);
+  return false;
+}
+
+/* Takes a descriptor off DEV's free list and returns its index. */
+static uint16_t
+alloc_desc (struct virtio_blk *dev)
+{
+  uint16_t idx = dev->free_head;
+
+  ASSERT (dev->free_cnt > 0);
+  dev->free_head = dev->desc[idx].next;
+  dev->free_cnt--;
+  return idx;
+}
+
+/* Returns the chain of descriptors starting at HEAD to DEV's
+   free list. */
+static void
+free_chain (struct virtio_blk *dev, uint16_t head)
+{
+  uint16_t idx = head;
+
+  for (;;)
+    {
+      struct vring_desc *d = &dev->desc[idx];
+      bool more = d->flags & VRING_DESC_F_NEXT;
+      uint16_t next = d->next;
+
+      d->next = dev->free_head;
+      d->flags = 0;
+      dev->free_head = idx;
+      dev->free_cnt++;
+      if (!more)
+        break;
+      idx = next;
+    }
+}
+
+/* Sets descriptor IDX of DEV to describe SIZE bytes at BUFFER. */
+static void
+set_desc (struct virtio_blk *dev, uint16_t idx, const void *buffer,
+          size_t size, uint16_t flags, uint16_t next)
+{
+  struct vring_desc *d = &dev->desc[idx];
+  d->addr = vtop (buffer);
+  d->len = size;
+  d->flags = flags;
+  d->next = next;
+}
+
+/* Hands BIO to DEV, which must have DESCS_PER_REQUEST free
+   descriptors.  Interrupts must be off. */
+static void
+start_request (struct virtio_blk *dev, struct bio *bio)
+{
+  uint16_t head = alloc_desc (dev);
+  uint16_t data = alloc_desc (dev);
+  uint16_t status = alloc_desc (dev);
+  struct request_slot *slot = &dev->slots[head];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  slot->header.type = bio->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+  slot->header.reserved = 0;
+  slot->header.sector = bio->sector;
+  slot->status = 0xff;
+  slot->bio = bio;
+  block_started (bio);
+
+  set_desc (dev, head, &slot->header, sizeof slot->header,
+            VRING_DESC_F_NEXT, data);
+  set_desc (dev, data, bio->buffer, bio->cnt * BLOCK_SECTOR_SIZE,
+            VRING_DESC_F_NEXT | (bio->write ? 0 : VRING_DESC_F_WRITE), status);
+  set_desc (dev, status, &slot->status, 1, VRING_DESC_F_WRITE, 0);
+
+  dev->avail->ring[dev->avail->idx % dev->queue_size] = head;
+  barrier ();
+  dev->avail->idx++;
+  barrier ();
+  outw (reg_queue_notify (dev), 0);
+}
+
+/* Queues BIO on device DEV_ and returns at once.  BIO->DONE is
+   called from the interrupt handler when the transfer
+   completes.  BIO->BUFFER must be in kernel virtual memory. */
+static void
+virtio_blk_submit (void *dev_, struct bio *bio)
+{
+  struct virtio_blk *dev = dev_;
+  enum intr_level old_level;
+
+  ASSERT (is_kernel_vaddr (bio->buffer));
+
+  bio->driver = dev;
+  old_level = intr_disable ();
+  if (dev->free_cnt >= DESCS_PER_REQUEST && list_empty (&dev->pending))
+    start_request (dev, bio);
+  else
+    list_push_back (&dev->pending, &bio->elem);
+  intr_set_level (old_level);
+}
+
+/* Completion function for synchronous requests: wakes up the
+   thread waiting on the semaphore in BIO->AUX. */
+static void
+wake_waiter (struct bio *bio)
+{
+  sema_up (bio->aux);
+}
+
+/* Transfers CNT sectors starting at SECTOR between device DEV
+   and BUFFER, writing to the device if WRITE is true, and waits
+   for completion.  BUFFER must be in kernel virtual memory: the
+   block layer bounces user buffers before they get here. */
+static void
+transfer (struct virtio_blk *dev, block_sector_t sector, size_t cnt,
+          void *buffer_, bool write)
+{
+  uint8_t *buffer = buffer_;
+
+  while (cnt > 0)
+    {
+      struct semaphore done;
+      struct bio bio;
+
+      sema_init (&done, 0);
+      bio.sector = sector;
+      bio.cnt = cnt < BIO_MAX_SECTORS ? cnt : BIO_MAX_SECTORS;
+      bio.buffer = buffer;
+      bio.write = write;
+      bio.done = wake_waiter;
+      bio.aux = &done;
+      bio.block = NULL;
+      virtio_blk_submit (dev, &bio);
+      sema_down (&done);
+
+      buffer += bio.cnt * BLOCK_SECTOR_SIZE;
+      sector += bio.cnt;
+      cnt -= bio.cnt;
+    }
+}
+
+/* Reads CNT sectors starting at SECTOR from device DEV into
+   BUFFER. */
+static void
+virtio_blk_read_multiple (void *dev, block_sector_t sector, size_t cnt,
+                          void *buffer)
+{
+  transfer (dev, sector, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SECTOR to device DEV from
+   BUFFER.  Returns after the device has completed the write. */
+static void
+virtio_blk_write_multiple (void *dev, block_sector_t sector, size_t cnt,
+                           const void *buffer)
+{
+  transfer (dev, sector, cnt, (void *) buffer, true);
+}
+
+/* Reads sector SECTOR from device DEV into BUFFER. */
+static void
+virtio_blk_read (void *dev, block_sector_t sector, void *buffer)
+{
+  transfer (dev, sector, 1, buffer, false);
+}
+
+/* Writes sector SECTOR to device DEV from BUFFER. */
+static void
+virtio_blk_write (void *dev, block_sector_t sector, const void *buffer)
+{
+  transfer (dev, sector, 1, (void *) buffer, true);
+}
+
+static struct block_operations virtio_blk_operations =
+  {
+    virtio_blk_read,
+    virtio_blk_write,
+    virtio_blk_read_multiple,
+    virtio_blk_write_multiple,
+    virtio_blk_submit
+  };
+
+/* Completes the requests DEV has finished and starts pending
+   ones in the freed descriptors. */
+static void
+service_device (struct virtio_blk *dev)
+{
+  while (dev->last_used != dev->used->idx)
+    {
+      struct vring_used_elem *e
+        = &dev->used->ring[dev->last_used % dev->queue_size];
+      struct request_slot *slot = &dev->slots[e->id];
+      struct bio *bio = slot->bio;
+
+      dev->last_used++;
+      if (slot->status != 0)
+        PANIC ("%s: %s failed, sector=%"PRDSNu, dev->name,
+               bio->write ? "write" : "read", bio->sector);
+      free_chain (dev, e->id);
+      block_complete (bio);
+    }
+
+  while (!list_empty (&dev->pending)
+         && dev->free_cnt >= DESCS_PER_REQUEST)
+    start_request (dev, list_entry (list_pop_front (&dev->pending),
+                                    struct bio, elem));
+}
+
+/* virtio interrupt handler. */
+static void
+interrupt_handler (struct intr_frame *f)
+{
+  size_t i;
+
+  for (i = 0; i < device_cnt; i++)
+    {
+      struct virtio_blk *dev = &devices[i];
+      if (dev->irq == f->vec_no && dev->slots != NULL
+          && (inb (reg_isr (dev)) & 1))
+        service_device (dev);
+    }
+}
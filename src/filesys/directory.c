@@ -30,13 +30,16 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 }
 
 /* Opens and returns the directory for the given INODE, of which
-   it takes ownership.  Returns a null pointer on failure. */
+   it takes ownership.  Returns a null pointer on failure.
+   Directory contents are metadata, so INODE is marked for
+   journaling. */
 struct dir *
 dir_open (struct inode *inode) 
 {
   struct dir *dir = calloc (1, sizeof *dir);
   if (inode != NULL && dir != NULL)
     {
+      inode_set_journaled (inode);
       dir->inode = inode;
       dir->pos = 0;
       return dir;
@@ -6,6 +6,7 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
@@ -23,11 +24,13 @@ filesys_init (bool format)
 
   inode_init ();
   free_map_init ();
+  journal_init (format);
 
   if (format) 
     do_format ();
 
   free_map_open ();
+  journal_start ();
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -35,25 +38,35 @@ filesys_init (bool format)
 void
 filesys_done (void) 
 {
+  inode_flush_all ();
   free_map_close ();
+  journal_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
-   or if internal memory allocation fails. */
+   or if internal memory allocation fails.
+   The new inode, its directory entry and the free map changes
+   reach the disk together as one journal transaction. */
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = (dir != NULL
+             && free_map_allocate (1, &inode_sector)
+             && inode_create (inode_sector, initial_size)
+             && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  if (!filesys_end_op ())
+    success = false;
 
   return success;
 }
@@ -83,13 +96,35 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir); 
+  if (!filesys_end_op ())
+    success = false;
 
   return success;
 }
 
+/* Ends a file system operation begun with journal_begin().  If
+   the journal discarded the operation's updates, because it
+   logged more sectors than it had room for, rereads the free map
+   and the open inodes, whose copies in memory may hold changes
+   that never reached the log.  Returns true if the operation's
+   updates were kept, false if they were discarded. */
+bool
+filesys_end_op (void)
+{
+  if (journal_end ())
+    return true;
+  free_map_read ();
+  inode_reload_all ();
+  return false;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
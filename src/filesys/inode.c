@@ -5,19 +5,45 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Bytes of file data that fit in the inode sector itself. */
+#define INODE_INLINE_BYTES (BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t))
+
+/* Written bits per sector of a written map, and the most data
+   sectors whose written bits fit in the inode sector. */
+#define MAP_SECTOR_BITS (BLOCK_SECTOR_SIZE * 8)
+#define INODE_MAP_BITS (INODE_INLINE_BYTES * 8)
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data stored in inline_data. */
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+   A file of at most INODE_INLINE_BYTES bytes keeps its data in
+   inline_data and has no data sectors at all, so reading it
+   costs only the inode sector.
+
+   Larger files are allocated but not zeroed on creation.  Their
+   written map has one bit per data sector, set once the sector
+   holds data; sectors whose bit is clear read as zeros without
+   touching the disk and are never written just to zero them.
+   The map lives in inline_data if it fits there, and otherwise
+   in map_sectors() sectors just past the data sectors. */
 struct inode_disk
   {
     block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t flags;                     /* INODE_* flags. */
+    uint8_t inline_data[INODE_INLINE_BYTES]; /* Data of small files,
+                                                or written map. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,6 +54,16 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* Returns the number of sectors that hold the written map of a
+   file with SECTORS data sectors, which is 0 if the map fits in
+   the inode sector. */
+static inline size_t
+map_sectors (size_t sectors)
+{
+  return sectors <= INODE_MAP_BITS ? 0 : DIV_ROUND_UP (sectors,
+                                                       MAP_SECTOR_BITS);
+}
+
 /* In-memory inode. */
 struct inode 
   {
@@ -36,9 +72,122 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    bool journaled;                     /* Is data metadata to journal? */
+    unsigned version;                   /* Advanced by writes. */
+    struct list pages;                  /* Cached pages of data. */
+    uint8_t *written;                   /* Written map, or null if
+                                           inline. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Page cache.
+
+   Data of regular files is read and written in whole pages held
+   in a per-inode cache, shared by read(), write() and mmap(): a
+   mapped file page is the cache page itself, so there is a
+   single copy of the data and writes through either path are
+   immediately visible to the other.  Dirty pages are written
+   back when evicted, when their inode is last closed, and at
+   shutdown.
+
+   Metadata (journaled) and inline inodes bypass the cache.
+   Like the rest of this file, the cache relies on its callers
+   to serialize access to the file system. */
+
+/* Number of pages the cache holds before it evicts. */
+#define CACHE_PAGES 64
+
+/* Sectors in one cached page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A page of file data in the page cache. */
+struct cache_page
+  {
+    struct list_elem inode_elem;        /* Element in inode's pages. */
+    struct list_elem lru_elem;          /* Element in cache_lru. */
+    struct inode *inode;                /* Inode owning the data. */
+    size_t index;                       /* Page number within file. */
+    uint8_t *kpage;                     /* Page of data. */
+    bool dirty;                         /* Newer than on disk? */
+    int map_cnt;                        /* Number of user mappings. */
+  };
+
+/* All cached pages, least recently used first. */
+static struct list cache_lru;
+
+/* Number of pages in cache_lru. */
+static size_t cache_cnt;
+
+static bool read_written_map (struct inode *);
+
+/* Reads data sector SECTOR of INODE into BUFFER. */
+static void
+read_sector (const struct inode *inode, block_sector_t sector, void *buffer)
+{
+  if (inode->journaled)
+    journal_read (sector, buffer);
+  else
+    block_read (fs_device, sector, buffer);
+}
+
+/* Writes BUFFER to data sector SECTOR of INODE.  Sectors of
+   journaled inodes are logged rather than written in place. */
+static void
+write_sector (const struct inode *inode, block_sector_t sector,
+              const void *buffer)
+{
+  if (inode->journaled)
+    journal_write (sector, buffer);
+  else
+    block_write (fs_device, sector, buffer);
+}
+
+/* Returns true if INODE's data lives in its inode sector. */
+static inline bool
+is_inline (const struct inode *inode)
+{
+  return (inode->data.flags & INODE_INLINE) != 0;
+}
+
+/* Returns true if data sector SECTOR of INODE has never been
+   written, so that its contents are all zeros. */
+static bool
+is_unwritten (const struct inode *inode, block_sector_t sector)
+{
+  size_t idx = sector - inode->data.start;
+  return (inode->written[idx / 8] & (1u << idx % 8)) == 0;
+}
+
+/* Sets the written bits of the CNT data sectors of INODE starting
+   at SECTOR, which the caller has just written, and logs the
+   parts of the written map that change.  The data goes to disk
+   first, so a sector is never exposed with stale contents. */
+static void
+mark_written (struct inode *inode, block_sector_t sector, size_t cnt)
+{
+  size_t first = sector - inode->data.start;
+  size_t data_sectors = bytes_to_sectors (inode->data.length);
+  bool changed = false;
+  size_t idx;
+
+  for (idx = first; idx < first + cnt; idx++)
+    if (is_unwritten (inode, inode->data.start + idx))
+      {
+        inode->written[idx / 8] |= 1u << idx % 8;
+        changed = true;
+      }
+  if (!changed)
+    return;
+
+  if (map_sectors (data_sectors) == 0)
+    journal_write (inode->sector, &inode->data);
+  else
+    for (idx = first / MAP_SECTOR_BITS;
+         idx <= (first + cnt - 1) / MAP_SECTOR_BITS; idx++)
+      journal_write (inode->data.start + data_sectors + idx,
+                     inode->written + idx * BLOCK_SECTOR_SIZE);
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
@@ -53,6 +202,266 @@ byte_to_sector (const struct inode *inode, off_t pos)
     return -1;
 }
 
+/* Returns the cached page INDEX of INODE, or a null pointer if
+   it is not cached. */
+static struct cache_page *
+cache_lookup (struct inode *inode, size_t index)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&inode->pages); e != list_end (&inode->pages);
+       e = list_next (e))
+    {
+      struct cache_page *cp = list_entry (e, struct cache_page, inode_elem);
+      if (cp->index == index)
+        return cp;
+    }
+  return NULL;
+}
+
+/* Returns the number of sectors of cached page INDEX of INODE
+   that lie within the file. */
+static size_t
+page_sectors (const struct inode *inode, size_t index)
+{
+  off_t left = inode_length (inode) - (off_t) index * PGSIZE;
+  size_t cnt = bytes_to_sectors (left > 0 ? left : 0);
+  return cnt < SECTORS_PER_PAGE ? cnt : SECTORS_PER_PAGE;
+}
+
+/* Writes CP back to disk if it is dirty, with a single request
+   covering the sectors within the file.  Cached inodes are not
+   journaled, so this goes straight to the device. */
+static void
+cache_write_back (struct cache_page *cp)
+{
+  struct inode *inode = cp->inode;
+  size_t cnt = page_sectors (inode, cp->index);
+  block_sector_t sector;
+
+  if (!cp->dirty || cnt == 0)
+    return;
+  sector = byte_to_sector (inode, cp->index * PGSIZE);
+  block_write_multiple (fs_device, sector, cnt, cp->kpage);
+  mark_written (inode, sector, cnt);
+  cp->dirty = false;
+}
+
+/* Writes back and frees CP, which must not be mapped. */
+static void
+cache_evict (struct cache_page *cp)
+{
+  ASSERT (cp->map_cnt == 0);
+
+  cache_write_back (cp);
+  list_remove (&cp->inode_elem);
+  list_remove (&cp->lru_elem);
+  palloc_free_page (cp->kpage);
+  free (cp);
+  cache_cnt--;
+}
+
+/* Evicts the least recently used unmapped page.  Returns false
+   if every cached page is mapped. */
+static bool
+cache_evict_lru (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&cache_lru); e != list_end (&cache_lru);
+       e = list_next (e))
+    {
+      struct cache_page *cp = list_entry (e, struct cache_page, lru_elem);
+      if (cp->map_cnt == 0)
+        {
+          cache_evict (cp);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Returns page INDEX of INODE, reading it into the cache if
+   necessary.  When the cache is full and nothing can be
+   evicted, a page that will be mapped (MAPPING) is refused,
+   since mappings pin it, while reads and writes allocate past
+   the limit.  Returns a null pointer on failure. */
+static struct cache_page *
+cache_get (struct inode *inode, size_t index, bool mapping)
+{
+  struct cache_page *cp;
+  size_t cnt;
+
+  cp = cache_lookup (inode, index);
+  if (cp != NULL)
+    {
+      list_remove (&cp->lru_elem);
+      list_push_back (&cache_lru, &cp->lru_elem);
+      return cp;
+    }
+
+  if (cache_cnt >= CACHE_PAGES && !cache_evict_lru () && mapping)
+    return NULL;
+  cp = malloc (sizeof *cp);
+  if (cp == NULL)
+    return NULL;
+  cp->kpage = palloc_get_page (0);
+  if (cp->kpage == NULL && cache_evict_lru ())
+    cp->kpage = palloc_get_page (0);
+  if (cp->kpage == NULL)
+    {
+      free (cp);
+      return NULL;
+    }
+
+  /* Read each run of written sectors within the file in one
+     request; the rest of the page reads as zeros. */
+  cnt = page_sectors (inode, index);
+  if (cnt > 0)
+    {
+      block_sector_t sector = byte_to_sector (inode, index * PGSIZE);
+      size_t i = 0;
+      while (i < cnt)
+        {
+          size_t run = 0;
+          while (i + run < cnt && !is_unwritten (inode, sector + i + run))
+            run++;
+          if (run > 0)
+            block_read_multiple (fs_device, sector + i, run,
+                                 cp->kpage + i * BLOCK_SECTOR_SIZE);
+          else
+            {
+              memset (cp->kpage + i * BLOCK_SECTOR_SIZE, 0,
+                      BLOCK_SECTOR_SIZE);
+              run = 1;
+            }
+          i += run;
+        }
+    }
+  memset (cp->kpage + cnt * BLOCK_SECTOR_SIZE, 0,
+          PGSIZE - cnt * BLOCK_SECTOR_SIZE);
+
+  cp->inode = inode;
+  cp->index = index;
+  cp->dirty = false;
+  cp->map_cnt = 0;
+  list_push_back (&inode->pages, &cp->inode_elem);
+  list_push_back (&cache_lru, &cp->lru_elem);
+  cache_cnt++;
+  return cp;
+}
+
+/* Reads SIZE bytes at OFFSET in INODE into BUFFER through the
+   page cache.  Returns the number of bytes read. */
+static off_t
+cache_read_at (struct inode *inode, uint8_t *buffer, off_t size,
+               off_t offset)
+{
+  off_t bytes_read = 0;
+
+  while (size > 0)
+    {
+      /* Page to read, starting byte offset within page. */
+      int page_ofs = offset % PGSIZE;
+      struct cache_page *cp;
+
+      /* Bytes left in inode, bytes left in page, lesser of the two. */
+      off_t inode_left = inode_length (inode) - offset;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = inode_left < page_left ? inode_left : page_left;
+
+      /* Number of bytes to actually copy out of this page. */
+      int chunk_size = size < min_left ? size : min_left;
+      if (chunk_size <= 0)
+        break;
+
+      cp = cache_get (inode, offset / PGSIZE, false);
+      if (cp == NULL)
+        break;
+      memcpy (buffer + bytes_read, cp->kpage + page_ofs, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_read += chunk_size;
+    }
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE at OFFSET through the
+   page cache.  Returns the number of bytes written. */
+static off_t
+cache_write_at (struct inode *inode, const uint8_t *buffer, off_t size,
+                off_t offset)
+{
+  off_t bytes_written = 0;
+
+  while (size > 0)
+    {
+      /* Page to write, starting byte offset within page. */
+      int page_ofs = offset % PGSIZE;
+      struct cache_page *cp;
+
+      /* Bytes left in inode, bytes left in page, lesser of the two. */
+      off_t inode_left = inode_length (inode) - offset;
+      int page_left = PGSIZE - page_ofs;
+      int min_left = inode_left < page_left ? inode_left : page_left;
+
+      /* Number of bytes to actually write into this page. */
+      int chunk_size = size < min_left ? size : min_left;
+      if (chunk_size <= 0)
+        break;
+
+      cp = cache_get (inode, offset / PGSIZE, false);
+      if (cp == NULL)
+        break;
+      memcpy (cp->kpage + page_ofs, buffer + bytes_written, chunk_size);
+      cp->dirty = true;
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+  return bytes_written;
+}
+
+/* Returns the kernel address of the cached page of INODE that
+   holds byte OFFSET, which must be page-aligned, for mapping
+   into a user address space.  The page stays in the cache until
+   released with inode_unmap_page().  Returns a null pointer if
+   INODE's data is not cached or the cache has no room, in which
+   case the caller should fall back to a private copy. */
+void *
+inode_map_page (struct inode *inode, off_t offset)
+{
+  struct cache_page *cp;
+
+  ASSERT (offset % PGSIZE == 0);
+  if (is_inline (inode) || inode->journaled)
+    return NULL;
+  cp = cache_get (inode, offset / PGSIZE, true);
+  if (cp == NULL)
+    return NULL;
+  cp->map_cnt++;
+  inode->version++;
+  return cp->kpage;
+}
+
+/* Releases a mapping obtained from inode_map_page() for byte
+   OFFSET of INODE.  DIRTY says whether the mapping wrote to the
+   page. */
+void
+inode_unmap_page (struct inode *inode, off_t offset, bool dirty)
+{
+  struct cache_page *cp = cache_lookup (inode, offset / PGSIZE);
+
+  ASSERT (cp != NULL && cp->map_cnt > 0);
+  cp->map_cnt--;
+  if (dirty)
+    cp->dirty = true;
+}
+
 /* List of open inodes, so that opening a single inode twice
    returns the same `struct inode'. */
 static struct list open_inodes;
@@ -62,11 +471,28 @@ void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  list_init (&cache_lru);
+}
+
+/* Writes all dirty cached pages back to disk. */
+void
+inode_flush_all (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&cache_lru); e != list_end (&cache_lru);
+       e = list_next (e))
+    cache_write_back (list_entry (e, struct cache_page, lru_elem));
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The inode sector itself is written through the
+   journal.  Data of small files is stored inline, zeroed along
+   with the rest of the inode.  Data sectors of larger files are
+   left unwritten, and only their empty written map is written,
+   which takes one sector for every 4,096 data sectors past the
+   first 3,968.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
@@ -87,17 +513,23 @@ inode_create (block_sector_t sector, off_t length)
       size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (length <= (off_t) INODE_INLINE_BYTES)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          disk_inode->flags = INODE_INLINE;
+          journal_write (sector, disk_inode);
+          success = true;
+        }
+      else if (free_map_allocate (sectors + map_sectors (sectors),
+                                  &disk_inode->start))
+        {
+          /* The map sectors are not reachable until the inode is
+             committed, so they can be cleared in place. */
+          static char zeros[BLOCK_SECTOR_SIZE];
+          size_t i;
+
+          for (i = 0; i < map_sectors (sectors); i++)
+            block_write (fs_device, disk_inode->start + sectors + i, zeros);
+          journal_write (sector, disk_inode);
           success = true; 
         } 
       free (disk_inode);
@@ -130,6 +562,12 @@ inode_open (block_sector_t sector)
   inode = malloc (sizeof *inode);
   if (inode == NULL)
     return NULL;
+  journal_read (sector, &inode->data);
+  if (!read_written_map (inode))
+    {
+      free (inode);
+      return NULL;
+    }
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
@@ -137,10 +575,61 @@ inode_open (block_sector_t sector)
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->journaled = false;
+  inode->version = 0;
+  list_init (&inode->pages);
   return inode;
 }
 
+/* Points INODE->written at INODE's written map, reading it from
+   its map sectors if it does not fit in the inode.  Returns false
+   if memory allocation fails. */
+static bool
+read_written_map (struct inode *inode)
+{
+  size_t sectors = bytes_to_sectors (inode->data.length);
+  size_t i;
+
+  if (is_inline (inode))
+    inode->written = NULL;
+  else if (map_sectors (sectors) == 0)
+    inode->written = inode->data.inline_data;
+  else
+    {
+      inode->written = malloc (map_sectors (sectors) * BLOCK_SECTOR_SIZE);
+      if (inode->written == NULL)
+        return false;
+      for (i = 0; i < map_sectors (sectors); i++)
+        journal_read (inode->data.start + sectors + i,
+                      inode->written + i * BLOCK_SECTOR_SIZE);
+    }
+  return true;
+}
+
+/* Rereads every open inode, and its written map, as the journal
+   has it, discarding changes made in memory that were not
+   logged. */
+void
+inode_reload_all (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e))
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      size_t sectors = bytes_to_sectors (inode->data.length);
+      size_t i;
+
+      journal_read (inode->sector, &inode->data);
+      if (!is_inline (inode))
+        for (i = 0; i < map_sectors (sectors); i++)
+          journal_read (inode->data.start + sectors + i,
+                        inode->written + i * BLOCK_SECTOR_SIZE);
+      inode->version++;
+    }
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
@@ -157,6 +646,16 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns a number that changes whenever INODE's data may have
+   changed: at each write, and each time a page of it is mapped
+   into user memory, where it may be written at any time.  It is
+   only meaningful while INODE is open. */
+unsigned
+inode_version (const struct inode *inode)
+{
+  return inode->version;
+}
+
 /* Closes INODE and writes it to disk.
    If this was the last reference to INODE, frees its memory.
    If INODE was also a removed inode, frees its blocks. */
@@ -172,15 +671,33 @@ inode_close (struct inode *inode)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+
+      /* Drop cached pages, whose data is garbage if removed. */
+      while (!list_empty (&inode->pages))
+        {
+          struct cache_page *cp = list_entry (list_front (&inode->pages),
+                                              struct cache_page, inode_elem);
+          if (inode->removed)
+            cp->dirty = false;
+          cache_evict (cp);
+        }
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          journal_begin ();
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          if (!is_inline (inode))
+            {
+              size_t sectors = bytes_to_sectors (inode->data.length);
+              free_map_release (inode->data.start,
+                                sectors + map_sectors (sectors));
+            }
+          filesys_end_op ();
         }
 
+      if (inode->written != inode->data.inline_data)
+        free (inode->written);
       free (inode); 
     }
 }
@@ -194,6 +711,24 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if INODE has been removed, so that its sectors
+   will be freed once it is last closed. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Marks INODE as holding file system metadata, such as a
+   directory or the free map, whose data sectors must be updated
+   through the journal. */
+void
+inode_set_journaled (struct inode *inode)
+{
+  ASSERT (inode != NULL);
+  inode->journaled = true;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
@@ -204,6 +739,18 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  if (is_inline (inode))
+    {
+      if (offset >= inode_length (inode))
+        return 0;
+      if (size > inode_length (inode) - offset)
+        size = inode_length (inode) - offset;
+      memcpy (buffer, inode->data.inline_data + offset, size);
+      return size;
+    }
+  if (!inode->journaled)
+    return cache_read_at (inode, buffer, size, offset);
+
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -220,10 +767,15 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      if (is_unwritten (inode, sector_idx))
+        {
+          /* Never written, so all zeros. */
+          memset (buffer + bytes_read, 0, chunk_size);
+        }
+      else if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          read_sector (inode, sector_idx, buffer + bytes_read);
         }
       else 
         {
@@ -235,7 +787,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
               if (bounce == NULL)
                 break;
             }
-          block_read (fs_device, sector_idx, bounce);
+          read_sector (inode, sector_idx, bounce);
           memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
@@ -264,6 +816,20 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 
   if (inode->deny_write_cnt)
     return 0;
+  inode->version++;
+
+  if (is_inline (inode))
+    {
+      if (offset >= inode_length (inode))
+        return 0;
+      if (size > inode_length (inode) - offset)
+        size = inode_length (inode) - offset;
+      memcpy (inode->data.inline_data + offset, buffer, size);
+      journal_write (inode->sector, &inode->data);
+      return size;
+    }
+  if (!inode->journaled)
+    return cache_write_at (inode, buffer, size, offset);
 
   while (size > 0) 
     {
@@ -284,7 +850,7 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          write_sector (inode, sector_idx, buffer + bytes_written);
         }
       else 
         {
@@ -299,13 +865,15 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
           /* If the sector contains data before or after the chunk
              we're writing, then we need to read in the sector
              first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
+          if ((sector_ofs > 0 || chunk_size < sector_left)
+              && !is_unwritten (inode, sector_idx))
+            read_sector (inode, sector_idx, bounce);
           else
             memset (bounce, 0, BLOCK_SECTOR_SIZE);
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          write_sector (inode, sector_idx, bounce);
         }
+      mark_written (inode, sector_idx, 1);
 
       /* Advance. */
       size -= chunk_size;
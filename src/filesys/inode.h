@@ -8,16 +8,25 @@
 struct bitmap;
 
 void inode_init (void);
+void inode_flush_all (void);
 bool inode_create (block_sector_t, off_t);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
+void inode_reload_all (void);
 block_sector_t inode_get_inumber (const struct inode *);
+unsigned inode_version (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+bool inode_is_removed (const struct inode *);
+void inode_set_journaled (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
 
+/* Page cache mappings. */
+void *inode_map_page (struct inode *, off_t offset);
+void inode_unmap_page (struct inode *, off_t offset, bool dirty);
+
 #endif /* filesys/inode.h */
@@ -0,0 +1,550 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Write-ahead log for file system metadata.
+
+   Inode sectors, directory contents and the free map are never
+   written in place directly.  Instead, journal_write() records
+   the new contents of a sector in the running transaction in
+   memory.  Every JOURNAL_COMMIT_TICKS the journal thread
+   commits the running transaction as a group: all of its
+   sectors are written sequentially to the log area, followed by
+   the log header, which acts as the commit record.  Only then
+   are the sectors written to their home locations and the
+   header cleared again.
+
+   An operation between journal_begin() and journal_end() logs
+   its sectors privately, and they join the running transaction
+   only when it ends.  An operation that needs more than its
+   reservation of JOURNAL_OP_BLOCKS sectors fails as a whole
+   instead: none of its updates are logged, and journal_end()
+   returns false.
+
+   After a crash, journal_init() finds a committed header and
+   copies the logged sectors home, so that every transaction is
+   either applied completely or not at all. */
+
+/* Identifies a committed log header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Maximum number of sectors in one transaction. */
+#define JOURNAL_MAX_BLOCKS (JOURNAL_SECTORS - 1)
+
+/* Sectors reserved for each open handle, so that an operation
+   that has begun can always finish inside the running
+   transaction, unless it logs more sectors than this.  An update
+   made outside any handle gets a handle of its own. */
+#define JOURNAL_OP_BLOCKS 16
+
+/* How often the journal thread commits, in timer ticks. */
+#define JOURNAL_COMMIT_TICKS TIMER_FREQ
+
+/* On-disk log header.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC if committed. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t block_cnt;                 /* Number of logged sectors. */
+    block_sector_t homes[JOURNAL_MAX_BLOCKS];   /* Home of each sector. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 12
+                   - JOURNAL_MAX_BLOCKS * sizeof (block_sector_t)];
+  };
+
+/* A metadata sector logged in a transaction. */
+struct journal_block
+  {
+    struct list_elem elem;              /* Element in transaction. */
+    block_sector_t sector;              /* Home sector. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* New contents. */
+  };
+
+/* A group of metadata updates committed together. */
+struct transaction
+  {
+    struct list blocks;                 /* List of journal_blocks. */
+    size_t block_cnt;                   /* Number of blocks. */
+  };
+
+/* The running transaction, which collects new updates, and the
+   committing transaction, which is being written to disk (or
+   null).  Both point into TRANSACTIONS. */
+static struct transaction transactions[2];
+static struct transaction *running;
+static struct transaction *committing;
+
+/* Blocks for both transactions at their largest, counting the
+   blocks of open handles as part of the running transaction.
+   Those not in use are kept in SPARE_BLOCKS, so logging a sector
+   never has to wait for memory. */
+static struct journal_block block_pool[2 * JOURNAL_MAX_BLOCKS];
+static struct list spare_blocks;
+
+/* Protects the transactions, SPARE_BLOCKS and ACTIVE_HANDLES. */
+static struct lock journal_lock;
+
+/* Serializes commits. */
+static struct lock commit_lock;
+
+/* Number of threads inside journal_begin()/journal_end(). */
+static int active_handles;
+
+/* Signaled when ACTIVE_HANDLES drops to 0. */
+static struct condition handles_done;
+
+/* Signaled when a committing transaction has been checkpointed. */
+static struct condition checkpoint_done;
+
+/* Header buffer, owned by the holder of commit_lock. */
+static struct journal_header header;
+
+/* Sequence number of the next transaction. */
+static uint32_t next_seq;
+
+/* Set by journal_done() to stop the journal thread. */
+static bool stopping;
+
+/* See journal.h. */
+bool journal_crash;
+
+static thread_func journal_thread;
+static void commit_transaction (void);
+static void replay (void);
+static struct journal_block *find_block (struct transaction *,
+                                         block_sector_t);
+static struct journal_block *find_handle_block (block_sector_t);
+static void free_blocks (struct transaction *);
+
+/* Initializes the journal.  Unless FORMAT is true, first replays
+   any transaction that was committed to the log but not yet
+   checkpointed when the system went down. */
+void
+journal_init (bool format)
+{
+  int i;
+
+  ASSERT (sizeof header == BLOCK_SECTOR_SIZE);
+
+  for (i = 0; i < 2; i++)
+    {
+      list_init (&transactions[i].blocks);
+      transactions[i].block_cnt = 0;
+    }
+  list_init (&spare_blocks);
+  for (i = 0; i < 2 * JOURNAL_MAX_BLOCKS; i++)
+    list_push_back (&spare_blocks, &block_pool[i].elem);
+  running = &transactions[0];
+  committing = NULL;
+  lock_init (&journal_lock);
+  lock_init (&commit_lock);
+  cond_init (&handles_done);
+  cond_init (&checkpoint_done);
+  active_handles = 0;
+  stopping = false;
+
+  if (!format)
+    replay ();
+
+  /* Start from an empty log. */
+  memset (&header, 0, sizeof header);
+  header.seq = next_seq;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Starts the thread that commits transactions in the
+   background.  With journal_crash, there is none, so the last
+   operations before shutdown stay in the running transaction. */
+void
+journal_start (void)
+{
+  if (journal_crash)
+    return;
+  if (thread_create ("journal", PRI_DEFAULT, journal_thread, NULL)
+      == TID_ERROR)
+    PANIC ("can't start journal thread");
+}
+
+/* Commits and checkpoints everything logged so far and stops the
+   journal thread. */
+void
+journal_done (void)
+{
+  stopping = true;
+  commit_transaction ();
+}
+
+/* Begins an operation whose metadata updates must reach the disk
+   atomically.  Waits for a commit if the running transaction
+   might not have room for the operation.  Calls may nest. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+  list_init (&t->journal_blocks);
+  t->journal_block_cnt = 0;
+  t->journal_failed = false;
+
+  lock_acquire (&journal_lock);
+  while (running->block_cnt + (active_handles + 1) * JOURNAL_OP_BLOCKS
+         > JOURNAL_MAX_BLOCKS)
+    {
+      lock_release (&journal_lock);
+      commit_transaction ();
+      lock_acquire (&journal_lock);
+    }
+  active_handles++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation begun with journal_begin(), adding its
+   updates to the running transaction.  Returns true if
+   successful, false if the operation logged more sectors than
+   its reservation, in which case none of its updates are kept.
+   A nested call returns true; only the outermost one reports
+   failure. */
+bool
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+  bool success;
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return true;
+
+  lock_acquire (&journal_lock);
+  success = !t->journal_failed;
+  while (!list_empty (&t->journal_blocks))
+    {
+      struct journal_block *b = list_entry (list_pop_front
+                                            (&t->journal_blocks),
+                                            struct journal_block, elem);
+      struct journal_block *old = find_block (running, b->sector);
+      if (success && old == NULL)
+        {
+          list_push_back (&running->blocks, &b->elem);
+          running->block_cnt++;
+        }
+      else
+        {
+          if (success)
+            memcpy (old->data, b->data, BLOCK_SECTOR_SIZE);
+          list_push_back (&spare_blocks, &b->elem);
+        }
+    }
+  t->journal_block_cnt = 0;
+  if (--active_handles == 0)
+    cond_broadcast (&handles_done, &journal_lock);
+  lock_release (&journal_lock);
+  return success;
+}
+
+/* Reads metadata sector SECTOR into BUFFER, which must have room
+   for BLOCK_SECTOR_SIZE bytes, taking into account updates that
+   have not reached their home location yet. */
+void
+journal_read (block_sector_t sector, void *buffer)
+{
+  struct journal_block *b;
+
+  lock_acquire (&journal_lock);
+  b = NULL;
+  if (thread_current ()->journal_depth > 0)
+    b = find_handle_block (sector);
+  if (b == NULL)
+    b = find_block (running, sector);
+  if (b == NULL && committing != NULL)
+    b = find_block (committing, sector);
+  if (b != NULL)
+    {
+      memcpy (buffer, b->data, BLOCK_SECTOR_SIZE);
+      lock_release (&journal_lock);
+      return;
+    }
+  lock_release (&journal_lock);
+
+  block_read (fs_device, sector, buffer);
+}
+
+/* Logs BUFFER, which must contain BLOCK_SECTOR_SIZE bytes, as the
+   new contents of metadata sector SECTOR in the current
+   operation, which joins the running transaction when it ends.
+   Outside any handle, first waits for a commit if the running
+   transaction is out of room.  If the operation has already
+   logged JOURNAL_OP_BLOCKS other sectors, marks it failed
+   instead.  Sectors are never written in place, which could both
+   lose atomicity and let a checkpoint of the committing
+   transaction overwrite newer contents. */
+void
+journal_write (block_sector_t sector, const void *buffer)
+{
+  struct thread *t = thread_current ();
+  bool own_handle = t->journal_depth == 0;
+  struct journal_block *b;
+
+  if (own_handle)
+    journal_begin ();
+
+  lock_acquire (&journal_lock);
+  b = find_handle_block (sector);
+  if (b == NULL)
+    {
+      /* journal_begin() reserved room for this many. */
+      if (t->journal_block_cnt >= JOURNAL_OP_BLOCKS)
+        t->journal_failed = true;
+      else
+        {
+          b = list_entry (list_pop_front (&spare_blocks),
+                          struct journal_block, elem);
+          b->sector = sector;
+          list_push_back (&t->journal_blocks, &b->elem);
+          t->journal_block_cnt++;
+        }
+    }
+  if (b != NULL)
+    memcpy (b->data, buffer, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+
+  if (own_handle)
+    journal_end ();
+}
+
+/* Drops any logged updates to the CNT sectors starting at SECTOR,
+   which are being freed.  If some of them are in the committing
+   transaction, waits for it to be checkpointed, so that the
+   stale metadata cannot later overwrite data written to the
+   sectors after they are reallocated. */
+void
+journal_forget (block_sector_t sector, size_t cnt)
+{
+  struct list_elem *e, *next;
+  bool busy;
+
+  lock_acquire (&journal_lock);
+  for (e = list_begin (&running->blocks); e != list_end (&running->blocks);
+       e = next)
+    {
+      struct journal_block *b = list_entry (e, struct journal_block, elem);
+      next = list_next (e);
+      if (b->sector >= sector && b->sector < sector + cnt)
+        {
+          list_remove (&b->elem);
+          running->block_cnt--;
+          list_push_back (&spare_blocks, &b->elem);
+        }
+    }
+  if (thread_current ()->journal_depth > 0)
+    {
+      struct list *blocks = &thread_current ()->journal_blocks;
+      for (e = list_begin (blocks); e != list_end (blocks); e = next)
+        {
+          struct journal_block *b = list_entry (e, struct journal_block,
+                                                elem);
+          next = list_next (e);
+          if (b->sector >= sector && b->sector < sector + cnt)
+            {
+              list_remove (&b->elem);
+              thread_current ()->journal_block_cnt--;
+              list_push_back (&spare_blocks, &b->elem);
+            }
+        }
+    }
+
+  do
+    {
+      busy = false;
+      if (committing != NULL)
+        for (e = list_begin (&committing->blocks);
+             e != list_end (&committing->blocks); e = list_next (e))
+          {
+            struct journal_block *b = list_entry (e, struct journal_block,
+                                                  elem);
+            if (b->sector >= sector && b->sector < sector + cnt)
+              {
+                busy = true;
+                break;
+              }
+          }
+      if (busy)
+        cond_wait (&checkpoint_done, &journal_lock);
+    }
+  while (busy);
+  lock_release (&journal_lock);
+}
+
+/* Journal thread.  Commits the running transaction
+   periodically. */
+static void
+journal_thread (void *aux UNUSED)
+{
+  while (!stopping)
+    {
+      timer_sleep (JOURNAL_COMMIT_TICKS);
+      commit_transaction ();
+    }
+}
+
+/* Waits for all open handles to end, then writes the running
+   transaction to the log, commits it, and checkpoints it to the
+   home locations of its sectors. */
+static void
+commit_transaction (void)
+{
+  struct transaction *t;
+  struct list_elem *e;
+  block_sector_t log_sector;
+  size_t i;
+
+  lock_acquire (&commit_lock);
+
+  lock_acquire (&journal_lock);
+  while (active_handles > 0)
+    cond_wait (&handles_done, &journal_lock);
+  if (running->block_cnt == 0)
+    {
+      lock_release (&journal_lock);
+      lock_release (&commit_lock);
+      return;
+    }
+  t = committing = running;
+  running = t == &transactions[0] ? &transactions[1] : &transactions[0];
+  lock_release (&journal_lock);
+
+  /* Write the sectors to the log, one after another. */
+  memset (&header, 0, sizeof header);
+  log_sector = JOURNAL_SECTOR + 1;
+  i = 0;
+  for (e = list_begin (&t->blocks); e != list_end (&t->blocks);
+       e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block, elem);
+      block_write (fs_device, log_sector++, b->data);
+      header.homes[i++] = b->sector;
+    }
+
+  /* Commit. */
+  header.magic = JOURNAL_MAGIC;
+  header.seq = next_seq++;
+  header.block_cnt = t->block_cnt;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+
+  /* Checkpoint, unless simulating a crash at shutdown. */
+  if (stopping && journal_crash)
+    {
+      printf ("journal: crashed before checkpointing transaction "
+              "%"PRIu32"\n", header.seq);
+      lock_release (&commit_lock);
+      return;
+    }
+  for (e = list_begin (&t->blocks); e != list_end (&t->blocks);
+       e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block, elem);
+      block_write (fs_device, b->sector, b->data);
+    }
+  header.magic = 0;
+  header.block_cnt = 0;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+
+  lock_acquire (&journal_lock);
+  free_blocks (t);
+  committing = NULL;
+  cond_broadcast (&checkpoint_done, &journal_lock);
+  lock_release (&journal_lock);
+
+  lock_release (&commit_lock);
+}
+
+/* Copies the sectors of a committed transaction found in the log
+   to their home locations. */
+static void
+replay (void)
+{
+  uint8_t *buffer;
+  size_t i;
+
+  block_read (fs_device, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC)
+    {
+      next_seq = 0;
+      return;
+    }
+  next_seq = header.seq + 1;
+  if (header.block_cnt == 0 || header.block_cnt > JOURNAL_MAX_BLOCKS)
+    return;
+
+  buffer = malloc (BLOCK_SECTOR_SIZE);
+  if (buffer == NULL)
+    PANIC ("can't allocate journal replay buffer");
+  for (i = 0; i < header.block_cnt; i++)
+    {
+      block_read (fs_device, JOURNAL_SECTOR + 1 + i, buffer);
+      block_write (fs_device, header.homes[i], buffer);
+    }
+  free (buffer);
+
+  printf ("journal: replayed transaction %"PRIu32" (%"PRIu32" sectors)\n",
+          header.seq, header.block_cnt);
+}
+
+/* Returns the block for SECTOR in transaction T, or a null
+   pointer if T does not log SECTOR. */
+static struct journal_block *
+find_block (struct transaction *t, block_sector_t sector)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  for (e = list_begin (&t->blocks); e != list_end (&t->blocks);
+       e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block, elem);
+      if (b->sector == sector)
+        return b;
+    }
+  return NULL;
+}
+
+/* Returns the block for SECTOR logged by the current thread's
+   open handle, or a null pointer if it has not logged SECTOR.
+   The journal lock must be held. */
+static struct journal_block *
+find_handle_block (block_sector_t sector)
+{
+  struct list *blocks = &thread_current ()->journal_blocks;
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  for (e = list_begin (blocks); e != list_end (blocks); e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block, elem);
+      if (b->sector == sector)
+        return b;
+    }
+  return NULL;
+}
+
+/* Returns all of the blocks in transaction T to the spares.  The
+   journal lock must be held. */
+static void
+free_blocks (struct transaction *t)
+{
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  while (!list_empty (&t->blocks))
+    list_push_back (&spare_blocks, list_pop_front (&t->blocks));
+  t->block_cnt = 0;
+}
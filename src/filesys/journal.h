@@ -0,0 +1,33 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Number of sectors in the on-disk log, starting at
+   JOURNAL_SECTOR: one header sector followed by the logged
+   copies of metadata sectors. */
+#define JOURNAL_SECTORS 64
+
+/* If true, the journal commits only when it runs out of room,
+   and the commit at shutdown is not checkpointed, as if power
+   failed right after the commit record reached the disk.  Set by
+   the kernel command-line option -journal-crash, for testing
+   recovery. */
+extern bool journal_crash;
+
+void journal_init (bool format);
+void journal_start (void);
+void journal_done (void);
+
+/* Transactions. */
+void journal_begin (void);
+bool journal_end (void);
+
+/* Metadata sector access. */
+void journal_read (block_sector_t, void *);
+void journal_write (block_sector_t, const void *);
+void journal_forget (block_sector_t, size_t cnt);
+
+#endif /* filesys/journal.h */
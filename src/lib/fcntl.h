@@ -0,0 +1,12 @@
+#ifndef __LIB_FCNTL_H
+#define __LIB_FCNTL_H
+
+/* Commands for the fcntl system call. */
+#define F_GETFL 3               /* Get descriptor flags. */
+#define F_SETFL 4               /* Set descriptor flags. */
+
+/* Descriptor flags. */
+#define O_NONBLOCK 04000        /* Reads and writes that would wait
+                                   fail with -1 instead. */
+
+#endif /* lib/fcntl.h */
@@ -0,0 +1,10 @@
+#ifndef __LIB_FUTEX_H
+#define __LIB_FUTEX_H
+
+/* Operations for the futex system call. */
+#define FUTEX_WAIT 0            /* Sleep if the word still holds a
+                                   value. */
+#define FUTEX_WAKE 1            /* Wake up some threads sleeping on
+                                   the word. */
+
+#endif /* lib/futex.h */
@@ -0,0 +1,40 @@
+#ifndef __LIB_IOSTAT_H
+#define __LIB_IOSTAT_H
+
+/* Block device statistics, as reported by the kernel at
+   shutdown and returned to user programs by the iostat system
+   call. */
+
+/* Number of latency histogram buckets. */
+#define IOSTAT_BUCKETS 32
+
+struct iostat
+  {
+    char name[16];                      /* Device name, e.g. "hda1". */
+    char type[8];                       /* Role or type, e.g. "filesys". */
+
+    unsigned long long read_bytes;      /* Bytes read. */
+    unsigned long long write_bytes;     /* Bytes written. */
+    unsigned long long requests;        /* Requests made. */
+    unsigned long long sequential;      /* Requests beginning where the
+                                           previous one ended. */
+
+    /* Times below are in CPU timestamp counter cycles, which
+       CYCLES_PER_MS converts to real time.  It is 0 if the
+       kernel has not yet been running long enough to measure
+       it. */
+    unsigned long long cycles_per_ms;
+    unsigned long long queue_cycles;    /* Total time requests spent
+                                           queued before the device
+                                           started them. */
+    unsigned long long busy_cycles;     /* Total time from submission
+                                           to completion. */
+
+    /* Completed requests by latency: LATENCY[I] counts requests
+       that took at least 2**I cycles but less than 2**(I+1),
+       except that LATENCY[IOSTAT_BUCKETS - 1] also counts all
+       slower requests. */
+    unsigned long long latency[IOSTAT_BUCKETS];
+  };
+
+#endif /* lib/iostat.h */
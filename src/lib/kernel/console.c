@@ -1,4 +1,5 @@
 #include <console.h>
+#include <list.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include "devices/serial.h"
@@ -6,15 +7,59 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Most characters a printing function collects before appending
+   them to the log at once. */
+#define LINE_MAX 128
+
+/* Output being collected by a printing function.  Appended to
+   the log at each new-line, so that lines from different
+   threads do not mix. */
+struct line
+  {
+    char buf[LINE_MAX];         /* Characters not yet appended. */
+    size_t len;                 /* Number of characters in BUF. */
+    int char_cnt;               /* Characters printed in all. */
+  };
 
 static void vprintf_helper (char, void *);
-static void putchar_have_lock (uint8_t c);
+static void line_putc (struct line *, char);
+static void line_flush (struct line *);
+static void emit (const char *, size_t);
+static void write_direct (const char *, size_t);
+static void drain_log (void);
+static void console_thread_func (void *aux);
+
+/* The log, a circular buffer of output that the console thread
+   has yet to write to the vga and serial devices.  Printing
+   functions only append to it, so they neither wait on the
+   devices nor, except when it fills up, on each other.
+   LOG_HEAD and LOG_TAIL run freely, so characters LOG_TAIL
+   through LOG_HEAD - 1 (modulo LOG_SIZE) are pending.  LOG_SIZE
+   must be a power of 2.  Accessed only with interrupts off.
+   The first LOG_WRITING pending characters are being written by
+   the console thread. */
+#define LOG_SIZE 16384
+static char log_buf[LOG_SIZE];
+static size_t log_head, log_tail, log_writing;
+
+/* Threads waiting for room in the log or for it to drain. */
+static struct list log_waiters = LIST_INITIALIZER (log_waiters);
+
+/* The console thread, which drains the log, or a null pointer if
+   it has not been started.  CONSOLE_IDLE is true while it is
+   blocked waiting for output. */
+static struct thread *console_thread;
+static bool console_idle;
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
    safe to call them at any time.
    But this lock is useful to prevent simultaneous printf() calls
-   from mixing their output, which looks confusing. */
+   from mixing their output, which looks confusing.  Once the
+   console thread is running, only it writes to the devices, so
+   the lock is needed only before then. */
 static struct lock console_lock;
 
 /* True in ordinary circumstances: we want to use the console
@@ -67,6 +112,41 @@ console_init (void)
   use_console_lock = true;
 }
 
+/* Starts the console thread.  Until it runs, output is written
+   to the devices directly. */
+void
+console_start (void)
+{
+  struct semaphore started;
+
+  sema_init (&started, 0);
+  if (thread_create ("console", PRI_DEFAULT, console_thread_func,
+                     &started) == TID_ERROR)
+    PANIC ("Failed to start console thread");
+  sema_down (&started);
+}
+
+/* Waits until everything in the log has been written out to the
+   devices, or writes it out directly if waiting is impossible.
+   Called before shutting down, since the console thread may not
+   get to run again. */
+void
+console_flush (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (old_level == INTR_ON && console_thread != NULL && use_console_lock
+      && thread_current () != console_thread)
+    while (log_tail != log_head || !console_idle)
+      {
+        list_push_back (&log_waiters, &thread_current ()->elem);
+        thread_block ();
+      }
+  else
+    drain_log ();
+  intr_set_level (old_level);
+}
+
 /* Notifies the console that a kernel panic is underway,
    which warns it to avoid trying to take the console lock from
    now on. */
@@ -109,29 +189,19 @@ release_console (void)
     }
 }
 
-/* Returns true if the current thread has the console lock,
-   false otherwise. */
-static bool
-console_locked_by_current_thread (void) 
-{
-  return (intr_context ()
-          || !use_console_lock
-          || lock_held_by_current_thread (&console_lock));
-}
-
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
    Writes its output to both vga display and serial port. */
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct line line;
 
-  acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
-  release_console ();
+  line.len = line.char_cnt = 0;
+  __vprintf (format, args, vprintf_helper, &line);
+  line_flush (&line);
 
-  return char_cnt;
+  return line.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -139,53 +209,187 @@ vprintf (const char *format, va_list args)
 int
 puts (const char *s) 
 {
-  acquire_console ();
+  struct line line;
+
+  line.len = line.char_cnt = 0;
   while (*s != '\0')
-    putchar_have_lock (*s++);
-  putchar_have_lock ('\n');
-  release_console ();
+    line_putc (&line, *s++);
+  line_putc (&line, '\n');
+  line_flush (&line);
 
   return 0;
 }
 
-/* Writes the N characters in BUFFER to the console. */
+/* Writes the N characters in BUFFER to the console.  BUFFER is
+   copied into the log with interrupts off, so it must be kernel
+   memory: a page fault would let other output in mid-copy. */
 void
 putbuf (const char *buffer, size_t n) 
 {
-  acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
-  release_console ();
+  emit (buffer, n);
 }
 
 /* Writes C to the vga display and serial port. */
 int
 putchar (int c) 
 {
-  acquire_console ();
-  putchar_have_lock (c);
-  release_console ();
+  char ch = c;
+  emit (&ch, 1);
   
   return c;
 }
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (char c, void *line) 
+{
+  line_putc (line, c);
+}
+
+/* Adds C to LINE, appending LINE to the log if C ends the line
+   or LINE is full. */
+static void
+line_putc (struct line *line, char c)
+{
+  line->buf[line->len++] = c;
+  line->char_cnt++;
+  if (c == '\n' || line->len == LINE_MAX)
+    line_flush (line);
+}
+
+/* Appends the characters in LINE to the log. */
+static void
+line_flush (struct line *line)
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  if (line->len > 0)
+    {
+      emit (line->buf, line->len);
+      line->len = 0;
+    }
 }
 
-/* Writes C to the vga display and serial port.
-   The caller has already acquired the console lock if
-   appropriate. */
+/* Appends the N characters in S to the log, in one piece if
+   there is room.  Before the console thread has started, and
+   during a kernel panic, writes them directly instead. */
 static void
-putchar_have_lock (uint8_t c) 
+emit (const char *s, size_t n)
 {
-  ASSERT (console_locked_by_current_thread ());
-  write_cnt++;
-  serial_putc (c);
-  vga_putc (c);
+  enum intr_level old_level = intr_disable ();
+
+  write_cnt += n;
+  if (console_thread == NULL || !use_console_lock)
+    {
+      drain_log ();
+      intr_set_level (old_level);
+
+      acquire_console ();
+      write_direct (s, n);
+      release_console ();
+      return;
+    }
+
+  while (n > 0)
+    {
+      size_t room = LOG_SIZE - (log_head - log_tail);
+
+      if (room < n && room < LOG_SIZE)
+        {
+          if (old_level == INTR_ON && thread_current () != console_thread)
+            {
+              /* Wait for the console thread to make room. */
+              list_push_back (&log_waiters, &thread_current ()->elem);
+              thread_block ();
+            }
+          else
+            {
+              /* We can't wait, so write out the log and S
+                 ourselves. */
+              drain_log ();
+              write_direct (s, n);
+              break;
+            }
+          continue;
+        }
+
+      if (room > n)
+        room = n;
+      n -= room;
+      while (room-- > 0)
+        log_buf[log_head++ % LOG_SIZE] = *s++;
+    }
+
+  if (console_idle)
+    {
+      console_idle = false;
+      thread_unblock (console_thread);
+    }
+  intr_set_level (old_level);
+}
+
+/* Writes the N characters in S to the serial port and vga
+   display. */
+static void
+write_direct (const char *s, size_t n)
+{
+  serial_putbuf (s, n);
+  while (n-- > 0)
+    vga_putc (*s++);
+}
+
+/* Writes out and drops the part of the log that the console
+   thread is not already writing.  Interrupts must be off. */
+static void
+drain_log (void)
+{
+  size_t pos;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (pos = log_tail + log_writing; pos != log_head; )
+    {
+      size_t ofs = pos % LOG_SIZE;
+      size_t n = log_head - pos;
+      if (n > LOG_SIZE - ofs)
+        n = LOG_SIZE - ofs;
+      write_direct (log_buf + ofs, n);
+      pos += n;
+    }
+  log_head = log_tail + log_writing;
+}
+
+/* The console thread.  Writes output from the log to the
+   devices and wakes up threads waiting for room in the log or for
+   it to drain. */
+static void
+console_thread_func (void *started)
+{
+  console_thread = thread_current ();
+  sema_up (started);
+
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      size_t ofs;
+
+      while (!list_empty (&log_waiters))
+        thread_unblock (list_entry (list_pop_front (&log_waiters),
+                                    struct thread, elem));
+      while (log_tail == log_head)
+        {
+          console_idle = true;
+          thread_block ();
+        }
+      ofs = log_tail % LOG_SIZE;
+      log_writing = log_head - log_tail;
+      if (log_writing > LOG_SIZE - ofs)
+        log_writing = LOG_SIZE - ofs;
+      intr_set_level (old_level);
+
+      write_direct (log_buf + ofs, log_writing);
+
+      old_level = intr_disable ();
+      log_tail += log_writing;
+      log_writing = 0;
+      intr_set_level (old_level);
+    }
 }
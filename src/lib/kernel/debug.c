@@ -45,6 +45,7 @@ debug_panic (const char *file, int line, const char *function,
       /* Don't print anything: that's probably why we recursed. */
     }
 
+  console_flush ();
   serial_flush ();
   shutdown ();
   for (;;);
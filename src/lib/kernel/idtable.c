@@ -0,0 +1,153 @@
+/* ID table.
+
+   See idtable.h for basic information. */
+
+#include "idtable.h"
+#include <string.h>
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Number of bits in a bitmap word. */
+#define WORD_BITS (sizeof (unsigned long) * 8)
+
+/* Number of slots in a table's first allocation. */
+#define INITIAL_CAPACITY 32
+
+static bool grow (struct idtable *);
+
+/* Initializes T to hand out IDs starting from FIRST. */
+void
+idtable_init (struct idtable *t, int first)
+{
+  t->first = first;
+  t->capacity = 0;
+  t->slots = NULL;
+  t->used = NULL;
+}
+
+/* Calls ACTION, if non-null, for each entry in T, given
+   auxiliary data AUX, and then frees T's memory.  T may be
+   reinitialized with idtable_init() afterward. */
+void
+idtable_destroy (struct idtable *t, idtable_action_func *action, void *aux)
+{
+  if (action != NULL)
+    idtable_foreach (t, action, aux);
+  free (t->slots);
+  free (t->used);
+  idtable_init (t, t->first);
+}
+
+/* Calls ACTION for each entry in T, in order of increasing ID,
+   given auxiliary data AUX.  ACTION must not modify T. */
+void
+idtable_foreach (const struct idtable *t, idtable_action_func *action,
+                 void *aux)
+{
+  size_t i;
+
+  for (i = 0; i < t->capacity; i++)
+    if (t->used[i / WORD_BITS] & (1UL << (i % WORD_BITS)))
+      action (t->first + (int) i, t->slots[i], aux);
+}
+
+/* Inserts VALUE into T under the lowest free ID and returns the
+   ID, or -1 if memory allocation fails. */
+int
+idtable_insert (struct idtable *t, void *value)
+{
+  size_t word_cnt = t->capacity / WORD_BITS;
+  size_t w, i;
+
+  ASSERT (value != NULL);
+
+  for (w = 0; w < word_cnt; w++)
+    if (t->used[w] != ~0UL)
+      break;
+  if (w == word_cnt)
+    {
+      if (!grow (t))
+        return -1;
+    }
+
+  i = w * WORD_BITS + __builtin_ctzl (~t->used[w]);
+  t->used[w] |= 1UL << (i % WORD_BITS);
+  t->slots[i] = value;
+  return t->first + (int) i;
+}
+
+/* Inserts VALUE into T under the given ID.  Returns true if
+   successful, false if ID is already in use or out of range or if
+   memory allocation fails. */
+bool
+idtable_insert_at (struct idtable *t, int id, void *value)
+{
+  size_t i = (size_t) id - t->first;
+
+  ASSERT (value != NULL);
+
+  if (id < t->first || idtable_lookup (t, id) != NULL)
+    return false;
+  while (i >= t->capacity)
+    if (!grow (t))
+      return false;
+
+  t->used[i / WORD_BITS] |= 1UL << (i % WORD_BITS);
+  t->slots[i] = value;
+  return true;
+}
+
+/* Returns the entry in T with the given ID, or a null pointer if
+   there is none. */
+void *
+idtable_lookup (const struct idtable *t, int id)
+{
+  size_t i = (size_t) id - t->first;
+
+  if (id < t->first || i >= t->capacity
+      || !(t->used[i / WORD_BITS] & (1UL << (i % WORD_BITS))))
+    return NULL;
+  return t->slots[i];
+}
+
+/* Removes the entry in T with the given ID and returns it, or
+   returns a null pointer if there is none.  The ID becomes free
+   for reuse. */
+void *
+idtable_remove (struct idtable *t, int id)
+{
+  void *value = idtable_lookup (t, id);
+
+  if (value != NULL)
+    {
+      size_t i = (size_t) id - t->first;
+      t->used[i / WORD_BITS] &= ~(1UL << (i % WORD_BITS));
+      t->slots[i] = NULL;
+    }
+  return value;
+}
+
+/* Doubles T's capacity.  Returns true if successful, false if
+   memory allocation fails. */
+static bool
+grow (struct idtable *t)
+{
+  size_t new_capacity = t->capacity > 0 ? t->capacity * 2 : INITIAL_CAPACITY;
+  void **slots;
+  unsigned long *used;
+
+  slots = realloc (t->slots, new_capacity * sizeof *slots);
+  if (slots == NULL)
+    return false;
+  t->slots = slots;
+
+  used = realloc (t->used, new_capacity / WORD_BITS * sizeof *used);
+  if (used == NULL)
+    return false;
+  memset (used + t->capacity / WORD_BITS, 0,
+          (new_capacity - t->capacity) / WORD_BITS * sizeof *used);
+  t->used = used;
+
+  t->capacity = new_capacity;
+  return true;
+}
@@ -0,0 +1,40 @@
+#ifndef __LIB_KERNEL_IDTABLE_H
+#define __LIB_KERNEL_IDTABLE_H
+
+/* ID table.
+
+   Maps small integer IDs, such as file descriptors, to non-null
+   pointers.
+   Lookups index an array directly, and a bitmap of the IDs in
+   use lets insertions hand out the lowest free ID quickly.  The
+   array and bitmap grow as needed.  The table does not allocate
+   memory until the first insertion, so it can be initialized
+   before malloc() is available. */
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Performs some operation on table entry VALUE, which has the
+   given ID, given auxiliary data AUX. */
+typedef void idtable_action_func (int id, void *value, void *aux);
+
+/* ID table. */
+struct idtable
+  {
+    int first;                  /* Lowest ID handed out. */
+    size_t capacity;            /* Number of slots. */
+    void **slots;               /* Slot I holds ID FIRST + I. */
+    unsigned long *used;        /* Bitmap of slots in use. */
+  };
+
+void idtable_init (struct idtable *, int first);
+void idtable_destroy (struct idtable *, idtable_action_func *, void *aux);
+void idtable_foreach (const struct idtable *, idtable_action_func *,
+                      void *aux);
+
+int idtable_insert (struct idtable *, void *value);
+bool idtable_insert_at (struct idtable *, int id, void *value);
+void *idtable_lookup (const struct idtable *, int id);
+void *idtable_remove (struct idtable *, int id);
+
+#endif /* lib/kernel/idtable.h */
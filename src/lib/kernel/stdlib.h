@@ -0,0 +1,7 @@
+#ifndef __LIB_KERNEL_STDLIB_H
+#define __LIB_KERNEL_STDLIB_H
+
+/* The kernel's memory allocator is declared in threads/malloc.h,
+   not here, because it is part of the threads code. */
+
+#endif /* lib/kernel/stdlib.h */
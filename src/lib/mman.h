@@ -0,0 +1,9 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/* Advice for the madvise system call. */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_DONTNEED 4         /* Contents may be discarded; the
+                                   pages read as zeros afterward. */
+
+#endif /* lib/mman.h */
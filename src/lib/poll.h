@@ -0,0 +1,26 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* Waiting for events on several file descriptors with the poll
+   system call. */
+
+/* Most descriptors that one call may poll. */
+#define POLL_MAX 64
+
+/* Events. */
+#define POLLIN 0x001            /* Data may be read without waiting. */
+#define POLLOUT 0x004           /* Data may be written without waiting. */
+#define POLLERR 0x008           /* Pipe has no read end open. */
+#define POLLHUP 0x010           /* Pipe has no write end open. */
+#define POLLNVAL 0x020          /* Descriptor is not open. */
+
+struct pollfd
+  {
+    int fd;                     /* Descriptor, or negative to skip. */
+    short events;               /* Events of interest. */
+    short revents;              /* Events that occurred; POLLERR,
+                                   POLLHUP and POLLNVAL always
+                                   count. */
+  };
+
+#endif /* lib/poll.h */
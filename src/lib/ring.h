@@ -0,0 +1,68 @@
+#ifndef __LIB_RING_H
+#define __LIB_RING_H
+
+#include <stdint.h>
+
+/* Submission and completion queues shared between a user
+   process and the kernel, for issuing system calls in batches.
+
+   The process maps the ring with ring_setup(), fills submission
+   queue entries and advances SQ_TAIL, then calls ring_enter() to
+   hand them to the kernel.  The kernel posts one completion
+   queue entry per submission, in no particular order, advancing
+   CQ_TAIL; the process consumes them and advances CQ_HEAD.
+
+   Head and tail counters run freely and wrap around; entry I of
+   a queue is at index I % RING_ENTRIES.  Each counter is written
+   only by the side named in its comment. */
+
+/* Entries in each queue, chosen so that the ring fits in one
+   page. */
+#define RING_ENTRIES 64
+
+/* Operations. */
+enum ring_op
+  {
+    RING_NOP,                   /* Do nothing. */
+    RING_READ,                  /* read(FD, BUF, LEN). */
+    RING_WRITE,                 /* write(FD, BUF, LEN). */
+    RING_OPEN,                  /* open(BUF). */
+    RING_CLOSE,                 /* close(FD). */
+    RING_MMAP                   /* mmap(FD, BUF). */
+  };
+
+/* OFFSET value for reading or writing at the file's current
+   position, and advancing it, as read() and write() do. */
+#define RING_CURRENT_POS (-1)
+
+/* Submission queue entry. */
+struct ring_sqe
+  {
+    uint32_t op;                /* Operation, one of enum ring_op. */
+    int32_t fd;                 /* File descriptor. */
+    void *buf;                  /* Buffer, file name, or address. */
+    uint32_t len;               /* Bytes to read or write. */
+    int32_t offset;             /* File offset or RING_CURRENT_POS. */
+    uint32_t user_data;         /* Copied into the completion. */
+  };
+
+/* Completion queue entry. */
+struct ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int32_t res;                /* What the system call would
+                                   return, or -1 on failure. */
+  };
+
+/* The shared ring. */
+struct ring
+  {
+    uint32_t sq_head;           /* Next submission to take (kernel). */
+    uint32_t sq_tail;           /* Next submission to fill (user). */
+    uint32_t cq_head;           /* Next completion to take (user). */
+    uint32_t cq_tail;           /* Next completion to fill (kernel). */
+    struct ring_sqe sq[RING_ENTRIES];
+    struct ring_cqe cq[RING_ENTRIES];
+  };
+
+#endif /* lib/ring.h */
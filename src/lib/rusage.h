@@ -0,0 +1,41 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Resource usage of a user process or thread, as counted by the
+   kernel and returned to user programs by the getrusage system
+   call.  Every member is a counter. */
+
+/* Whose usage getrusage() reports. */
+#define RUSAGE_SELF 0           /* The calling process. */
+#define RUSAGE_THREAD 1         /* The calling thread alone. */
+
+/* System call numbers below this are counted one by one. */
+#define RUSAGE_SYSCALLS 64
+
+struct rusage
+  {
+    unsigned long long user_ticks;      /* Timer ticks in user mode. */
+    unsigned long long kernel_ticks;    /* Timer ticks in the kernel. */
+
+    /* Page faults that brought in a page, by where its contents
+       came from.  STACK_FAULTS counts the faults that grew the
+       stack, which are also counted as ZERO_FAULTS. */
+    unsigned long long zero_faults;     /* Zero-filled. */
+    unsigned long long file_faults;     /* Read from a file or mapped
+                                           from the page cache. */
+    unsigned long long swap_faults;     /* Read back from swap. */
+    unsigned long long stack_faults;    /* Grew the stack. */
+
+    unsigned long long swap_ins;        /* Pages read from swap. */
+    unsigned long long swap_outs;       /* Pages written to swap. */
+    unsigned long long block_reads;     /* Sectors read from block
+                                           devices. */
+    unsigned long long block_writes;    /* Sectors written. */
+
+    unsigned long long voluntary_switches;    /* Waits for events. */
+    unsigned long long involuntary_switches;  /* Preemptions. */
+
+    unsigned long long syscalls[RUSAGE_SYSCALLS]; /* By number. */
+  };
+
+#endif /* lib/rusage.h */
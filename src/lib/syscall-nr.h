@@ -28,7 +28,31 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_IOSTAT,                 /* Reports block device statistics. */
+    SYS_RING_SETUP,             /* Maps a system call ring. */
+    SYS_RING_ENTER,             /* Submits and completes ring entries. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_SPLICE,                 /* Move data between a pipe and a file. */
+    SYS_SBRK,                   /* Move the end of the heap. */
+    SYS_MADVISE,                /* Advise on use of heap memory. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_EXIT,            /* Terminate this thread. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_FUTEX,                  /* Sleep on or wake a futex. */
+    SYS_SHM_CREATE,             /* Create a shared memory object. */
+    SYS_SHM_REMOVE,             /* Delete a shared memory object. */
+    SYS_SHM_ATTACH,             /* Map a shared memory object. */
+    SYS_SHM_DETACH,             /* Unmap a shared memory object. */
+    SYS_POLL,                   /* Wait for events on several fds. */
+    SYS_FCNTL,                  /* Get or set fd flags. */
+    SYS_GETRUSAGE               /* Report resource usage. */
   };
 
 #endif /* lib/syscall-nr.h */
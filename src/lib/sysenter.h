@@ -0,0 +1,29 @@
+#ifndef __LIB_SYSENTER_H
+#define __LIB_SYSENTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Returns true if the CPU supports the SYSENTER and SYSEXIT
+   fast system call instructions.  The kernel enables SYSENTER
+   exactly when this returns true, so user programs use it to
+   choose between SYSENTER and "int $0x30". */
+static inline bool
+sysenter_supported (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  if ((edx & (1u << 11)) == 0)          /* SEP feature flag. */
+    return false;
+
+  /* The original Pentium Pro sets SEP but lacks the
+     instructions.  See [IA32-v2b] "SYSENTER". */
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return !(family == 6 && model < 3 && stepping < 3);
+}
+
+#endif /* lib/sysenter.h */
@@ -0,0 +1,59 @@
+#include <clock.h>
+#include <vtime.h>
+
+/* Copies the time page into *VT and returns the timestamp
+   counter as of the copy, retrying if the kernel updated the page
+   meanwhile. */
+static uint64_t
+read_time_page (struct vtime *vt)
+{
+  const volatile uint32_t *seq = &VTIME_ADDR->seq;
+  uint32_t start;
+  uint64_t tsc;
+
+  do
+    {
+      while ((start = *seq) & 1)
+        continue;
+      asm volatile ("" : : : "memory");
+      *vt = *VTIME_ADDR;
+      tsc = vtime_rdtsc ();
+      asm volatile ("" : : : "memory");
+    }
+  while (*seq != start);
+  return tsc;
+}
+
+/* Returns the number of timer ticks since the OS booted. */
+int64_t
+clock_ticks (void)
+{
+  struct vtime vt;
+
+  read_time_page (&vt);
+  return vt.ticks;
+}
+
+/* Returns the number of nanoseconds since the OS booted, counted
+   in whole timer ticks plus the fraction of the current tick
+   measured with the timestamp counter.  The fraction is left out
+   until the kernel has measured the counter's rate. */
+uint64_t
+clock_ns (void)
+{
+  struct vtime vt;
+  uint64_t tsc = read_time_page (&vt);
+  uint64_t ns_per_tick = 1000000000 / vt.freq;
+  uint64_t ns = vt.ticks * ns_per_tick;
+
+  if (vt.tsc_per_tick != 0)
+    {
+      /* Stay within the tick, so the time never runs backward if
+         the next tick is late. */
+      uint64_t cycles = tsc - vt.tsc;
+      if (cycles >= vt.tsc_per_tick)
+        cycles = vt.tsc_per_tick - 1;
+      ns += cycles * ns_per_tick / vt.tsc_per_tick;
+    }
+  return ns;
+}
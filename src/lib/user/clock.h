@@ -0,0 +1,11 @@
+#ifndef __LIB_USER_CLOCK_H
+#define __LIB_USER_CLOCK_H
+
+#include <stdint.h>
+
+/* Time since boot, read from the time page that the kernel maps
+   into every process (see lib/vtime.h), without a system call. */
+int64_t clock_ticks (void);
+uint64_t clock_ns (void);
+
+#endif /* lib/user/clock.h */
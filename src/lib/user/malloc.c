@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include <uthread.h>
+
+/* A simple implementation of malloc() for user programs, on top
+   of the heap that sbrk() extends.
+
+   Small requests are rounded up to a power of two between 16
+   and 2048 bytes, header included.  Blocks of each of these
+   size classes are carved out of larger chunks, and freed ones
+   are kept on a free list per class and never coalesced, so
+   small allocations and frees take constant time.
+
+   Larger requests, and the chunks for small blocks, are served
+   from "large blocks" laid out back to back across the heap.
+   Each large block has a header giving its size and whether it
+   and the block before it are in use; a free large block also
+   has a footer giving its size, so that freeing a block can
+   merge it with free neighbors on both sides.  Free large blocks
+   are kept on a single list and allocated first-fit.  The heap
+   ends with a zero-size "epilogue" header that is always in use.
+
+   Memory in big free blocks is handed back to the kernel: pages
+   in the middle of a free block are released with madvise(),
+   and a big free block at the end of the heap shrinks the heap
+   with sbrk().
+
+   A single lock serializes allocation among a process's
+   threads. */
+
+/* Every block's header takes this many bytes just before the
+   block's data, which keeps the data 8-byte aligned. */
+#define HDR_SIZE 8
+
+/* Small size classes: 16, 32, ..., 2048 bytes. */
+#define MIN_CLASS_SHIFT 4
+#define CLASS_CNT 8
+#define MAX_SMALL (1u << (MIN_CLASS_SHIFT + CLASS_CNT - 1))
+
+/* Page size, for madvise(). */
+#define PAGE_SIZE 4096
+
+/* Least amount by which to grow the heap at a time. */
+#define GROW_SIZE (16 * 1024)
+
+/* Free large blocks at least this big have their inner pages
+   released. */
+#define RELEASE_SIZE (16 * 1024)
+
+/* A free large block at least this big at the end of the heap
+   is trimmed off. */
+#define TRIM_SIZE (64 * 1024)
+
+/* Header flags, in the low bits of the size. */
+#define F_USED 1u               /* Large block is in use. */
+#define F_PREV_USED 2u          /* Large block before it is in use. */
+#define F_SMALL 4u              /* Small block. */
+#define F_MASK 7u
+
+/* A free small block. */
+struct small_block
+  {
+    size_t hdr;                 /* Class size | F_SMALL. */
+    struct small_block *next;   /* Next free block in class. */
+  };
+
+/* A free large block.  Its size is also stored in the last
+   size_t of the block. */
+struct large_block
+  {
+    size_t hdr;                 /* Size | flags. */
+    struct large_block *prev;   /* Previous free large block. */
+    struct large_block *next;   /* Next free large block. */
+  };
+
+/* Smallest large block: room for the free block fields and a
+   footer. */
+#define MIN_LARGE ROUND_UP (sizeof (struct large_block) + sizeof (size_t), \
+                            HDR_SIZE)
+
+static struct umutex heap_lock = UMUTEX_INITIALIZER;
+static struct small_block *small_free[CLASS_CNT];
+static struct large_block *large_free;
+
+/* Epilogue header at the end of the heap, or null before the
+   heap is first used. */
+static size_t *epilogue;
+
+static void *alloc (size_t);
+static void *large_alloc (size_t);
+static struct large_block *coalesce (struct large_block *);
+static struct large_block *grow_heap (size_t);
+static void release (struct large_block *);
+
+/* Returns the size of block B from its header. */
+static inline size_t
+block_size (const void *b)
+{
+  return *(const size_t *) b & ~F_MASK;
+}
+
+/* Returns the large block following B. */
+static inline struct large_block *
+next_block (const void *b)
+{
+  return (struct large_block *) ((uint8_t *) b + block_size (b));
+}
+
+/* Makes B a free large block of SIZE bytes whose predecessor is
+   in use, writing its footer and clearing its successor's
+   F_PREV_USED. */
+static void
+set_free (struct large_block *b, size_t size)
+{
+  b->hdr = size | F_PREV_USED;
+  *(size_t *) ((uint8_t *) b + size - sizeof (size_t)) = size;
+  *(size_t *) next_block (b) &= ~F_PREV_USED;
+}
+
+/* Adds B to the list of free large blocks. */
+static void
+push_free (struct large_block *b)
+{
+  b->prev = NULL;
+  b->next = large_free;
+  if (large_free != NULL)
+    large_free->prev = b;
+  large_free = b;
+}
+
+/* Removes B from the list of free large blocks. */
+static void
+remove_free (struct large_block *b)
+{
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    large_free = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+}
+
+/* Returns the size class for a block of SIZE bytes, header
+   included. */
+static unsigned
+size_class (size_t size)
+{
+  unsigned c = 0;
+  while ((1u << (MIN_CLASS_SHIFT + c)) < size)
+    c++;
+  return c;
+}
+
+/* Obtains and returns a new block of SIZE bytes, or a null
+   pointer if SIZE is 0 or memory is short. */
+void *
+malloc (size_t size)
+{
+  void *p;
+
+  if (size == 0)
+    return NULL;
+  umutex_lock (&heap_lock);
+  p = alloc (size);
+  umutex_unlock (&heap_lock);
+  return p;
+}
+
+/* Does the work of malloc() for nonzero SIZE, with the heap
+   locked. */
+static void *
+alloc (size_t size)
+{
+  if (size <= MAX_SMALL - HDR_SIZE)
+    {
+      unsigned c = size_class (size + HDR_SIZE);
+      struct small_block *b = small_free[c];
+      if (b == NULL)
+        {
+          /* Carve a chunk into blocks of this class. */
+          size_t class_size = 1u << (MIN_CLASS_SHIFT + c);
+          size_t chunk_size = class_size * 8 > PAGE_SIZE ? class_size * 8 : PAGE_SIZE;
+          uint8_t *chunk = large_alloc (chunk_size - HDR_SIZE);
+          size_t i;
+
+          if (chunk == NULL)
+            return NULL;
+          for (i = 0; i + class_size <= chunk_size - HDR_SIZE; i += class_size)
+            {
+              b = (struct small_block *) (chunk + i);
+              b->hdr = class_size | F_SMALL;
+              b->next = small_free[c];
+              small_free[c] = b;
+            }
+          b = small_free[c];
+        }
+      small_free[c] = b->next;
+      return (uint8_t *) b + HDR_SIZE;
+    }
+  return large_alloc (size);
+}
+
+/* Allocates and returns A times B bytes initialized to zeros.
+   Returns a null pointer if memory is short or the size
+   overflows. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size = a * b;
+
+  if (b != 0 && size / b != a)
+    return NULL;
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Returns the number of bytes of data that block P can hold. */
+static size_t
+block_capacity (void *p)
+{
+  return block_size ((uint8_t *) p - HDR_SIZE) - HDR_SIZE;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly moving
+   it in the process.  Returns the new block, or a null pointer
+   if memory is short, in which case OLD_BLOCK is unchanged.  A
+   call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE); a
+   call with zero NEW_SIZE frees OLD_BLOCK and returns null. */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  void *new_block;
+  size_t old_size;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  old_size = block_capacity (old_block);
+  if (new_size <= old_size)
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block, old_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  void *b;
+
+  if (p == NULL)
+    return;
+  b = (uint8_t *) p - HDR_SIZE;
+  umutex_lock (&heap_lock);
+  if (*(size_t *) b & F_SMALL)
+    {
+      struct small_block *s = b;
+      unsigned c = size_class (block_size (s));
+      s->next = small_free[c];
+      small_free[c] = s;
+    }
+  else
+    {
+      ASSERT (*(size_t *) b & F_USED);
+      release (coalesce (b));
+    }
+  umutex_unlock (&heap_lock);
+}
+
+/* Allocates a large block with room for SIZE bytes of data and
+   returns its data, or returns a null pointer if memory is
+   short. */
+static void *
+large_alloc (size_t size)
+{
+  size_t need, have;
+  struct large_block *b;
+
+  if (size > SIZE_MAX - MIN_LARGE - HDR_SIZE)
+    return NULL;
+  need = ROUND_UP (size + HDR_SIZE, HDR_SIZE);
+  if (need < MIN_LARGE)
+    need = MIN_LARGE;
+
+  for (b = large_free; b != NULL; b = b->next)
+    if (block_size (b) >= need)
+      break;
+  if (b == NULL)
+    {
+      b = grow_heap (need);
+      if (b == NULL)
+        return NULL;
+    }
+  remove_free (b);
+
+  /* Split off the rest, if big enough to be a block. */
+  have = block_size (b);
+  if (have - need >= MIN_LARGE)
+    {
+      struct large_block *rest = (struct large_block *) ((uint8_t *) b + need);
+      b->hdr = need | (b->hdr & F_MASK);
+      set_free (rest, have - need);
+      push_free (rest);
+    }
+  else
+    *(size_t *) next_block (b) |= F_PREV_USED;
+  b->hdr |= F_USED;
+  return (uint8_t *) b + HDR_SIZE;
+}
+
+/* Frees large block B, merging it with free neighbors, and
+   returns the resulting free block. */
+static struct large_block *
+coalesce (struct large_block *b)
+{
+  size_t size = block_size (b);
+  struct large_block *next = next_block (b);
+
+  if (!(next->hdr & F_USED))
+    {
+      remove_free (next);
+      size += block_size (next);
+    }
+  if (!(b->hdr & F_PREV_USED))
+    {
+      size_t prev_size = ((size_t *) b)[-1];
+      b = (struct large_block *) ((uint8_t *) b - prev_size);
+      remove_free (b);
+      size += prev_size;
+    }
+  set_free (b, size);
+  push_free (b);
+  return b;
+}
+
+/* Extends the heap by at least NEED bytes and returns the free
+   large block at its end, which has at least NEED bytes, or
+   returns a null pointer if the heap cannot grow. */
+static struct large_block *
+grow_heap (size_t need)
+{
+  size_t grow = ROUND_UP (need > GROW_SIZE ? need : GROW_SIZE, PAGE_SIZE);
+  struct large_block *b;
+
+  if (epilogue == NULL)
+    {
+      /* Start the heap at an aligned address with just an
+         epilogue. */
+      uintptr_t brk = (uintptr_t) sbrk (0);
+      size_t pad = ROUND_UP (brk, HDR_SIZE) - brk;
+      if (sbrk (pad + HDR_SIZE) == (void *) -1)
+        return NULL;
+      epilogue = (size_t *) (brk + pad);
+      *epilogue = F_USED | F_PREV_USED;
+    }
+
+  if (grow > SIZE_MAX / 2 || sbrk (grow) == (void *) -1)
+    return NULL;
+
+  /* The old epilogue becomes the header of the new block. */
+  b = (struct large_block *) epilogue;
+  b->hdr = grow | (*epilogue & F_PREV_USED) | F_USED;
+  epilogue = (size_t *) ((uint8_t *) b + grow);
+  *epilogue = F_USED;
+  return coalesce (b);
+}
+
+/* Hands memory in free large block B back to the kernel, if B is
+   big enough for it to be worthwhile. */
+static void
+release (struct large_block *b)
+{
+  size_t size = block_size (b);
+
+  if ((size_t *) next_block (b) == epilogue && size >= TRIM_SIZE)
+    {
+      /* Shrink the heap, leaving a page's worth. */
+      size_t trim = ROUND_DOWN (size - PAGE_SIZE, PAGE_SIZE);
+      remove_free (b);
+      epilogue = (size_t *) ((uint8_t *) epilogue - trim);
+      *epilogue = F_USED;
+      set_free (b, size - trim);
+      push_free (b);
+      sbrk (-(intptr_t) trim);
+    }
+  else if (size >= RELEASE_SIZE)
+    {
+      /* Discard the pages between the free block fields and the
+         footer. */
+      uintptr_t start = ROUND_UP ((uintptr_t) (b + 1), PAGE_SIZE);
+      uintptr_t end = ROUND_DOWN ((uintptr_t) b + size - sizeof (size_t),
+                                  PAGE_SIZE);
+      if (end > start)
+        madvise ((void *) start, end - start, MADV_DONTNEED);
+    }
+}
@@ -2,12 +2,26 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <debug.h>
+#include <fcntl.h>
+#include <futex.h>
+#include <iostat.h>
+#include <mman.h>
+#include <poll.h>
+#include <ring.h>
+#include <rusage.h>
+#include <uio.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -45,4 +59,28 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+bool iostat (int idx, struct iostat *);
+bool ring_setup (struct ring *);
+int ring_enter (unsigned to_submit, unsigned min_complete);
+int pread (int fd, void *buffer, unsigned size, int offset);
+int pwrite (int fd, const void *buffer, unsigned size, int offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+bool pipe (int fds[2]);
+int splice (int fd_in, int fd_out, unsigned size);
+void *sbrk (intptr_t increment);
+int madvise (void *addr, size_t length, int advice);
+tid_t uthread_create (void (*func) (void *aux), void *aux);
+void uthread_exit (int status) NO_RETURN;
+int uthread_join (tid_t);
+int futex (uint32_t *addr, int op, uint32_t val);
+bool shm_create (const char *name, size_t size);
+bool shm_remove (const char *name);
+void *shm_attach (const char *name, void *addr);
+bool shm_detach (void *addr);
+int poll (struct pollfd *, unsigned nfds, int timeout);
+int fcntl (int fd, int cmd, int arg);
+bool getrusage (int who, struct rusage *);
+
 #endif /* lib/user/syscall.h */
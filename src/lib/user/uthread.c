@@ -0,0 +1,127 @@
+#include <uthread.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* The lock is the three-state futex mutex from Ulrich Drepper,
+   "Futexes Are Tricky".  Locking and unlocking an uncontended
+   lock takes one atomic instruction each; only a thread that
+   finds the lock held sleeps in the kernel, after marking the
+   lock so that its holder knows to wake a sleeper on release.
+
+   A condition variable is a sequence number.  A waiter notes it
+   before releasing the lock and sleeps only if no signal has
+   advanced it since, so no wakeup is lost. */
+
+/* If *P equals OLD, sets it to NEW.  Either way returns the value
+   *P had. */
+static inline uint32_t
+cmpxchg (uint32_t *p, uint32_t old, uint32_t new)
+{
+  uint32_t prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Sets *P to NEW and returns the value it had. */
+static inline uint32_t
+xchg (uint32_t *p, uint32_t new)
+{
+  asm volatile ("xchgl %0, %1" : "+r" (new), "+m" (*p) : : "memory");
+  return new;
+}
+
+/* Adds N to *P and returns the value it had. */
+static inline uint32_t
+fetch_add (uint32_t *p, uint32_t n)
+{
+  asm volatile ("lock xaddl %0, %1" : "+r" (n), "+m" (*p) : : "memory");
+  return n;
+}
+
+/* Initializes M as an unlocked lock. */
+void
+umutex_init (struct umutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping until it is available if necessary. */
+void
+umutex_lock (struct umutex *m)
+{
+  uint32_t c = cmpxchg (&m->state, 0, 1);
+  if (c == 0)
+    return;
+
+  /* Mark the lock contended, then sleep until it is released. */
+  if (c != 2)
+    c = xchg (&m->state, 2);
+  while (c != 0)
+    {
+      futex (&m->state, FUTEX_WAIT, 2);
+      c = xchg (&m->state, 2);
+    }
+}
+
+/* Acquires M and returns true if it is available, or returns
+   false without waiting otherwise. */
+bool
+umutex_trylock (struct umutex *m)
+{
+  return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the current thread must hold, waking a thread
+   waiting for it, if any. */
+void
+umutex_unlock (struct umutex *m)
+{
+  if (fetch_add (&m->state, -1) != 1)
+    {
+      m->state = 0;
+      futex (&m->state, FUTEX_WAKE, 1);
+    }
+}
+
+/* Initializes condition variable C. */
+void
+ucond_init (struct ucond *c)
+{
+  c->seq = 0;
+}
+
+/* Atomically releases M, which the current thread must hold, and
+   waits for C to be signaled, then reacquires M.  As with any
+   condition variable, the caller must recheck its condition. */
+void
+ucond_wait (struct ucond *c, struct umutex *m)
+{
+  uint32_t seq = c->seq;
+
+  umutex_unlock (m);
+  futex (&c->seq, FUTEX_WAIT, seq);
+
+  /* Other signaled threads may be waiting for M as well, so take
+     it in the contended state. */
+  while (xchg (&m->state, 2) != 0)
+    futex (&m->state, FUTEX_WAIT, 2);
+}
+
+/* Wakes one thread waiting on C, if any. */
+void
+ucond_signal (struct ucond *c)
+{
+  fetch_add (&c->seq, 1);
+  futex (&c->seq, FUTEX_WAKE, 1);
+}
+
+/* Wakes all threads waiting on C. */
+void
+ucond_broadcast (struct ucond *c)
+{
+  fetch_add (&c->seq, 1);
+  futex (&c->seq, FUTEX_WAKE, INT_MAX);
+}
@@ -0,0 +1,38 @@
+#ifndef __LIB_USER_UTHREAD_H
+#define __LIB_USER_UTHREAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Locks and condition variables for the threads of a process,
+   built on futexes so that they enter the kernel only when
+   threads actually have to wait.  See lib/user/uthread.c. */
+
+/* A lock. */
+struct umutex
+  {
+    uint32_t state;             /* 0 if unlocked, 1 if locked, 2 if
+                                   locked and others may wait. */
+  };
+
+/* A condition variable. */
+struct ucond
+  {
+    uint32_t seq;               /* Advanced by each signal. */
+  };
+
+/* Initializers for static locks and condition variables. */
+#define UMUTEX_INITIALIZER { 0 }
+#define UCOND_INITIALIZER { 0 }
+
+void umutex_init (struct umutex *);
+void umutex_lock (struct umutex *);
+bool umutex_trylock (struct umutex *);
+void umutex_unlock (struct umutex *);
+
+void ucond_init (struct ucond *);
+void ucond_wait (struct ucond *, struct umutex *);
+void ucond_signal (struct ucond *);
+void ucond_broadcast (struct ucond *);
+
+#endif /* lib/user/uthread.h */
@@ -0,0 +1,38 @@
+#ifndef __LIB_VTIME_H
+#define __LIB_VTIME_H
+
+#include <stdint.h>
+
+/* The time page: kept up to date by the kernel's timer interrupt
+   and mapped read-only at VTIME_ADDR in every user process, so
+   that user programs can read the time without a system call.
+
+   The kernel makes SEQ odd while it updates the page and even
+   again when done, so a reader that sees the same even SEQ
+   before and after reading the other members has a consistent
+   copy of them. */
+
+/* User address of the time page, just below the code segment. */
+#define VTIME_ADDR ((const struct vtime *) 0x07fff000)
+
+struct vtime
+  {
+    uint32_t seq;               /* Odd while being updated. */
+    uint32_t freq;              /* Timer ticks per second. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    uint64_t tsc;               /* Timestamp counter at the latest
+                                   tick. */
+    uint64_t tsc_per_tick;      /* Timestamp counter cycles per tick,
+                                   or 0 until it has been measured. */
+  };
+
+/* Returns the CPU's timestamp counter. */
+static inline uint64_t
+vtime_rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* lib/vtime.h */
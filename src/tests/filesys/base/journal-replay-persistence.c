@@ -0,0 +1,21 @@
+/* Checks the files written by journal-replay, after booting
+   from a disk whose last journal transaction was committed but
+   never checkpointed. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/filesys/base/journal-replay.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char small[SMALL_SIZE];
+static char large[LARGE_SIZE];
+
+void
+test_main (void)
+{
+  random_bytes (small, sizeof small);
+  random_bytes (large, sizeof large);
+  check_file ("small", small, sizeof small);
+  check_file ("large", large, sizeof large);
+}
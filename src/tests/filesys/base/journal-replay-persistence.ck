@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "Run didn't replay the journal\n"
+  if !grep (/^journal: replayed transaction \d+ \(\d+ sectors\)$/,
+	    @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay-persistence) begin
+(journal-replay-persistence) open "small" for verification
+(journal-replay-persistence) verified contents of "small"
+(journal-replay-persistence) close "small"
+(journal-replay-persistence) open "large" for verification
+(journal-replay-persistence) verified contents of "large"
+(journal-replay-persistence) close "large"
+(journal-replay-persistence) end
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Writes two files and exits.  The kernel runs with
+   -journal-crash, so it powers off after committing the last
+   journal transaction to the log but before writing its sectors
+   home.  journal-replay-persistence then checks that booting
+   from the same disk replays the transaction. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/filesys/base/journal-replay.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char small[SMALL_SIZE];
+static char large[LARGE_SIZE];
+
+static void
+write_file (const char *file_name, const void *buf, size_t size)
+{
+  int fd;
+
+  CHECK (create (file_name, size), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, size) == (int) size,
+         "write %zu bytes to \"%s\"", size, file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+}
+
+void
+test_main (void)
+{
+  random_bytes (small, sizeof small);
+  random_bytes (large, sizeof large);
+  write_file ("small", small, sizeof small);
+  write_file ("large", large, sizeof large);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "Run didn't crash before checkpointing the journal\n"
+  if !grep (/^journal: crashed before checkpointing transaction \d+$/,
+	    @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) create "small"
+(journal-replay) open "small"
+(journal-replay) write 300 bytes to "small"
+(journal-replay) close "small"
+(journal-replay) create "large"
+(journal-replay) open "large"
+(journal-replay) write 5000 bytes to "large"
+(journal-replay) close "large"
+(journal-replay) end
+EOF
+pass;
@@ -0,0 +1,11 @@
+#ifndef TESTS_FILESYS_BASE_JOURNAL_REPLAY_H
+#define TESTS_FILESYS_BASE_JOURNAL_REPLAY_H
+
+/* A file small enough to keep its data in its inode, which
+   therefore goes through the journal, and a larger one whose
+   data sectors are written in place but whose inode and map of
+   written sectors are journaled. */
+#define SMALL_SIZE 300
+#define LARGE_SIZE 5000
+
+#endif /* tests/filesys/base/journal-replay.h */
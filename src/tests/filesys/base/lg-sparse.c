@@ -0,0 +1,39 @@
+/* Writes a few byte ranges that begin and end in the middle of
+   sectors of an otherwise unwritten file, then checks that the
+   rest of the file, including the rest of the partially written
+   sectors, reads back as zeros. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TEST_SIZE 20480
+
+static char buf[TEST_SIZE];
+
+static void
+write_range (int fd, size_t ofs, size_t size)
+{
+  random_bytes (buf + ofs, size);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, size) == (int) size,
+         "write %zu bytes at offset %zu", size, ofs);
+}
+
+void
+test_main (void)
+{
+  const char *file_name = "sparse";
+  int fd;
+
+  CHECK (create (file_name, TEST_SIZE), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  write_range (fd, 5 * 512 + 300, 600);
+  write_range (fd, 17 * 512 + 7, 10);
+  write_range (fd, TEST_SIZE - 100, 100);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, TEST_SIZE);
+}
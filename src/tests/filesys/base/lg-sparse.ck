@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(lg-sparse) begin
+(lg-sparse) create "sparse"
+(lg-sparse) open "sparse"
+(lg-sparse) write 600 bytes at offset 2860
+(lg-sparse) write 10 bytes at offset 8711
+(lg-sparse) write 100 bytes at offset 20380
+(lg-sparse) close "sparse"
+(lg-sparse) open "sparse" for verification
+(lg-sparse) verified contents of "sparse"
+(lg-sparse) close "sparse"
+(lg-sparse) end
+EOF
+pass;
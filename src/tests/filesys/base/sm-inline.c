@@ -0,0 +1,41 @@
+/* Writes and reads back files just small enough to keep their
+   data inside the inode and just too big to, with a second
+   write to each that overwrites part of the first. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Bytes of data an inode sector holds. */
+#define INLINE_BYTES 496
+
+static char buf[INLINE_BYTES + 1];
+
+static void
+test_size (const char *file_name, size_t size)
+{
+  int fd;
+
+  random_bytes (buf, size);
+  CHECK (create (file_name, size), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+  CHECK (write (fd, buf, size) == (int) size,
+         "write %zu bytes to \"%s\"", size, file_name);
+
+  random_bytes (buf + 100, 50);
+  seek (fd, 100);
+  CHECK (write (fd, buf + 100, 50) == 50,
+         "write 50 bytes at offset 100 in \"%s\"", file_name);
+  msg ("close \"%s\"", file_name);
+  close (fd);
+
+  check_file (file_name, buf, size);
+}
+
+void
+test_main (void)
+{
+  test_size ("inline", INLINE_BYTES);
+  test_size ("outside", INLINE_BYTES + 1);
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sm-inline) begin
+(sm-inline) create "inline"
+(sm-inline) open "inline"
+(sm-inline) write 496 bytes to "inline"
+(sm-inline) write 50 bytes at offset 100 in "inline"
+(sm-inline) close "inline"
+(sm-inline) open "inline" for verification
+(sm-inline) verified contents of "inline"
+(sm-inline) close "inline"
+(sm-inline) create "outside"
+(sm-inline) open "outside"
+(sm-inline) write 497 bytes to "outside"
+(sm-inline) write 50 bytes at offset 100 in "outside"
+(sm-inline) close "outside"
+(sm-inline) open "outside" for verification
+(sm-inline) verified contents of "outside"
+(sm-inline) close "outside"
+(sm-inline) end
+EOF
+pass;
@@ -0,0 +1,19 @@
+/* Child process run by exit-blocked.
+   Blocks for good reading a pipe whose write end it holds. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-block";
+
+int
+main (void)
+{
+  int fds[2];
+  char c;
+
+  if (!pipe (fds))
+    fail ("pipe failed");
+  read (fds[0], &c, 1);
+  fail ("read returned");
+}
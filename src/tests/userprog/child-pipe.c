@@ -0,0 +1,24 @@
+/* Child process run by pipe-exec.
+   Writes a message to the pipe end whose fd is its argument,
+   and exits without closing it. */
+
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-pipe";
+
+int
+main (int argc, char *argv[])
+{
+  const char *text = "sent from child";
+  int fd;
+
+  if (argc != 2)
+    fail ("wrong number of arguments");
+  fd = atoi (argv[1]);
+  if (write (fd, text, strlen (text)) != (int) strlen (text))
+    fail ("write failed");
+  return 0;
+}
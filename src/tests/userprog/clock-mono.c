@@ -0,0 +1,44 @@
+/* Reads the time from the time page many times over several
+   timer ticks, checking that neither clock_ticks nor clock_ns
+   ever runs backward and that the two agree. */
+
+#include <clock.h>
+#include <vtime.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int64_t start_ticks, ticks, prev_ticks;
+  uint64_t start_ns, ns, prev_ns, ns_per_tick;
+
+  CHECK (VTIME_ADDR->freq >= 19 && VTIME_ADDR->freq <= 1000,
+         "time page gives timer frequency");
+  ns_per_tick = 1000000000 / VTIME_ADDR->freq;
+
+  start_ticks = prev_ticks = clock_ticks ();
+  start_ns = prev_ns = clock_ns ();
+  do
+    {
+      ticks = clock_ticks ();
+      ns = clock_ns ();
+      if (ticks < prev_ticks)
+        fail ("clock_ticks went back from %lld to %lld", prev_ticks, ticks);
+      if (ns < prev_ns)
+        fail ("clock_ns went back from %llu to %llu", prev_ns, ns);
+      prev_ticks = ticks;
+      prev_ns = ns;
+    }
+  while (ticks - start_ticks < 10);
+  msg ("clocks never ran backward");
+
+  /* Both clocks were read within one tick of each other at the
+     start and at the end. */
+  ns = clock_ns () - start_ns;
+  ticks = clock_ticks () - start_ticks;
+  if (ns + 2 * ns_per_tick < ticks * ns_per_tick
+      || ns > (ticks + 2) * ns_per_tick)
+    fail ("%llu ns passed in %lld ticks", ns, ticks);
+  msg ("clock_ns agrees with clock_ticks");
+}
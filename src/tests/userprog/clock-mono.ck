@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(clock-mono) begin
+(clock-mono) time page gives timer frequency
+(clock-mono) clocks never ran backward
+(clock-mono) clock_ns agrees with clock_ticks
+(clock-mono) end
+clock-mono: exit(0)
+EOF
+pass;
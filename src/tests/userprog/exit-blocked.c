@@ -0,0 +1,89 @@
+/* Calls exit() while other threads of the process are blocked in
+   the kernel: reading an empty pipe, polling it, sleeping on a
+   futex, waiting for a locked umutex, and waiting for a child
+   process that never exits.  exit() must wake them all for the
+   process to finish. */
+
+#include <syscall.h>
+#include <uthread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int fds[2];
+static uint32_t word;
+static struct umutex held = UMUTEX_INITIALIZER;
+
+/* Counts the threads about to block. */
+static struct umutex ready_lock = UMUTEX_INITIALIZER;
+static struct ucond ready_cond = UCOND_INITIALIZER;
+static int ready;
+
+static void
+announce (void)
+{
+  umutex_lock (&ready_lock);
+  ready++;
+  ucond_signal (&ready_cond);
+  umutex_unlock (&ready_lock);
+}
+
+static void
+read_pipe (void *aux UNUSED)
+{
+  char c;
+  announce ();
+  read (fds[0], &c, 1);
+}
+
+static void
+poll_pipe (void *aux UNUSED)
+{
+  struct pollfd pfd = { fds[0], POLLIN, 0 };
+  announce ();
+  poll (&pfd, 1, -1);
+}
+
+static void
+wait_futex (void *aux UNUSED)
+{
+  announce ();
+  futex (&word, FUTEX_WAIT, 0);
+}
+
+static void
+lock_held (void *aux UNUSED)
+{
+  announce ();
+  umutex_lock (&held);
+}
+
+static void
+wait_child (void *aux UNUSED)
+{
+  announce ();
+  wait (exec ("child-block"));
+}
+
+void
+test_main (void)
+{
+  static void (*funcs[]) (void *) =
+    { read_pipe, poll_pipe, wait_futex, lock_held, wait_child };
+  const int cnt = sizeof funcs / sizeof *funcs;
+  int i;
+
+  CHECK (pipe (fds), "pipe");
+  umutex_lock (&held);
+  msg ("start %d threads", cnt);
+  for (i = 0; i < cnt; i++)
+    if (uthread_create (funcs[i], NULL) == TID_ERROR)
+      fail ("uthread_create failed");
+
+  umutex_lock (&ready_lock);
+  while (ready < cnt)
+    ucond_wait (&ready_cond, &ready_lock);
+  umutex_unlock (&ready_lock);
+
+  msg ("exit with threads blocked");
+  exit (57);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(exit-blocked) begin
+(exit-blocked) pipe
+(exit-blocked) start 5 threads
+(exit-blocked) exit with threads blocked
+exit-blocked: exit(57)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/* Sets and clears O_NONBLOCK on a pipe's read end, checking that
+   a read of the empty pipe returns -1 only while it is set, and
+   that fcntl rejects unknown flags and descriptors. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char c;
+  int fds[2];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (fcntl (fds[0], F_GETFL, 0) == 0, "flags start out clear");
+  CHECK (fcntl (fds[0], F_SETFL, O_NONBLOCK) == 0, "set O_NONBLOCK");
+  CHECK (fcntl (fds[0], F_GETFL, 0) == O_NONBLOCK, "get O_NONBLOCK");
+  CHECK (read (fds[0], &c, 1) == -1, "read empty pipe");
+
+  CHECK (write (fds[1], "y", 1) == 1, "write pipe");
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'y', "read pipe");
+
+  CHECK (fcntl (fds[0], F_SETFL, 0) == 0, "clear O_NONBLOCK");
+  CHECK (fcntl (fds[0], F_GETFL, 0) == 0, "flags are clear");
+  close (fds[1]);
+  CHECK (read (fds[0], &c, 1) == 0, "read at end of file");
+
+  CHECK (fcntl (fds[0], F_SETFL, 01) == -1, "set unknown flag");
+  CHECK (fcntl (60, F_GETFL, 0) == -1, "get flags of closed fd");
+  CHECK (fcntl (STDIN_FILENO, F_GETFL, 0) == 0, "get flags of stdin");
+}
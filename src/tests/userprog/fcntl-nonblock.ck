@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(fcntl-nonblock) begin
+(fcntl-nonblock) pipe
+(fcntl-nonblock) flags start out clear
+(fcntl-nonblock) set O_NONBLOCK
+(fcntl-nonblock) get O_NONBLOCK
+(fcntl-nonblock) read empty pipe
+(fcntl-nonblock) write pipe
+(fcntl-nonblock) read pipe
+(fcntl-nonblock) clear O_NONBLOCK
+(fcntl-nonblock) flags are clear
+(fcntl-nonblock) read at end of file
+(fcntl-nonblock) set unknown flag
+(fcntl-nonblock) get flags of closed fd
+(fcntl-nonblock) get flags of stdin
+(fcntl-nonblock) end
+fcntl-nonblock: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Reads a pipe until its only write end is closed, which must
+   show up as end of file once the buffered data is gone, then
+   checks that writing to a pipe without a read end fails. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  const char *text = "hello, pipe";
+  size_t len = strlen (text);
+  char buf[32];
+  int fds[2];
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (write (fds[1], text, len) == (int) len, "write %zu bytes", len);
+  close (fds[1]);
+  CHECK (read (fds[0], buf, sizeof buf) == (int) len, "read %zu bytes", len);
+  if (memcmp (buf, text, len))
+    fail ("read wrong data");
+  CHECK (read (fds[0], buf, sizeof buf) == 0, "read at end of file");
+  close (fds[0]);
+
+  CHECK (pipe (fds), "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], text, len) == -1, "write without a reader");
+  close (fds[1]);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-eof) begin
+(pipe-eof) pipe
+(pipe-eof) write 11 bytes
+(pipe-eof) read 11 bytes
+(pipe-eof) read at end of file
+(pipe-eof) pipe
+(pipe-eof) write without a reader
+(pipe-eof) end
+pipe-eof: exit(0)
+EOF
+pass;
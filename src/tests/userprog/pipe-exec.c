@@ -0,0 +1,35 @@
+/* Passes the write end of a pipe to a child process, which
+   inherits it under the same fd, and reads what the child writes
+   until end of file, which comes when the child exits. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char cmd_line[32];
+  char buf[64];
+  int fds[2];
+  int total = 0;
+  int n, status;
+  pid_t child;
+
+  CHECK (pipe (fds), "pipe");
+  snprintf (cmd_line, sizeof cmd_line, "child-pipe %d", fds[1]);
+  CHECK ((child = exec (cmd_line)) != PID_ERROR, "exec child-pipe");
+  close (fds[1]);
+
+  /* Print nothing until the child is gone, since its exit message
+     may come before or after end of file. */
+  while ((n = read (fds[0], buf + total, sizeof buf - 1 - total)) > 0)
+    total += n;
+  buf[total] = '\0';
+  status = wait (child);
+  CHECK (status == 0, "wait for child-pipe");
+  msg ("read \"%s\"", buf);
+  close (fds[0]);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+(pipe-exec) exec child-pipe
+child-pipe: exit(0)
+(pipe-exec) wait for child-pipe
+(pipe-exec) read "sent from child"
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Makes both ends of a pipe non-blocking, then checks that a
+   read of the empty pipe and a write to the full pipe return -1
+   instead of waiting. */
+
+#include <fcntl.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[4096];
+
+void
+test_main (void)
+{
+  int fds[2];
+  int total = 0;
+  int n;
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (fcntl (fds[0], F_SETFL, O_NONBLOCK) == 0, "make read end non-blocking");
+  CHECK (fcntl (fds[1], F_SETFL, O_NONBLOCK) == 0, "make write end non-blocking");
+  CHECK (fcntl (fds[0], F_GETFL, 0) == O_NONBLOCK, "get read end flags");
+  CHECK (read (fds[0], buf, sizeof buf) == -1, "read empty pipe");
+
+  /* Fill the pipe.  Once it is full, a write returns -1. */
+  while ((n = write (fds[1], buf, sizeof buf)) > 0)
+    total += n;
+  CHECK (n == -1 && total > 0, "fill pipe");
+  CHECK (write (fds[1], buf, 1) == -1, "write full pipe");
+
+  /* Reading makes room again. */
+  CHECK (read (fds[0], buf, sizeof buf) == sizeof buf, "read from pipe");
+  CHECK (write (fds[1], buf, 1) == 1, "write after read");
+  close (fds[0]);
+  close (fds[1]);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-nonblock) begin
+(pipe-nonblock) pipe
+(pipe-nonblock) make read end non-blocking
+(pipe-nonblock) make write end non-blocking
+(pipe-nonblock) get read end flags
+(pipe-nonblock) read empty pipe
+(pipe-nonblock) fill pipe
+(pipe-nonblock) write full pipe
+(pipe-nonblock) read from pipe
+(pipe-nonblock) write after read
+(pipe-nonblock) end
+pipe-nonblock: exit(0)
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Splices a file into a pipe and the pipe into another file,
+   then checks both copies. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  const int size = sizeof sample - 1;
+  char buf[sizeof sample];
+  int fds[2];
+  int in, out;
+
+  CHECK (pipe (fds), "pipe");
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (splice (in, fds[1], size) == size, "splice file into pipe");
+  CHECK (read (fds[0], buf, size) == size, "read pipe");
+  compare_bytes (buf, sample, size, 0, "pipe");
+
+  CHECK (create ("copy.txt", size), "create \"copy.txt\"");
+  CHECK ((out = open ("copy.txt")) > 1, "open \"copy.txt\"");
+  CHECK (write (fds[1], sample, size) == size, "write pipe");
+  CHECK (splice (fds[0], out, size) == size, "splice pipe into file");
+  close (out);
+  check_file ("copy.txt", sample, size);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-splice) begin
+(pipe-splice) pipe
+(pipe-splice) open "sample.txt"
+(pipe-splice) splice file into pipe
+(pipe-splice) read pipe
+(pipe-splice) create "copy.txt"
+(pipe-splice) open "copy.txt"
+(pipe-splice) write pipe
+(pipe-splice) splice pipe into file
+(pipe-splice) open "copy.txt" for verification
+(pipe-splice) verified contents of "copy.txt"
+(pipe-splice) close "copy.txt"
+(pipe-splice) end
+pipe-splice: exit(0)
+EOF
+pass;
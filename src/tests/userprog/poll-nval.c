@@ -0,0 +1,21 @@
+/* Polls a descriptor that is not open, which must report
+   POLLNVAL even though it was not asked for, and a negative one,
+   which must be skipped. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct pollfd pfds[2];
+
+  pfds[0].fd = 60;
+  pfds[0].events = POLLIN;
+  pfds[1].fd = -1;
+  pfds[1].events = POLLIN;
+  CHECK (poll (pfds, 2, -1) == 1, "poll");
+  CHECK (pfds[0].revents == POLLNVAL, "closed fd reports POLLNVAL");
+  CHECK (pfds[1].revents == 0, "negative fd is skipped");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-nval) begin
+(poll-nval) poll
+(poll-nval) closed fd reports POLLNVAL
+(poll-nval) negative fd is skipped
+(poll-nval) end
+poll-nval: exit(0)
+EOF
+pass;
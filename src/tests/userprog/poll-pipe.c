@@ -0,0 +1,50 @@
+/* Checks the events that poll reports for the ends of a pipe as
+   data arrives and ends close, and that a thread polling an empty
+   pipe wakes up when another thread writes to it. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int fds[2];
+
+static void
+writer (void *aux UNUSED)
+{
+  write (fds[1], "x", 1);
+}
+
+void
+test_main (void)
+{
+  struct pollfd pfds[2];
+  tid_t tid;
+  char c;
+
+  CHECK (pipe (fds), "pipe");
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  pfds[1].fd = fds[1];
+  pfds[1].events = POLLOUT;
+
+  CHECK (poll (pfds, 2, 0) == 1 && pfds[0].revents == 0
+         && pfds[1].revents == POLLOUT, "empty pipe is writable only");
+
+  CHECK ((tid = uthread_create (writer, NULL)) != TID_ERROR,
+         "start writer thread");
+  CHECK (poll (pfds, 1, -1) == 1 && pfds[0].revents == POLLIN,
+         "poll wakes up for data");
+  uthread_join (tid);
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'x', "read data");
+
+  close (fds[1]);
+  CHECK (poll (pfds, 1, -1) == 1 && pfds[0].revents == POLLHUP,
+         "read end hangs up without a writer");
+
+  CHECK (pipe (fds), "pipe");
+  pfds[1].fd = fds[1];
+  close (fds[0]);
+  CHECK (poll (&pfds[1], 1, -1) == 1 && pfds[1].revents == POLLERR,
+         "write end errors without a reader");
+  close (fds[1]);
+}
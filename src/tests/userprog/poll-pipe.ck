@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-pipe) begin
+(poll-pipe) pipe
+(poll-pipe) empty pipe is writable only
+(poll-pipe) start writer thread
+(poll-pipe) poll wakes up for data
+(poll-pipe) read data
+(poll-pipe) read end hangs up without a writer
+(poll-pipe) pipe
+(poll-pipe) write end errors without a reader
+(poll-pipe) end
+poll-pipe: exit(0)
+EOF
+pass;
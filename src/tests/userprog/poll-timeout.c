@@ -0,0 +1,31 @@
+/* Polls an empty pipe with a timeout of 0, which must return at
+   once, and with a finite timeout, which must return 0 after at
+   least that long. */
+
+#include <clock.h>
+#include <syscall.h>
+#include <vtime.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  struct pollfd pfd;
+  int fds[2];
+  int64_t start, elapsed;
+
+  CHECK (pipe (fds), "pipe");
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+
+  CHECK (poll (&pfd, 1, 0) == 0 && pfd.revents == 0, "poll with timeout 0");
+
+  start = clock_ticks ();
+  CHECK (poll (&pfd, 1, 100) == 0 && pfd.revents == 0,
+         "poll with timeout 100 ms");
+  elapsed = clock_ticks () - start;
+  if (elapsed * 1000 < 100 * VTIME_ADDR->freq)
+    fail ("poll returned after only %lld ticks", elapsed);
+  msg ("poll waited long enough");
+}
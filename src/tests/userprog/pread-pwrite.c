@@ -0,0 +1,41 @@
+/* Reads and writes a file at explicit offsets with pread and
+   pwrite, which must leave the file position alone and stop
+   short at end of file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  int size = sizeof sample - 1;
+  char buf[32];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (pread (handle, buf, 20, 10) == 20, "pread 20 bytes at offset 10");
+  if (memcmp (buf, sample + 10, 20))
+    fail ("pread returned wrong data");
+  CHECK (tell (handle) == 0, "file position is still 0");
+  CHECK (pread (handle, buf, 20, size - 5) == 5,
+         "pread 20 bytes at 5 before end of file reads 5");
+  if (memcmp (buf, sample + size - 5, 5))
+    fail ("short pread returned wrong data");
+  CHECK (pread (handle, buf, 20, size) == 0, "pread at end of file reads 0");
+  CHECK (pread (handle, buf, 20, -1) == -1, "pread at offset -1 fails");
+  close (handle);
+
+  CHECK (create ("data", 16), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (pwrite (handle, "abcd", 4, 4) == 4, "pwrite 4 bytes at offset 4");
+  CHECK (tell (handle) == 0, "file position is still 0");
+  CHECK (pwrite (handle, "xyz", 3, 14) == 2,
+         "pwrite 3 bytes at 2 before end of file writes 2");
+  CHECK (read (handle, buf, 16) == 16, "read \"data\"");
+  if (memcmp (buf, "\0\0\0\0abcd\0\0\0\0\0\0xy", 16))
+    fail ("\"data\" does not hold what pwrite wrote");
+  close (handle);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-pwrite) begin
+(pread-pwrite) open "sample.txt"
+(pread-pwrite) pread 20 bytes at offset 10
+(pread-pwrite) file position is still 0
+(pread-pwrite) pread 20 bytes at 5 before end of file reads 5
+(pread-pwrite) pread at end of file reads 0
+(pread-pwrite) pread at offset -1 fails
+(pread-pwrite) create "data"
+(pread-pwrite) open "data"
+(pread-pwrite) pwrite 4 bytes at offset 4
+(pread-pwrite) file position is still 0
+(pread-pwrite) pwrite 3 bytes at 2 before end of file writes 2
+(pread-pwrite) read "data"
+(pread-pwrite) end
+pread-pwrite: exit(0)
+EOF
+pass;
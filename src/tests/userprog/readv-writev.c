@@ -0,0 +1,89 @@
+/* Gathers pieces into a file with writev and scatters them back
+   out with readv, which must stop short at end of file.  Vectors
+   of more than IOV_MAX buffers are refused. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <uio.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  static const char data[] = "scattered and gathered";
+  static char many[IOV_MAX + 1];
+  struct iovec iov[IOV_MAX + 1];
+  char buf[sizeof sample];
+  char tail[16];
+  int size = sizeof sample - 1;
+  int len = sizeof data - 1;
+  int handle;
+  int i;
+
+  /* To the console, in two pieces forming one line. */
+  iov[0].iov_base = (char *) "(readv-writev) one line in";
+  iov[0].iov_len = strlen (iov[0].iov_base);
+  iov[1].iov_base = (char *) " two pieces\n";
+  iov[1].iov_len = strlen (iov[1].iov_base);
+  CHECK (writev (STDOUT_FILENO, iov, 2) == 38, "writev to console");
+
+  /* To and from a file, cut in different places each way. */
+  CHECK (create ("data", len), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  iov[0].iov_base = (char *) data;
+  iov[0].iov_len = 9;
+  iov[1].iov_base = (char *) data + 9;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = (char *) data + 9;
+  iov[2].iov_len = len - 9;
+  CHECK (writev (handle, iov, 3) == len, "writev to \"data\"");
+  CHECK ((int) tell (handle) == len, "writev advanced file position");
+  seek (handle, 0);
+  memset (buf, 0, sizeof buf);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = 4;
+  iov[1].iov_base = buf + 4;
+  iov[1].iov_len = len - 4;
+  CHECK (readv (handle, iov, 2) == len, "readv from \"data\"");
+  if (strcmp (buf, data))
+    fail ("readv returned \"%s\"", buf);
+  close (handle);
+
+  /* Past end of file: the last buffer is only partly filled and
+     the one after it not at all. */
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  memset (tail, 'x', sizeof tail);
+  iov[0].iov_base = buf;
+  iov[0].iov_len = size - 3;
+  iov[1].iov_base = tail;
+  iov[1].iov_len = 8;
+  iov[2].iov_base = tail + 8;
+  iov[2].iov_len = 8;
+  CHECK (readv (handle, iov, 3) == size, "readv past end of file");
+  if (memcmp (buf, sample, size - 3) || memcmp (tail, sample + size - 3, 3))
+    fail ("short readv returned wrong data");
+  for (i = 3; i < (int) sizeof tail; i++)
+    if (tail[i] != 'x')
+      fail ("readv wrote past end of file data at byte %d", i);
+  CHECK (readv (handle, iov, 3) == 0, "readv at end of file reads 0");
+
+  /* Vector length limits. */
+  seek (handle, 0);
+  for (i = 0; i < IOV_MAX + 1; i++)
+    {
+      iov[i].iov_base = many + i;
+      iov[i].iov_len = 1;
+    }
+  CHECK (readv (handle, iov, IOV_MAX) == IOV_MAX,
+         "readv with IOV_MAX buffers");
+  if (memcmp (many, sample, IOV_MAX))
+    fail ("readv with IOV_MAX buffers returned wrong data");
+  CHECK (readv (handle, iov, IOV_MAX + 1) == -1,
+         "readv with IOV_MAX + 1 buffers fails");
+  CHECK (readv (handle, iov, -1) == -1, "readv with -1 buffers fails");
+  CHECK (tell (handle) == IOV_MAX, "failed readv left file position alone");
+  close (handle);
+}
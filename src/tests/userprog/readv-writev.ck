@@ -0,0 +1,24 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-writev) begin
+(readv-writev) writev to console
+(readv-writev) one line in two pieces
+(readv-writev) create "data"
+(readv-writev) open "data"
+(readv-writev) writev to "data"
+(readv-writev) writev advanced file position
+(readv-writev) readv from "data"
+(readv-writev) open "sample.txt"
+(readv-writev) readv past end of file
+(readv-writev) readv at end of file reads 0
+(readv-writev) readv with IOV_MAX buffers
+(readv-writev) readv with IOV_MAX + 1 buffers fails
+(readv-writev) readv with -1 buffers fails
+(readv-writev) failed readv left file position alone
+(readv-writev) end
+readv-writev: exit(0)
+EOF
+pass;
@@ -0,0 +1,105 @@
+/* Opens, reads, writes and closes a file through a ring,
+   submitting several requests with each call to ring_enter and
+   matching completions to submissions by their user data. */
+
+#include <ring.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct ring *ring = (struct ring *) 0x10000000;
+
+/* Results of completions, indexed by user data. */
+static int results[16];
+
+/* Queues a submission. */
+static void
+queue (uint32_t op, int fd, void *buf, uint32_t len, int offset,
+       uint32_t user_data)
+{
+  struct ring_sqe *sqe = &ring->sq[ring->sq_tail % RING_ENTRIES];
+
+  sqe->op = op;
+  sqe->fd = fd;
+  sqe->buf = buf;
+  sqe->len = len;
+  sqe->offset = offset;
+  sqe->user_data = user_data;
+  ring->sq_tail++;
+}
+
+/* Submits the CNT queued submissions, waits for all of them to
+   complete, and records their results. */
+static void
+run (unsigned cnt)
+{
+  unsigned i;
+
+  if (ring_enter (cnt, cnt) != (int) cnt)
+    fail ("ring_enter did not submit %u requests", cnt);
+  for (i = 0; i < cnt; i++)
+    {
+      struct ring_cqe *cqe;
+
+      if (ring->cq_head == ring->cq_tail)
+        fail ("only %u of %u requests completed", i, cnt);
+      cqe = &ring->cq[ring->cq_head % RING_ENTRIES];
+      if (cqe->user_data >= sizeof results / sizeof *results)
+        fail ("completion has bad user data %u", cqe->user_data);
+      results[cqe->user_data] = cqe->res;
+      ring->cq_head++;
+    }
+}
+
+void
+test_main (void)
+{
+  int size = sizeof sample - 1;
+  char at_start[20], first[20], second[20], tail[20];
+  char line[] = "(ring-batch) written through the ring\n";
+  int handle;
+
+  CHECK (ring_setup (ring), "ring_setup");
+  CHECK (!ring_setup ((struct ring *) 0x20000000),
+         "second ring_setup (must fail)");
+
+  msg ("open \"sample.txt\" through the ring");
+  queue (RING_OPEN, 0, "sample.txt", 0, 0, 1);
+  queue (RING_OPEN, 0, "no-such-file", 0, 0, 2);
+  run (2);
+  CHECK ((handle = results[1]) > 1, "open \"sample.txt\" completed");
+  CHECK (results[2] == -1, "open \"no-such-file\" failed");
+
+  msg ("read \"sample.txt\" through the ring");
+  queue (RING_READ, handle, at_start, sizeof at_start, 0, 3);
+  queue (RING_READ, handle, first, sizeof first, RING_CURRENT_POS, 4);
+  queue (RING_READ, handle, second, sizeof second, RING_CURRENT_POS, 5);
+  queue (RING_READ, handle, tail, sizeof tail, size - 5, 6);
+  queue (RING_NOP, 0, NULL, 0, 0, 7);
+  queue (99, 0, NULL, 0, 0, 8);
+  run (6);
+  CHECK (results[3] == 20 && !memcmp (at_start, sample, 20),
+         "read at offset 0");
+  CHECK (results[4] == 20 && !memcmp (first, sample, 20),
+         "first read at current position");
+  CHECK (results[5] == 20 && !memcmp (second, sample + 20, 20),
+         "second read at current position");
+  CHECK (results[6] == 5 && !memcmp (tail, sample + size - 5, 5),
+         "read at 5 before end of file reads 5");
+  CHECK (results[7] == 0, "nop");
+  CHECK (results[8] == -1, "unknown operation failed");
+  CHECK (tell (handle) == 40, "reads at current position advanced it");
+
+  queue (RING_WRITE, STDOUT_FILENO, line, strlen (line), RING_CURRENT_POS, 9);
+  run (1);
+  CHECK (results[9] == (int) strlen (line), "write to console");
+
+  queue (RING_CLOSE, handle, NULL, 0, 0, 10);
+  queue (RING_CLOSE, handle, NULL, 0, 0, 11);
+  run (2);
+  CHECK (results[10] == 0, "close \"sample.txt\"");
+  CHECK (results[11] == -1, "close \"sample.txt\" again failed");
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-batch) begin
+(ring-batch) ring_setup
+(ring-batch) second ring_setup (must fail)
+(ring-batch) open "sample.txt" through the ring
+(ring-batch) open "sample.txt" completed
+(ring-batch) open "no-such-file" failed
+(ring-batch) read "sample.txt" through the ring
+(ring-batch) read at offset 0
+(ring-batch) first read at current position
+(ring-batch) second read at current position
+(ring-batch) read at 5 before end of file reads 5
+(ring-batch) nop
+(ring-batch) unknown operation failed
+(ring-batch) reads at current position advanced it
+(ring-batch) written through the ring
+(ring-batch) write to console
+(ring-batch) close "sample.txt"
+(ring-batch) close "sample.txt" again failed
+(ring-batch) end
+ring-batch: exit(0)
+EOF
+pass;
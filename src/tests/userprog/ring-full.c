@@ -0,0 +1,58 @@
+/* Fills the ring with no-ops and checks that ring_enter submits
+   nothing more while the completion queue is full, until the
+   process consumes completions. */
+
+#include <ring.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static struct ring *ring = (struct ring *) 0x10000000;
+
+/* Queues CNT no-ops. */
+static void
+queue_nops (int cnt)
+{
+  for (; cnt > 0; cnt--)
+    {
+      struct ring_sqe *sqe = &ring->sq[ring->sq_tail % RING_ENTRIES];
+      sqe->op = RING_NOP;
+      sqe->user_data = ring->sq_tail;
+      ring->sq_tail++;
+    }
+}
+
+/* Consumes every posted completion, checking that each is a
+   successful no-op.  Returns the number consumed. */
+static int
+consume (void)
+{
+  int cnt = 0;
+
+  for (; ring->cq_head != ring->cq_tail; ring->cq_head++, cnt++)
+    {
+      struct ring_cqe *cqe = &ring->cq[ring->cq_head % RING_ENTRIES];
+      if (cqe->res != 0)
+        fail ("no-op %u completed with result %d",
+              cqe->user_data, cqe->res);
+    }
+  return cnt;
+}
+
+void
+test_main (void)
+{
+  CHECK (ring_enter (1, 0) == -1, "ring_enter without a ring (must fail)");
+  CHECK (ring_setup (ring), "ring_setup");
+
+  queue_nops (RING_ENTRIES);
+  CHECK (ring_enter (RING_ENTRIES, RING_ENTRIES) == RING_ENTRIES,
+         "submit a full ring of no-ops");
+  queue_nops (1);
+  CHECK (ring_enter (1, 0) == 0,
+         "submit with full completion queue submits nothing");
+  CHECK (consume () == RING_ENTRIES, "consume completions");
+  CHECK (ring_enter (1, 1) == 1, "submit the no-op left over");
+  CHECK (consume () == 1, "consume its completion");
+  CHECK (ring_enter (1, 0) == 0, "submit with empty queue submits nothing");
+}
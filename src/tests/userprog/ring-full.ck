@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ring-full) begin
+(ring-full) ring_enter without a ring (must fail)
+(ring-full) ring_setup
+(ring-full) submit a full ring of no-ops
+(ring-full) submit with full completion queue submits nothing
+(ring-full) consume completions
+(ring-full) submit the no-op left over
+(ring-full) consume its completion
+(ring-full) submit with empty queue submits nothing
+(ring-full) end
+ring-full: exit(0)
+EOF
+pass;
@@ -0,0 +1,36 @@
+/* Checks that getrusage counts system calls by number and timer
+   ticks spent running in user mode, and rejects an unknown WHO. */
+
+#include <clock.h>
+#include <rusage.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  static struct rusage before, after;
+  int64_t start;
+  int handle;
+  int i;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (getrusage (RUSAGE_SELF, &before), "getrusage");
+  for (i = 0; i < 10; i++)
+    tell (handle);
+  start = clock_ticks ();
+  while (clock_ticks () - start < 5)
+    continue;
+  CHECK (getrusage (RUSAGE_SELF, &after), "getrusage again");
+
+  CHECK (after.syscalls[SYS_TELL] - before.syscalls[SYS_TELL] == 10,
+         "counted 10 calls to tell");
+  CHECK (after.syscalls[SYS_GETRUSAGE] - before.syscalls[SYS_GETRUSAGE] == 1,
+         "counted 1 call to getrusage");
+  CHECK (after.syscalls[SYS_OPEN] == 1, "counted 1 call to open");
+  CHECK (after.user_ticks > before.user_ticks,
+         "counted ticks spent in user mode");
+  CHECK (!getrusage (2, &after), "getrusage for unknown WHO (must fail)");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage-self) begin
+(rusage-self) open "sample.txt"
+(rusage-self) getrusage
+(rusage-self) getrusage again
+(rusage-self) counted 10 calls to tell
+(rusage-self) counted 1 call to getrusage
+(rusage-self) counted 1 call to open
+(rusage-self) counted ticks spent in user mode
+(rusage-self) getrusage for unknown WHO (must fail)
+(rusage-self) end
+rusage-self: exit(0)
+EOF
+pass;
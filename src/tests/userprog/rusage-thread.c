@@ -0,0 +1,46 @@
+/* Checks that getrusage with RUSAGE_THREAD counts only the
+   calling thread's system calls, and that RUSAGE_SELF includes
+   those of a thread that has exited. */
+
+#include <rusage.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int handle;
+static struct rusage child_usage;
+
+static void
+call_tell (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < 20; i++)
+    tell (handle);
+  getrusage (RUSAGE_THREAD, &child_usage);
+}
+
+void
+test_main (void)
+{
+  static struct rusage before, thread, self;
+  tid_t tid;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (getrusage (RUSAGE_SELF, &before), "getrusage for process");
+  CHECK ((tid = uthread_create (call_tell, NULL)) != TID_ERROR,
+         "create thread");
+  CHECK (uthread_join (tid) == 0, "join thread");
+
+  CHECK (child_usage.syscalls[SYS_TELL] == 20,
+         "thread counted its own 20 calls to tell");
+  CHECK (child_usage.syscalls[SYS_OPEN] == 0,
+         "thread did not count main thread's open");
+  CHECK (getrusage (RUSAGE_THREAD, &thread), "getrusage for main thread");
+  CHECK (thread.syscalls[SYS_TELL] == 0,
+         "main thread counted none of the thread's calls");
+  CHECK (getrusage (RUSAGE_SELF, &self), "getrusage for process again");
+  CHECK (self.syscalls[SYS_TELL] - before.syscalls[SYS_TELL] == 20,
+         "process counted the exited thread's calls");
+}
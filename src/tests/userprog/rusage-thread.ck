@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rusage-thread) begin
+(rusage-thread) open "sample.txt"
+(rusage-thread) getrusage for process
+(rusage-thread) create thread
+(rusage-thread) join thread
+(rusage-thread) thread counted its own 20 calls to tell
+(rusage-thread) thread did not count main thread's open
+(rusage-thread) getrusage for main thread
+(rusage-thread) main thread counted none of the thread's calls
+(rusage-thread) getrusage for process again
+(rusage-thread) process counted the exited thread's calls
+(rusage-thread) end
+rusage-thread: exit(0)
+EOF
+pass;
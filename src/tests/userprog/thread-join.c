@@ -0,0 +1,37 @@
+/* Creates threads that exit in different ways and joins them,
+   checking the status each one left and that a thread can be
+   joined only once. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int values[2];
+
+static void
+exit_with (void *aux)
+{
+  values[0] = 1;
+  uthread_exit ((int) aux);
+}
+
+static void
+return_normally (void *aux)
+{
+  values[1] = (int) aux;
+}
+
+void
+test_main (void)
+{
+  tid_t a, b;
+
+  CHECK ((a = uthread_create (exit_with, (void *) 42)) != TID_ERROR,
+         "create thread a");
+  CHECK ((b = uthread_create (return_normally, (void *) 7)) != TID_ERROR,
+         "create thread b");
+  CHECK (uthread_join (a) == 42, "join a");
+  CHECK (uthread_join (b) == 0, "join b");
+  CHECK (uthread_join (a) == -1, "join a again");
+  CHECK (values[0] == 1 && values[1] == 7, "threads share memory");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(thread-join) begin
+(thread-join) create thread a
+(thread-join) create thread b
+(thread-join) join a
+(thread-join) join b
+(thread-join) join a again
+(thread-join) threads share memory
+(thread-join) end
+thread-join: exit(0)
+EOF
+pass;
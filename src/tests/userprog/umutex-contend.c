@@ -0,0 +1,50 @@
+/* Has several threads increment a shared counter under one
+   umutex, so that they contend for it and must sleep in the
+   kernel, and checks that no increment is lost. */
+
+#include <syscall.h>
+#include <uthread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITERATIONS 2000
+
+static struct umutex lock = UMUTEX_INITIALIZER;
+static volatile int counter;
+
+static void
+increment (void *aux UNUSED)
+{
+  int i, j;
+
+  for (i = 0; i < ITERATIONS; i++)
+    {
+      umutex_lock (&lock);
+      int value = counter;
+
+      /* Hold the lock a while, so that the timer preempts us
+         with it held now and then. */
+      for (j = 0; j < 50; j++)
+        asm volatile ("");
+      counter = value + 1;
+      umutex_unlock (&lock);
+    }
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  msg ("start %d threads", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++)
+    if ((tids[i] = uthread_create (increment, NULL)) == TID_ERROR)
+      fail ("uthread_create failed");
+  for (i = 0; i < THREAD_CNT; i++)
+    if (uthread_join (tids[i]) != 0)
+      fail ("uthread_join failed");
+  msg ("counter is %d", counter);
+  CHECK (lock.state == 0, "lock is free");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(umutex-contend) begin
+(umutex-contend) start 4 threads
+(umutex-contend) counter is 8000
+(umutex-contend) lock is free
+(umutex-contend) end
+umutex-contend: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Reads the time page, which is mapped into every process, and
+   then tries to write to it.  The process must be terminated with
+   -1 exit code. */
+
+#include <vtime.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  volatile struct vtime *vt = (volatile struct vtime *) VTIME_ADDR;
+
+  CHECK (vt->freq != 0, "read time page");
+  vt->ticks = 0;
+  fail ("wrote to the time page");
+}
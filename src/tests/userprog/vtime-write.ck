@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_USER_FAULTS => 1, [<<'EOF']);
+(vtime-write) begin
+(vtime-write) read time page
+vtime-write: exit(-1)
+EOF
+pass;
@@ -0,0 +1,23 @@
+/* Child process for shm-share test.
+   Attaches "shm-share" at an address of its own, checks the
+   parent's message in the first page and writes a reply to the
+   second. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x20000000;
+
+  CHECK (shm_attach ("shm-share", shared) == shared,
+         "shm_attach \"shm-share\"");
+  if (strcmp (shared, "sent from parent"))
+    fail ("child read \"%s\" from first page", shared);
+  msg ("child read message from parent");
+  strlcpy (shared + 4096, "sent from child", 4096);
+  CHECK (shm_detach (shared), "shm_detach");
+}
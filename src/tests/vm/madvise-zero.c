@@ -0,0 +1,47 @@
+/* Fills heap pages, discards the middle ones with MADV_DONTNEED,
+   and checks that they read back as zeros while their neighbors
+   keep their data.  Also checks that madvise() rejects ranges
+   outside the heap. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+static void
+check_page (const uint8_t *page, uint8_t value)
+{
+  size_t i;
+
+  for (i = 0; i < PAGE; i++)
+    if (page[i] != value)
+      fail ("byte %zu is %02hhx instead of %02hhx", i, page[i], value);
+}
+
+void
+test_main (void)
+{
+  uint8_t *heap;
+
+  CHECK ((heap = sbrk (4 * PAGE)) != (void *) -1, "grow heap by 4 pages");
+  memset (heap, 0xaa, 4 * PAGE);
+
+  CHECK (madvise (heap + PAGE, 2 * PAGE, MADV_DONTNEED) == 0,
+         "discard middle 2 pages");
+  check_page (heap, 0xaa);
+  check_page (heap + PAGE, 0);
+  check_page (heap + 2 * PAGE, 0);
+  check_page (heap + 3 * PAGE, 0xaa);
+  msg ("discarded pages read zeros");
+
+  memset (heap + PAGE, 0x55, PAGE);
+  check_page (heap + PAGE, 0x55);
+  msg ("discarded page is writable");
+
+  CHECK (madvise (heap + 1, PAGE, MADV_DONTNEED) == -1, "misaligned address");
+  CHECK (madvise (heap, 5 * PAGE, MADV_DONTNEED) == -1, "range past break");
+  CHECK (madvise (heap, PAGE, 99) == -1, "unknown advice");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(madvise-zero) begin
+(madvise-zero) grow heap by 4 pages
+(madvise-zero) discard middle 2 pages
+(madvise-zero) discarded pages read zeros
+(madvise-zero) discarded page is writable
+(madvise-zero) misaligned address
+(madvise-zero) range past break
+(madvise-zero) unknown advice
+(madvise-zero) end
+madvise-zero: exit(0)
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Frees two adjacent large blocks and checks that malloc() reuses
+   them as one block without growing the heap, then frees
+   everything and checks that the heap shrinks. */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK (32 * 1024)
+
+void
+test_main (void)
+{
+  uint8_t *a, *b, *c, *d;
+  void *brk;
+  size_t i;
+
+  CHECK ((a = malloc (BLOCK)) != NULL, "malloc a");
+  CHECK ((b = malloc (BLOCK)) != NULL, "malloc b");
+  CHECK ((c = malloc (BLOCK)) != NULL, "malloc c");
+  memset (c, 0xcc, BLOCK);
+  brk = sbrk (0);
+
+  free (a);
+  free (b);
+  CHECK ((d = malloc (2 * BLOCK)) == a, "malloc d in place of a and b");
+  CHECK (sbrk (0) == brk, "heap did not grow");
+  memset (d, 0xdd, 2 * BLOCK);
+  for (i = 0; i < BLOCK; i++)
+    if (c[i] != 0xcc)
+      fail ("byte %zu of c changed to %02hhx", i, c[i]);
+  msg ("c is intact");
+
+  free (c);
+  free (d);
+  CHECK ((uint8_t *) sbrk (0) < (uint8_t *) brk, "heap shrank");
+}
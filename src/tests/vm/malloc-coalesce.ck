@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-coalesce) begin
+(malloc-coalesce) malloc a
+(malloc-coalesce) malloc b
+(malloc-coalesce) malloc c
+(malloc-coalesce) malloc d in place of a and b
+(malloc-coalesce) heap did not grow
+(malloc-coalesce) c is intact
+(malloc-coalesce) heap shrank
+(malloc-coalesce) end
+malloc-coalesce: exit(0)
+EOF
+pass;
@@ -0,0 +1,42 @@
+/* Grows the heap with sbrk(), shrinks it, and grows it again,
+   checking that the break moves as asked, that data below the
+   break survives, and that a page given back and taken again
+   reads as zeros.  Finally touches a page above the break, which
+   must kill the process. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+void
+test_main (void)
+{
+  uint8_t *start = sbrk (0);
+  size_t i;
+
+  CHECK (sbrk (3 * PAGE) == start, "grow heap by 3 pages");
+  CHECK (sbrk (0) == start + 3 * PAGE, "break moved up");
+  memset (start, 0x5a, 3 * PAGE);
+
+  CHECK (sbrk (-2 * PAGE) == start + 3 * PAGE, "shrink heap by 2 pages");
+  CHECK (sbrk (0) == start + PAGE, "break moved down");
+  for (i = 0; i < PAGE; i++)
+    if (start[i] != 0x5a)
+      fail ("byte %zu below break changed to %02hhx", i, start[i]);
+  msg ("data below break survived");
+
+  CHECK (sbrk (PAGE) == start + PAGE, "grow heap by 1 page");
+  for (i = PAGE; i < 2 * PAGE; i++)
+    if (start[i] != 0)
+      fail ("byte %zu of regrown page is %02hhx", i, start[i]);
+  msg ("regrown page reads zeros");
+
+  CHECK (sbrk (-3 * PAGE) == (void *) -1, "shrink below start of heap");
+
+  msg ("touch page above break");
+  fail ("read %02hhx above break", start[2 * PAGE]);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk-grow) begin
+(sbrk-grow) grow heap by 3 pages
+(sbrk-grow) break moved up
+(sbrk-grow) shrink heap by 2 pages
+(sbrk-grow) break moved down
+(sbrk-grow) data below break survived
+(sbrk-grow) grow heap by 1 page
+(sbrk-grow) regrown page reads zeros
+(sbrk-grow) shrink below start of heap
+(sbrk-grow) touch page above break
+sbrk-grow: exit(-1)
+EOF
+pass;
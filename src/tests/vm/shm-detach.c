@@ -0,0 +1,20 @@
+/* Attaches a shared memory object, detaches it, and then touches
+   the address it was attached at.  The process must be terminated
+   with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+
+  CHECK (shm_create ("shm-detach", 4096), "shm_create \"shm-detach\"");
+  CHECK (shm_attach ("shm-detach", shared) == shared,
+         "shm_attach \"shm-detach\"");
+  shared[0] = 'x';
+  CHECK (shm_detach (shared), "shm_detach");
+  fail ("detached memory is readable (%d)", *shared);
+}
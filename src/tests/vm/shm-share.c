@@ -0,0 +1,36 @@
+/* Attaches a shared memory object, writes to it, and runs
+   child-shm, which attaches the same object at another address,
+   checks what the parent wrote, and writes a reply that the
+   parent then reads back. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *shared = (char *) 0x10000000;
+  pid_t child;
+  int status;
+
+  CHECK (shm_create ("shm-share", 2 * 4096), "shm_create \"shm-share\"");
+  CHECK (!shm_create ("shm-share", 4096),
+         "shm_create \"shm-share\" again (must fail)");
+  CHECK (shm_attach ("shm-share", shared) == shared,
+         "shm_attach \"shm-share\"");
+  strlcpy (shared, "sent from parent", 4096);
+
+  CHECK ((child = exec ("child-shm")) != -1, "exec \"child-shm\"");
+  status = wait (child);
+  CHECK (status == 0, "wait for child");
+
+  if (strcmp (shared + 4096, "sent from child"))
+    fail ("parent read \"%s\" from second page", shared + 4096);
+  msg ("parent read reply from child");
+
+  CHECK (shm_detach (shared), "shm_detach");
+  CHECK (!shm_detach (shared), "shm_detach again (must fail)");
+  CHECK (shm_remove ("shm-share"), "shm_remove \"shm-share\"");
+}
@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-share) begin
+(shm-share) shm_create "shm-share"
+(shm-share) shm_create "shm-share" again (must fail)
+(shm-share) shm_attach "shm-share"
+(shm-share) exec "child-shm"
+(child-shm) begin
+(child-shm) shm_attach "shm-share"
+(child-shm) child read message from parent
+(child-shm) shm_detach
+(child-shm) end
+child-shm: exit(0)
+(shm-share) wait for child
+(shm-share) parent read reply from child
+(shm-share) shm_detach
+(shm-share) shm_detach again (must fail)
+(shm-share) shm_remove "shm-share"
+(shm-share) end
+shm-share: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Fills a shared memory object, detaches it so that, still named
+   but attached nowhere, it is swapped out, and then attaches it
+   again elsewhere and checks that its data came back.  Once
+   removed, the object may no longer be attached by name. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (16 * 4096)
+
+void
+test_main (void)
+{
+  unsigned char *first = (unsigned char *) 0x10000000;
+  unsigned char *second = (unsigned char *) 0x20000000;
+  size_t i;
+
+  CHECK (shm_create ("shm-swap", SIZE), "shm_create \"shm-swap\"");
+  CHECK (shm_attach ("shm-swap", first) == first, "shm_attach at first");
+  for (i = 0; i < SIZE; i++)
+    if (first[i] != 0)
+      fail ("byte %zu of new object is %d, not 0", i, first[i]);
+  for (i = 0; i < SIZE; i++)
+    first[i] = i % 251;
+  CHECK (shm_detach (first), "shm_detach from first");
+
+  CHECK (shm_attach ("shm-swap", second) == second, "shm_attach at second");
+  for (i = 0; i < SIZE; i++)
+    if (second[i] != i % 251)
+      fail ("byte %zu is %d after reattach, not %zu",
+            i, second[i], i % 251);
+  msg ("data survived detach");
+
+  CHECK (shm_remove ("shm-swap"), "shm_remove \"shm-swap\"");
+  CHECK (second[SIZE - 1] == (SIZE - 1) % 251,
+         "removed object stays attached");
+  CHECK (shm_detach (second), "shm_detach from second");
+  CHECK (shm_attach ("shm-swap", first) == NULL,
+         "shm_attach removed object (must fail)");
+}
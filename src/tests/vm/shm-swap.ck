@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-swap) begin
+(shm-swap) shm_create "shm-swap"
+(shm-swap) shm_attach at first
+(shm-swap) shm_detach from first
+(shm-swap) shm_attach at second
+(shm-swap) data survived detach
+(shm-swap) shm_remove "shm-swap"
+(shm-swap) removed object stays attached
+(shm-swap) shm_detach from second
+(shm-swap) shm_attach removed object (must fail)
+(shm-swap) end
+shm-swap: exit(0)
+EOF
+pass;
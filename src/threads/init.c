@@ -4,6 +4,7 @@
 #include <inttypes.h>
 #include <limits.h>
 #include <random.h>
+#include <round.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,9 +36,12 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/virtio-blk.h"
+#include "devices/ramdisk.h"
 #include "devices/swap.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/journal.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -52,6 +56,11 @@ static bool format_filesys;
 static const char *filesys_bdev_name;
 static const char *scratch_bdev_name;
 static const char *swap_bdev_name;
+
+/* -rd, -rd-himem: Size of RAM disk in kB, and whether to take it
+   from reserved high memory rather than the kernel pool. */
+static size_t ramdisk_kb;
+static bool ramdisk_himem;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
@@ -77,6 +86,9 @@ int
 main (void)
 {
   char **argv;
+#ifdef FILESYS
+  void *ramdisk_memory = NULL;
+#endif
 
   /* Clear BSS. */  
   bss_init ();
@@ -95,6 +107,11 @@ main (void)
           init_ram_pages * PGSIZE / 1024);
 
   /* Initialize memory system. */
+#ifdef FILESYS
+  if (ramdisk_himem && ramdisk_kb > 0)
+    ramdisk_memory = palloc_reserve_high (DIV_ROUND_UP (ramdisk_kb * 1024,
+                                                        PGSIZE));
+#endif
   palloc_init (user_page_limit);
     malloc_init ();
   paging_init ();
@@ -121,11 +138,15 @@ main (void)
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
+  console_start ();
   timer_calibrate ();
 
 #ifdef FILESYS
-  /* Initialize file system. */
+  /* Initialize file system.  virtio disks are probed first, so
+     that by default their partitions take the roles. */
+  virtio_blk_init ();
   ide_init ();
+  ramdisk_init (ramdisk_kb, ramdisk_memory);
   locate_block_devices ();
   filesys_init (format_filesys);
   swap_init ();
@@ -251,6 +272,12 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-rd"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-rd-himem"))
+        ramdisk_himem = true;
+      else if (!strcmp (name, "-journal-crash"))
+        journal_crash = true;
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
@@ -261,6 +288,8 @@ parse_options (char **argv)
         user_page_limit = atoi (value);
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-rusage"))
+        process_print_rusage = true;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -287,7 +316,15 @@ run_task (char **argv)
 
   printf ("Executing '%s':\n", task);
 #ifdef USERPROG
-  process_wait (process_execute (task));
+  {
+    /* process_execute() takes a malloc()'d command line. */
+    size_t size = strlen (task) + 1;
+    char *cmd_line = malloc (size);
+    if (cmd_line == NULL)
+      PANIC ("out of memory running '%s'", task);
+    memcpy (cmd_line, task, size);
+    process_wait (process_execute (cmd_line));
+  }
 #else
   run_test (task);
 #endif
@@ -375,12 +412,16 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -rd=KB             Create a KB kB RAM disk named rd0.\n"
+          "  -rd-himem          Back the RAM disk with reserved high memory.\n"
+          "  -journal-crash     Power off without checkpointing the journal.\n"
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -rusage            Print resource usage of exiting processes.\n"
 #endif
   );
   shutdown_power_off ();
@@ -36,18 +36,38 @@ struct pool
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Pages at the top of RAM withheld from both pools. */
+static size_t reserved_pages;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
 
+/* Withholds PAGE_CNT pages at the top of RAM from the page
+   allocator, for a user such as a RAM disk that wants a large
+   contiguous region without draining the pools.  Returns the
+   region's kernel virtual address.  Must be called before
+   palloc_init(). */
+void *
+palloc_reserve_high (size_t page_cnt)
+{
+  size_t free_pages = init_ram_pages - (1024 * 1024) / PGSIZE;
+
+  if (reserved_pages + page_cnt > free_pages / 2)
+    PANIC ("cannot reserve %zu pages of %zu free", page_cnt, free_pages);
+  reserved_pages += page_cnt;
+  return ptov ((init_ram_pages - reserved_pages) * PGSIZE);
+}
+
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
 void
 palloc_init (size_t user_page_limit)
 {
-  /* Free memory starts at 1 MB and runs to the end of RAM. */
+  /* Free memory starts at 1 MB and runs to the end of RAM, less
+     any reserved pages. */
   uint8_t *free_start = ptov (1024 * 1024);
-  uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
+  uint8_t *free_end = ptov ((init_ram_pages - reserved_pages) * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
   size_t user_pages = free_pages / 2;
   size_t kernel_pages;
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <rusage.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
@@ -189,12 +190,14 @@ threads_ready (void)
   return cnt;
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Called by the timer interrupt handler at each timer tick, with
+   USER true if the tick interrupted user code.  Thus, this
+   function runs in an external interrupt context. */
 void
-thread_tick (void) 
+thread_tick (bool user) 
 {
   struct thread *t = thread_current ();
+  struct rusage *ru = thread_rusage ();
 
   /* Update statistics. */
   if (t == idle_thread)
@@ -206,6 +209,13 @@ thread_tick (void)
   else {
     kernel_ticks++;
   }
+  if (ru != NULL)
+    {
+      if (user)
+        ru->user_ticks++;
+      else
+        ru->kernel_ticks++;
+    }
 
   if (thread_mlfqs)
   {
@@ -239,6 +249,18 @@ thread_print_stats (void)
           idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Returns the resource usage counters to charge for the running
+   thread's work, or a null pointer if it is not a user thread. */
+struct rusage *
+thread_rusage (void)
+{
+#ifdef USERPROG
+  return thread_current ()->rusage;
+#else
+  return NULL;
+#endif
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -324,9 +346,13 @@ thread_create (const char *name, int priority,
 void
 thread_block (void) 
 {
+  struct rusage *ru = thread_rusage ();
+
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  if (ru != NULL)
+    ru->voluntary_switches++;
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -414,11 +440,14 @@ void
 thread_yield (void) 
 {
   struct thread *cur = thread_current ();
+  struct rusage *ru = thread_rusage ();
   enum intr_level old_level;
   
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+  if (ru != NULL)
+    ru->involuntary_switches++;
   if (cur != idle_thread)
     list_push_back (&multilevel_queue[cur->effective_priority], &cur->elem);
   cur->status = THREAD_READY;
@@ -714,9 +743,7 @@ init_thread (struct thread *t, const char *name, int priority)
   t->recent_cpu = int_to_fixed_point(0);
   
 #ifdef USERPROG
-  list_init(&t->open_files);
   list_init(&t->child_bonds);
-  list_init(&t->mapped_files);
   t->is_user = false;
 #endif
 
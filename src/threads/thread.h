@@ -3,12 +3,11 @@
 
 #include <debug.h>
 #include <list.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <hash.h>
+#include <idtable.h>
 #include "threads/fixed-point.h"
-#ifdef USERPROG
-#include "vm/page.h"
-#endif
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -29,7 +28,8 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
-struct child_bond;
+struct process;
+struct uthread;
 
 /* A kernel thread or user process.
 
@@ -107,14 +107,21 @@ struct thread
 
 #ifdef USERPROG
    /* Owned by userprog/process.c. */
-   struct list open_files;             /* List of files open. */
-   struct child_bond *child_bond;      /* Pointer to personal bond. */
+   struct process *process;            /* Process, shared by its threads. */
+   struct uthread *uthread;            /* This thread's record in it. */
    struct list child_bonds;            /* List of children's bonds. */
-   struct file *exec_file;             /* Current executable file. */
-   struct page_table page_table;       /* Supplemental page table. */
-   struct list mapped_files;           /* List of memory mapped files. */
    void *esp;                          /* User stack pointer. */
    bool is_user;                       /* User process flag. */
+   struct rusage *rusage;              /* Usage counters to charge, in
+                                          UTHREAD, or null. */
+#endif
+
+#ifdef FILESYS
+   /* Owned by filesys/journal.c. */
+   int journal_depth;                  /* Nesting of journal handles. */
+   struct list journal_blocks;         /* Sectors logged by the handle. */
+   size_t journal_block_cnt;           /* Number of JOURNAL_BLOCKS. */
+   bool journal_failed;                /* Handle overran its room? */
 #endif
 
   /* Owned by thread.c. */
@@ -137,8 +144,9 @@ void thread_init (void);
 void thread_start (void);
 size_t threads_ready(void);
 
-void thread_tick (void);
+void thread_tick (bool user);
 void thread_print_stats (void);
+struct rusage *thread_rusage (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
@@ -0,0 +1,99 @@
+#include "threads/waitq.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Initializes W as a waiter for the current thread. */
+void
+waiter_init (struct waiter *w)
+{
+  w->thread = thread_current ();
+  w->woken = false;
+  w->blocked = false;
+}
+
+/* Blocks until W is woken, unless it has been woken since it
+   last waited, in which case returns at once.  Must be called by
+   W's thread, not from an interrupt handler. */
+void
+waiter_wait (struct waiter *w)
+{
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+  ASSERT (w->thread == thread_current ());
+
+  old_level = intr_disable ();
+  if (!w->woken)
+    {
+      w->blocked = true;
+      thread_block ();
+    }
+  w->woken = false;
+  intr_set_level (old_level);
+}
+
+/* Wakes W, unblocking its thread if it is waiting.  From an
+   interrupt handler, yields on return if the woken thread has the
+   higher priority, as sema_up() does.
+
+   This function may be called from an interrupt handler. */
+void
+waiter_wake (struct waiter *w)
+{
+  enum intr_level old_level = intr_disable ();
+
+  w->woken = true;
+  if (w->blocked)
+    {
+      w->blocked = false;
+      thread_unblock (w->thread);
+      if (intr_context ()
+          && thread_current ()->effective_priority
+             < w->thread->effective_priority)
+        intr_yield_on_return ();
+    }
+  intr_set_level (old_level);
+}
+
+/* Initializes Q as an empty wait queue. */
+void
+waitq_init (struct waitq *q)
+{
+  list_init (&q->entries);
+}
+
+/* Adds waiter W to Q, using entry E, which must stay put until
+   removed with waitq_remove(). */
+void
+waitq_add (struct waitq *q, struct waitq_entry *e, struct waiter *w)
+{
+  enum intr_level old_level = intr_disable ();
+  e->waiter = w;
+  list_push_back (&q->entries, &e->elem);
+  intr_set_level (old_level);
+}
+
+/* Removes entry E from the wait queue it was added to. */
+void
+waitq_remove (struct waitq_entry *e)
+{
+  enum intr_level old_level = intr_disable ();
+  list_remove (&e->elem);
+  intr_set_level (old_level);
+}
+
+/* Wakes every waiter in Q.
+
+   This function may be called from an interrupt handler. */
+void
+waitq_wake (struct waitq *q)
+{
+  enum intr_level old_level = intr_disable ();
+  struct list_elem *e;
+
+  for (e = list_begin (&q->entries); e != list_end (&q->entries);
+       e = list_next (e))
+    waiter_wake (list_entry (e, struct waitq_entry, elem)->waiter);
+  intr_set_level (old_level);
+}
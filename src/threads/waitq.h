@@ -0,0 +1,50 @@
+#ifndef THREADS_WAITQ_H
+#define THREADS_WAITQ_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Waiting for any of several events at once.
+
+   A thread that wants to wait for several objects sets up a
+   waiter and adds a waitq_entry for it to each object's wait
+   queue.  Whenever an object may have become ready, it wakes all
+   the waiters in its queue, and each woken thread checks all of
+   its objects again.  A wakeup that comes between checking and
+   waiting is not lost: the next waiter_wait() returns at once.
+
+   Unlike semaphores and condition variables, waiters and wait
+   queues may be woken from interrupt handlers, and waking never
+   yields the CPU from a kernel thread. */
+
+/* A thread that waits for events. */
+struct waiter
+  {
+    struct thread *thread;      /* The waiting thread. */
+    bool woken;                 /* Woken since it last waited? */
+    bool blocked;               /* Blocked in waiter_wait()? */
+  };
+
+/* A queue of waiters interested in an object. */
+struct waitq
+  {
+    struct list entries;        /* List of struct waitq_entry. */
+  };
+
+/* A waiter's place in one wait queue. */
+struct waitq_entry
+  {
+    struct list_elem elem;      /* Element in waitq's ENTRIES. */
+    struct waiter *waiter;      /* Waiter to wake. */
+  };
+
+void waiter_init (struct waiter *);
+void waiter_wait (struct waiter *);
+void waiter_wake (struct waiter *);
+
+void waitq_init (struct waitq *);
+void waitq_add (struct waitq *, struct waitq_entry *, struct waiter *);
+void waitq_remove (struct waitq_entry *);
+void waitq_wake (struct waitq *);
+
+#endif /* threads/waitq.h */
@@ -1,7 +1,10 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
+#include <rusage.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
@@ -151,9 +154,9 @@ page_fault (struct intr_frame *f)
 
 #ifdef USERPROG
   struct thread *cur = thread_current ();
-  if (cur->is_user)
+  if (cur->is_user && cur->process != NULL)
     {
-      struct page_table *pt = &cur->page_table;
+      struct page_table *pt = &cur->process->page_table;
       void *page = pg_round_down (fault_addr);
 
       /* Page is not present. */
@@ -173,7 +176,7 @@ page_fault (struct intr_frame *f)
         if (in_stack (page) && esp - MAX_FAULT <= fault_addr)
           is_stack_growth = true;
 
-        if (in_stack (page) && thread_current ()->child_bond == NULL)
+        if (in_stack (page) && cur->process->child_bond == NULL)
           is_stack_growth = true;
 
         /* Handle stack growth. */
@@ -181,6 +184,8 @@ page_fault (struct intr_frame *f)
         {
           if (!create_zero_page (pt, page, true) || !load_page (pt, page))
             thread_exit ();
+          if (thread_rusage () != NULL)
+            thread_rusage ()->stack_faults++;
           return;
         }
       }
@@ -189,13 +194,10 @@ page_fault (struct intr_frame *f)
       if (user)
         thread_exit ();
 
-      /* Kernel Page faults. */
-      if (!user)
-      {
-        f->eip = (void *) f->eax;
-        f->eax = 0xffffffff;
+      /* Kernel page faults on bad user memory, from the user
+         access functions in userprog/uaccess.c. */
+      if (!user && is_user_vaddr (fault_addr) && uaccess_fixup (f))
         return;
-      }
     }
 
 #endif
@@ -0,0 +1,198 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <list.h>
+#include <stdbool.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
+#include "vm/page.h"
+
+/* Futexes.
+
+   A futex is an aligned 32-bit word of user memory.  A thread
+   sleeps on it with futex_wait(), which only sleeps if the word
+   still holds the value the caller saw, and other threads wake it
+   with futex_wake(), so user locks need to enter the kernel only
+   when they are contended.
+
+   Sleeping threads are found by a key naming the word's memory.
+   A word in a SHARED page stays at one kernel address while it is
+   mapped, so that address is its key in every process that maps
+   it.  Any other page may be evicted and come back in a different
+   frame, page cache pages included, so a word in one of them is
+   keyed by its page table and user address instead; only threads
+   of one process wait on such a word. */
+
+/* Number of hash buckets for sleeping threads. */
+#define BUCKET_CNT 64
+
+/* Identifies a futex. */
+struct futex_key
+  {
+    const struct page_table *pt;  /* Page table, or null if ADDR is a
+                                     kernel address. */
+    const void *addr;             /* User or kernel address. */
+  };
+
+/* A thread sleeping on a futex. */
+struct futex_waiter
+  {
+    struct list_elem elem;        /* Element in bucket's list. */
+    struct futex_key key;         /* Futex slept on. */
+    struct process *process;      /* Process of the sleeping thread. */
+    struct semaphore sema;        /* Upped to wake the thread. */
+  };
+
+/* A hash bucket of sleeping threads. */
+struct bucket
+  {
+    struct lock lock;             /* Protects WAITERS. */
+    struct list waiters;          /* Sleeping threads. */
+  };
+
+static struct bucket buckets[BUCKET_CNT];
+
+static bool get_key (const uint32_t *uaddr, struct futex_key *);
+static struct bucket *key_bucket (const struct futex_key *);
+static bool same_key (const struct futex_key *, const struct futex_key *);
+
+/* Initializes the futex buckets. */
+void
+futex_init (void)
+{
+  size_t i;
+
+  for (i = 0; i < BUCKET_CNT; i++)
+    {
+      lock_init (&buckets[i].lock);
+      list_init (&buckets[i].waiters);
+    }
+}
+
+/* Puts the current thread to sleep on the futex at UADDR if it
+   holds VAL, until another thread wakes it with futex_wake() or
+   the process starts exiting.  Returns 0 after sleeping, or -1 if
+   the futex did not hold VAL or UADDR is not a valid futex. */
+int
+futex_wait (const uint32_t *uaddr, uint32_t val)
+{
+  struct futex_waiter w;
+  struct bucket *b;
+  uint32_t cur;
+
+  if (!get_key (uaddr, &w.key))
+    return -1;
+  b = key_bucket (&w.key);
+
+  /* Checking the value and going to sleep under the bucket lock
+     makes them atomic with respect to futex_wake(). */
+  lock_acquire (&b->lock);
+  if (!copy_from_user (&cur, uaddr, sizeof cur) || cur != val
+      || process_exiting ())
+    {
+      lock_release (&b->lock);
+      return -1;
+    }
+  w.process = thread_current ()->process;
+  sema_init (&w.sema, 0);
+  list_push_back (&b->waiters, &w.elem);
+  lock_release (&b->lock);
+
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to CNT threads sleeping on the futex at UADDR.
+   Returns the number woken, or -1 if UADDR is not a valid
+   futex. */
+int
+futex_wake (const uint32_t *uaddr, int cnt)
+{
+  struct futex_key key;
+  struct bucket *b;
+  struct list_elem *e, *next;
+  int woken = 0;
+
+  if (!get_key (uaddr, &key))
+    return -1;
+  b = key_bucket (&key);
+
+  lock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && woken < cnt; e = next)
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+      next = list_next (e);
+      if (same_key (&w->key, &key))
+        {
+          list_remove (e);
+          sema_up (&w->sema);
+          woken++;
+        }
+    }
+  lock_release (&b->lock);
+  return woken;
+}
+
+/* Wakes every thread of PROC sleeping on a futex, because PROC is
+   exiting. */
+void
+futex_wake_process (struct process *proc)
+{
+  size_t i;
+
+  for (i = 0; i < BUCKET_CNT; i++)
+    {
+      struct bucket *b = &buckets[i];
+      struct list_elem *e, *next;
+
+      lock_acquire (&b->lock);
+      for (e = list_begin (&b->waiters); e != list_end (&b->waiters);
+           e = next)
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+          next = list_next (e);
+          if (w->process == proc)
+            {
+              list_remove (e);
+              sema_up (&w->sema);
+            }
+        }
+      lock_release (&b->lock);
+    }
+}
+
+/* Stores the key for the futex at UADDR in *KEY.  Returns false
+   if UADDR is not aligned or cannot be read. */
+static bool
+get_key (const uint32_t *uaddr, struct futex_key *key)
+{
+  struct page_table *pt = &thread_current ()->process->page_table;
+  uint32_t val;
+  void *kaddr;
+
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0
+      || !copy_from_user (&val, uaddr, sizeof val))
+    return false;
+
+  kaddr = shared_kaddr (pt, uaddr);
+  key->pt = kaddr != NULL ? NULL : pt;
+  key->addr = kaddr != NULL ? kaddr : (const void *) uaddr;
+  return true;
+}
+
+/* Returns the bucket for KEY. */
+static struct bucket *
+key_bucket (const struct futex_key *key)
+{
+  uintptr_t h = ((uintptr_t) key->addr >> 2) ^ ((uintptr_t) key->pt >> 4);
+  return &buckets[h % BUCKET_CNT];
+}
+
+/* Returns true if A and B name the same futex. */
+static bool
+same_key (const struct futex_key *a, const struct futex_key *b)
+{
+  return a->pt == b->pt && a->addr == b->addr;
+}
@@ -0,0 +1,13 @@
+#ifndef USERPROG_FUTEX_H
+#define USERPROG_FUTEX_H
+
+#include <stdint.h>
+
+struct process;
+
+void futex_init (void);
+int futex_wait (const uint32_t *uaddr, uint32_t val);
+int futex_wake (const uint32_t *uaddr, int cnt);
+void futex_wake_process (struct process *);
+
+#endif /* userprog/futex.h */
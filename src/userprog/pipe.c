@@ -0,0 +1,356 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/waitq.h"
+#include "userprog/process.h"
+
+/* Pages in a pipe's buffer. */
+#define PIPE_PAGES 4
+
+/* Bytes in a pipe's buffer. */
+#define PIPE_SIZE (PIPE_PAGES * PGSIZE)
+
+/* A pipe.
+
+   Data lives in a ring of pages.  HEAD and TAIL count the bytes
+   ever written and read, so HEAD - TAIL bytes are buffered,
+   starting at offset TAIL % PIPE_SIZE.
+
+   Only one reader and one writer work on a pipe at a time, as
+   READING and WRITING say; others wait their turn.  A reader
+   claims the buffered bytes under LOCK but copies them out
+   without holding it, because the copy may page fault or wait for
+   the file system; the writer never touches buffered bytes, so
+   this is safe.  Writers do the same with free space.  Thus LOCK
+   is only ever held briefly, and closing a pipe never waits for a
+   transfer.
+
+   Every change that may let an operation proceed wakes WAITQ,
+   both for poll and for readers and writers waiting on the pipe.
+   These wait on the process exit queue as well, and give up if
+   their process starts exiting. */
+struct pipe
+  {
+    struct lock lock;           /* Protects the members below. */
+    bool reading;               /* A reader is at work. */
+    bool writing;               /* A writer is at work. */
+    size_t head;                /* Bytes written. */
+    size_t tail;                /* Bytes read. */
+    int readers;                /* Open read ends. */
+    int writers;                /* Open write ends. */
+    struct waitq waitq;         /* Waiters on either end. */
+
+    uint8_t *pages[PIPE_PAGES]; /* Buffer. */
+  };
+
+static void pipe_free (struct pipe *);
+static bool readable (const struct pipe *);
+static bool write_idle (const struct pipe *);
+static bool writable (const struct pipe *);
+static bool wait_until (struct pipe *, bool (*ready) (const struct pipe *));
+
+/* Creates and returns a new pipe with one read end and one write
+   end open, or returns a null pointer if memory is short.  The
+   buffer comes from the user pool, so that pipes cannot starve
+   the kernel of memory. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = calloc (1, sizeof *p);
+  size_t i;
+
+  if (p == NULL)
+    return NULL;
+  for (i = 0; i < PIPE_PAGES; i++)
+    {
+      p->pages[i] = palloc_get_page (PAL_USER);
+      if (p->pages[i] == NULL)
+        {
+          pipe_free (p);
+          return NULL;
+        }
+    }
+
+  lock_init (&p->lock);
+  waitq_init (&p->waitq);
+  p->reading = p->writing = false;
+  p->head = p->tail = 0;
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/* Opens another read or write end of pipe P, according to
+   WRITE_END. */
+void
+pipe_reopen (struct pipe *p, bool write_end)
+{
+  lock_acquire (&p->lock);
+  if (write_end)
+    p->writers++;
+  else
+    p->readers++;
+  lock_release (&p->lock);
+}
+
+/* Closes a read or write end of pipe P, according to WRITE_END,
+   and frees P if no ends remain open. */
+void
+pipe_close (struct pipe *p, bool write_end)
+{
+  bool unused;
+
+  lock_acquire (&p->lock);
+  if (write_end)
+    {
+      ASSERT (p->writers > 0);
+      p->writers--;
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      p->readers--;
+    }
+  unused = p->readers == 0 && p->writers == 0;
+  waitq_wake (&p->waitq);
+  lock_release (&p->lock);
+
+  if (unused)
+    pipe_free (p);
+}
+
+/* Frees pipe P and its pages. */
+static void
+pipe_free (struct pipe *p)
+{
+  size_t i;
+
+  for (i = 0; i < PIPE_PAGES; i++)
+    if (p->pages[i] != NULL)
+      palloc_free_page (p->pages[i]);
+  free (p);
+}
+
+/* Returns true if a read from pipe P may start without waiting,
+   because no other reader is at work and P has data or no write
+   end is open.  P's LOCK must be held. */
+static bool
+readable (const struct pipe *p)
+{
+  return !p->reading && (p->head != p->tail || p->writers == 0);
+}
+
+/* Returns true if no writer is at work on pipe P.  P's LOCK must
+   be held. */
+static bool
+write_idle (const struct pipe *p)
+{
+  return !p->writing;
+}
+
+/* Returns true if the writer at work on pipe P may go on without
+   waiting, because P has room or no read end is open.  P's LOCK
+   must be held. */
+static bool
+writable (const struct pipe *p)
+{
+  return p->head - p->tail < PIPE_SIZE || p->readers == 0;
+}
+
+/* Waits, with P's LOCK held on entry and on return but not while
+   sleeping, until READY returns true for pipe P or the current
+   process starts exiting.  Returns the final value of READY. */
+static bool
+wait_until (struct pipe *p, bool (*ready) (const struct pipe *))
+{
+  struct waiter waiter;
+  struct waitq_entry on_pipe, on_exit;
+  bool is_ready;
+
+  waiter_init (&waiter);
+  waitq_add (&p->waitq, &on_pipe, &waiter);
+  waitq_add (process_exit_waitq (), &on_exit, &waiter);
+  while (!(is_ready = ready (p)) && !process_exiting ())
+    {
+      lock_release (&p->lock);
+      waiter_wait (&waiter);
+      lock_acquire (&p->lock);
+    }
+  waitq_remove (&on_exit);
+  waitq_remove (&on_pipe);
+  return is_ready;
+}
+
+/* Reads up to SIZE bytes from pipe P, handing them to XFER along
+   with AUX.  Unless WAIT is PIPE_NOWAIT, waits until P has data
+   or no write end is open.  Returns the number of bytes read,
+   which is 0 at end of file, or -1 if XFER fails before reading
+   anything, nothing could be read without waiting, or the
+   process started exiting while waiting. */
+int
+pipe_read (struct pipe *p, size_t size, enum pipe_wait wait,
+           pipe_xfer_func *xfer, void *aux)
+{
+  size_t done = 0;
+  bool error = false;
+
+  ASSERT (wait != PIPE_WAIT_ALL);
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  if (!readable (p) && (wait == PIPE_NOWAIT || !wait_until (p, readable)))
+    {
+      lock_release (&p->lock);
+      return -1;
+    }
+  p->reading = true;
+  if (size > p->head - p->tail)
+    size = p->head - p->tail;
+  lock_release (&p->lock);
+
+  while (done < size)
+    {
+      size_t ofs = (p->tail + done) % PIPE_SIZE;
+      size_t page_left = PGSIZE - ofs % PGSIZE;
+      size_t chunk = size - done < page_left ? size - done : page_left;
+      int n = xfer (p->pages[ofs / PGSIZE] + ofs % PGSIZE, chunk, aux);
+      if (n < 0)
+        {
+          error = true;
+          break;
+        }
+      done += n;
+      if ((size_t) n < chunk)
+        break;
+    }
+
+  lock_acquire (&p->lock);
+  p->tail += done;
+  p->reading = false;
+  waitq_wake (&p->waitq);
+  lock_release (&p->lock);
+
+  return done == 0 && error ? -1 : (int) done;
+}
+
+/* Writes up to SIZE bytes to pipe P, taking them from XFER along
+   with AUX.  If WAIT is PIPE_WAIT_ALL, waits for room for all
+   SIZE bytes a bit at a time; if PIPE_WAIT_SOME, waits only until
+   some can be written and writes as much as fits; if PIPE_NOWAIT,
+   writes as much as fits without waiting.  Stops early if XFER
+   reaches the end of its data.  Returns the number of bytes
+   written, or -1 if no read end is open, XFER fails before
+   writing anything, nothing could be written without waiting, or
+   the process started exiting while waiting. */
+int
+pipe_write (struct pipe *p, size_t size, enum pipe_wait wait,
+            pipe_xfer_func *xfer, void *aux)
+{
+  bool all = wait == PIPE_WAIT_ALL;
+  size_t done = 0;
+  bool error = false;
+
+  lock_acquire (&p->lock);
+  if (!write_idle (p)
+      && (wait == PIPE_NOWAIT || !wait_until (p, write_idle)))
+    {
+      lock_release (&p->lock);
+      return -1;
+    }
+  p->writing = true;
+  lock_release (&p->lock);
+
+  while (done < size && !error)
+    {
+      size_t space, batch, moved;
+
+      lock_acquire (&p->lock);
+      if (!writable (p) && wait != PIPE_NOWAIT)
+        wait_until (p, writable);
+      if (p->readers == 0 || p->head - p->tail == PIPE_SIZE)
+        {
+          lock_release (&p->lock);
+          error = true;
+          break;
+        }
+      space = PIPE_SIZE - (p->head - p->tail);
+      lock_release (&p->lock);
+
+      batch = size - done < space ? size - done : space;
+      for (moved = 0; moved < batch; )
+        {
+          size_t ofs = (p->head + moved) % PIPE_SIZE;
+          size_t page_left = PGSIZE - ofs % PGSIZE;
+          size_t chunk = batch - moved < page_left ? batch - moved : page_left;
+          int n = xfer (p->pages[ofs / PGSIZE] + ofs % PGSIZE, chunk, aux);
+          if (n < 0)
+            {
+              error = true;
+              break;
+            }
+          moved += n;
+          if ((size_t) n < chunk)
+            {
+              all = false;
+              break;
+            }
+        }
+
+      if (moved > 0)
+        {
+          lock_acquire (&p->lock);
+          p->head += moved;
+          waitq_wake (&p->waitq);
+          lock_release (&p->lock);
+          done += moved;
+        }
+      if (!all)
+        break;
+    }
+
+  lock_acquire (&p->lock);
+  p->writing = false;
+  waitq_wake (&p->waitq);
+  lock_release (&p->lock);
+
+  return done == 0 && error ? -1 : (int) done;
+}
+
+/* Returns the poll events, as defined in lib/poll.h, in effect
+   for the read or write end of pipe P, according to WRITE_END. */
+int
+pipe_poll (struct pipe *p, bool write_end)
+{
+  int events = 0;
+
+  lock_acquire (&p->lock);
+  if (write_end)
+    {
+      if (p->readers == 0)
+        events |= POLLERR;
+      else if (p->head - p->tail < PIPE_SIZE)
+        events |= POLLOUT;
+    }
+  else
+    {
+      if (p->head != p->tail)
+        events |= POLLIN;
+      if (p->writers == 0)
+        events |= POLLHUP;
+    }
+  lock_release (&p->lock);
+  return events;
+}
+
+/* Returns the queue of waiters to wake when either end of pipe P
+   may have become ready. */
+struct waitq *
+pipe_waitq (struct pipe *p)
+{
+  return &p->waitq;
+}
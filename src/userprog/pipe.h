@@ -0,0 +1,38 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct pipe;
+struct waitq;
+
+/* How long pipe_read() and pipe_write() wait. */
+enum pipe_wait
+  {
+    PIPE_NOWAIT,                /* Not at all: fail if no bytes can
+                                   move right away. */
+    PIPE_WAIT_SOME,             /* Until some bytes can move. */
+    PIPE_WAIT_ALL               /* Until all bytes have moved, a bit
+                                   at a time (pipe_write() only). */
+  };
+
+/* Moves up to SIZE bytes between pipe buffer memory at KADDR and
+   wherever AUX says, in the direction of the pipe operation.
+   Returns the number of bytes moved, which is less than SIZE only
+   at the end of the data, or -1 on error. */
+typedef int pipe_xfer_func (void *kaddr, size_t size, void *aux);
+
+struct pipe *pipe_create (void);
+void pipe_close (struct pipe *, bool write_end);
+void pipe_reopen (struct pipe *, bool write_end);
+
+int pipe_read (struct pipe *, size_t size, enum pipe_wait,
+               pipe_xfer_func *, void *aux);
+int pipe_write (struct pipe *, size_t size, enum pipe_wait,
+                pipe_xfer_func *, void *aux);
+
+int pipe_poll (struct pipe *, bool write_end);
+struct waitq *pipe_waitq (struct pipe *);
+
+#endif /* userprog/pipe.h */
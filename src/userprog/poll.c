@@ -0,0 +1,136 @@
+#include "userprog/poll.h"
+#include <debug.h>
+#include <poll.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "devices/input.h"
+#include "devices/timer.h"
+#include "threads/malloc.h"
+#include "threads/waitq.h"
+#include "userprog/pipe.h"
+#include "userprog/process.h"
+
+/* Polling.
+
+   poll_fds() adds one waiter for the calling thread to the wait
+   queue of every object behind the descriptors it polls: the
+   console input buffer for fd 0 and the pipe for a pipe end.
+   Open files and the console output never make a thread wait, so
+   they are always ready and need no queue.  A timer alarm on the
+   same waiter ends the wait on timeout, and the process exit queue
+   ends it when the process starts exiting.  Each time the waiter
+   is woken, all of the descriptors are checked again. */
+
+/* A descriptor being polled. */
+struct polled_fd
+  {
+    struct fd_entry *entry;     /* Open file entry, if fd > 1. */
+    struct waitq_entry wait;    /* Place in the object's wait queue. */
+    bool queued;                /* Is WAIT in a queue? */
+  };
+
+static int fd_events (int fd, struct fd_entry *);
+
+/* Waits until one of the NFDS descriptors in FDS has one of the
+   events it asks for, TIMEOUT milliseconds pass, or the process
+   starts exiting.  A negative
+   TIMEOUT waits for as long as it takes; 0 does not wait at all.
+   Sets the REVENTS of every member of FDS and returns the number
+   of them with events, which is 0 on timeout, or returns -1 if
+   memory is short. */
+int
+poll_fds (struct pollfd *fds, size_t nfds, int timeout)
+{
+  struct polled_fd *polled = NULL;
+  struct waiter waiter;
+  struct waitq_entry on_exit;
+  struct timer_alarm alarm;
+  int64_t deadline = 0;
+  int ready;
+  size_t i;
+
+  if (nfds > 0)
+    {
+      polled = calloc (nfds, sizeof *polled);
+      if (polled == NULL)
+        return -1;
+    }
+
+  waiter_init (&waiter);
+  waitq_add (process_exit_waitq (), &on_exit, &waiter);
+  for (i = 0; i < nfds; i++)
+    {
+      struct waitq *q = NULL;
+
+      if (fds[i].fd == STDIN_FILENO)
+        q = input_waitq ();
+      else if (fds[i].fd > STDOUT_FILENO)
+        {
+          polled[i].entry = process_get_fd (fds[i].fd);
+          if (polled[i].entry != NULL && polled[i].entry->type != FD_FILE)
+            q = pipe_waitq (polled[i].entry->pipe);
+        }
+      if (q != NULL)
+        {
+          waitq_add (q, &polled[i].wait, &waiter);
+          polled[i].queued = true;
+        }
+    }
+  if (timeout > 0)
+    {
+      deadline = timer_ticks () + DIV_ROUND_UP ((int64_t) timeout * TIMER_FREQ,
+                                                1000);
+      timer_alarm_set (&alarm, deadline, &waiter);
+    }
+
+  for (;;)
+    {
+      ready = 0;
+      for (i = 0; i < nfds; i++)
+        {
+          fds[i].revents = 0;
+          if (fds[i].fd >= 0)
+            fds[i].revents = (fd_events (fds[i].fd, polled[i].entry)
+                              & (fds[i].events | POLLERR | POLLHUP
+                                 | POLLNVAL));
+          if (fds[i].revents != 0)
+            ready++;
+        }
+      if (ready > 0 || timeout == 0
+          || (timeout > 0 && timer_ticks () >= deadline)
+          || process_exiting ())
+        break;
+      waiter_wait (&waiter);
+    }
+
+  if (timeout > 0)
+    timer_alarm_cancel (&alarm);
+  waitq_remove (&on_exit);
+  for (i = 0; i < nfds; i++)
+    {
+      if (polled[i].queued)
+        waitq_remove (&polled[i].wait);
+      if (polled[i].entry != NULL)
+        process_put_fd (polled[i].entry);
+    }
+  free (polled);
+  return ready;
+}
+
+/* Returns the poll events in effect for FD, whose entry in the
+   table of open files is ENTRY, or null if it has none. */
+static int
+fd_events (int fd, struct fd_entry *entry)
+{
+  if (fd == STDIN_FILENO)
+    return input_ready () ? POLLIN : 0;
+  else if (fd == STDOUT_FILENO)
+    return POLLOUT;
+  else if (entry == NULL)
+    return POLLNVAL;
+  else if (entry->type == FD_FILE)
+    return POLLIN | POLLOUT;
+  else
+    return pipe_poll (entry->pipe, entry->type == FD_PIPE_WRITE);
+}
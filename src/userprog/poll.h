@@ -0,0 +1,10 @@
+#ifndef USERPROG_POLL_H
+#define USERPROG_POLL_H
+
+#include <stddef.h>
+
+struct pollfd;
+
+int poll_fds (struct pollfd *, size_t nfds, int timeout);
+
+#endif /* userprog/poll.h */
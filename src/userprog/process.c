@@ -5,12 +5,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vtime.h>
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/pipe.h"
+#include "userprog/ring.h"
 #include "userprog/tss.h"
+#include "userprog/uaccess.h"
+#include "devices/timer.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -19,17 +26,43 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#include "threads/waitq.h"
 #include "vm/frame.h"
+#include "vm/heap.h"
 #include "vm/mmap.h"
 #include "vm/page.h"
+#include "vm/shm.h"
 
 static thread_func start_process NO_RETURN;
-static struct file *load (const char *cmdline, void (**eip) (void), void **esp);
+static thread_func start_thread NO_RETURN;
+static struct process *create_process (void);
+static void free_process (struct process *);
+static void *thread_stack_top (int slot);
+struct exec_info;
+static struct exec_info *get_exec_info (struct file *);
+static void put_exec_info (struct exec_info *);
+static bool load (const struct exec_info *, struct file *,
+                  void (**eip) (void), void **esp);
 static void process_lose_connection(struct child_bond *child_bond);
+static void add_rusage (struct rusage *, const struct rusage *);
+static void print_rusage (const char *name, const struct rusage *);
+static idtable_action_func close_open_file, close_mapped_file, inherit_fd;
+static void close_fds (struct process *);
 
 /* Lock used to restrict access to the file system. */
 struct lock filesystem_lock;
 
+/* Print each process's resource usage when it exits? */
+bool process_print_rusage;
+
+/* Waiters to wake when any process starts exiting, so that its
+   threads sleeping in the kernel notice and leave. */
+static struct waitq exit_waiters = { LIST_INITIALIZER (exit_waiters.entries) };
+
+/* Most pipe ends a process may have open, which bounds the pipe
+   buffer memory it can hold onto. */
+#define PIPE_ENDS_MAX 16
+
 /* Struct used to track return value of child processes. */
 struct child_bond
 {
@@ -37,6 +70,7 @@ struct child_bond
   int exit_status;        /* The return value of the child process, default is -1. */
   struct list_elem elem;  /* List element used in thread->child_bonds list. */
   struct semaphore sema;  /* Semaphore used to wait for the child process. */
+  struct waitq waitq;     /* Woken when the child process exits. */
   int connections;        /* Holds the number of active processes connected to this bond.
                              The bond will be freed when connections becomes 0. */
   struct lock lock;       /* Lock used to control access to the bond. */
@@ -45,10 +79,27 @@ struct child_bond
 /* Struct used to pass parameters required to set up a process. */
 struct process_setup_params
 {
-  struct child_bond *child_bond;
+  struct process *process;        /* The new process. */
+  struct exec_info *exec_info;    /* Headers of its executable. */
   char *cmd_line;
 };
 
+/* Tells inherit_fd() where to put copies of pipe ends, and
+   whether all have been copied so far. */
+struct inherit_params
+{
+  struct process *process;
+  bool success;
+};
+
+/* Struct used to pass a new thread of a process its state. */
+struct thread_setup_params
+{
+  struct process *process;
+  struct uthread *uthread;
+  struct intr_frame if_;  /* Initial user registers. */
+};
+
 /* Locks the file system. */
 void
 acquire_filesystem_lock (void)
@@ -91,103 +142,123 @@ process_lose_connection(struct child_bond *child_bond) {
   lock_release(&child_bond->lock);
 }
 
-/* Passes exit status of process to child_bond struct. */
+/* Passes exit status of process to child_bond struct, unless the
+   process is already exiting. */
 void
 process_set_exit_status(int exit_status) {
-  if (thread_current()->child_bond == NULL) {
+  struct process *proc = thread_current ()->process;
+  if (proc == NULL || proc->child_bond == NULL) {
     return;
   }
-  thread_current()->child_bond->exit_status = exit_status;
+  lock_acquire (&proc->lock);
+  if (!proc->exiting)
+    proc->child_bond->exit_status = exit_status;
+  lock_release (&proc->lock);
 }
 
-/* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
-   before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+/* Starts a new thread running a user program loaded from the
+   file named by the first word of CMD_LINE, which must have been
+   obtained from malloc() and which passes to the new process, or
+   is freed if there is none.  The executable is opened and its headers checked here, once;
+   the open file goes to the new thread, which sets up its
+   address space while we carry on.  If that fails, the child
+   exits with status -1 for process_wait() to report.  Returns
+   the new process's thread id, or TID_ERROR if the executable
+   cannot be opened or the thread cannot be created. */
 tid_t
 process_execute (char *cmd_line) 
 {
-  char *cmd_line_copy = NULL;
-  struct child_bond *child_bond = NULL;
+  struct thread *cur = thread_current ();
   struct process_setup_params *setup_params = NULL;
-
-  /* Make a copy of cmd_line.
-     Otherwise there's a race between the caller and load(). */
-  cmd_line_copy = palloc_get_page (0);
-  if (cmd_line_copy == NULL)
+  struct child_bond *child_bond = NULL;
+  struct exec_info *info = NULL;
+  struct process *proc = NULL;
+  char thread_name[sizeof cur->name];
+  char *program_name = cmd_line + strspn (cmd_line, " ");
+  size_t program_len = strcspn (program_name, " ");
+  char saved;
+  struct file *file;
+  tid_t tid;
+
+  if (program_len == 0)
     goto fail;
-  strlcpy (cmd_line_copy, cmd_line, PGSIZE);
 
-  /* Initialise child_bond struct. */
-  child_bond = (struct child_bond *) malloc(sizeof(struct child_bond));
-  if (child_bond == NULL) 
-  {
+  setup_params = malloc (sizeof *setup_params);
+  child_bond = malloc (sizeof *child_bond);
+  proc = create_process ();
+  if (setup_params == NULL || child_bond == NULL || proc == NULL)
     goto fail;
-  }
+
+  /* The bond starts out connected to both us and the child. */
   child_bond->child_tid = TID_ERROR;
   child_bond->exit_status = -1;
-  list_push_back(&thread_current()->child_bonds, &child_bond->elem);
-  sema_init(&child_bond->sema, 0);
-  child_bond->connections = 1;
-  lock_init(&child_bond->lock);
-
-  /* Create struct containing parameters required to set up a process. */
-  setup_params = (struct process_setup_params *) malloc(sizeof(struct process_setup_params));
-  if (setup_params == NULL) {
-    goto fail;
-  }
-  setup_params->child_bond = child_bond;
-  setup_params->cmd_line = cmd_line_copy;
-
+  sema_init (&child_bond->sema, 0);
+  waitq_init (&child_bond->waitq);
+  child_bond->connections = 2;
+  lock_init (&child_bond->lock);
 
-  /* Where the strtrok_r function will carry on from after getting program name. */
-  char *continue_from;
-
-  /* Using strtok_r to get the command to run. */
-  char *program_name;
-  program_name = strtok_r(cmd_line, " ", &continue_from);
-  if (program_name == NULL) {
-    goto fail;
-  }
+  /* Hand down our pipe ends. */
+  if (cur->process != NULL)
+    {
+      struct inherit_params inherit = { proc, true };
+      lock_acquire (&cur->process->fd_lock);
+      idtable_foreach (&cur->process->open_files, inherit_fd, &inherit);
+      lock_release (&cur->process->fd_lock);
+      if (!inherit.success)
+        goto fail;
+    }
 
-  /* Check that the file exists. */
-  struct file *file = NULL;
-  acquire_filesystem_lock();
+  /* Open the executable and get its headers.  The program name is
+     terminated only while we use it, because the child parses
+     all of CMD_LINE. */
+  saved = program_name[program_len];
+  program_name[program_len] = '\0';
+  strlcpy (thread_name, program_name, sizeof thread_name);
+  acquire_filesystem_lock ();
   file = filesys_open (program_name);
-  if (file == NULL) 
-  {
+  if (file == NULL)
     printf ("load: %s: open failed\n", program_name);
-    goto fail; 
-  }
-  file_close (file);
-  release_filesystem_lock();
-
-  /* Create a new thread to execute FILE_NAME. */
-  tid_t tid = thread_create (program_name, PRI_DEFAULT, start_process, setup_params);
-  if (tid == TID_ERROR)
+  else
+    {
+      proc->exec_file = file;
+      info = get_exec_info (file);
+      if (info == NULL)
+        printf ("load: %s: error loading executable\n", program_name);
+      else
+        file_deny_write (file);
+    }
+  release_filesystem_lock ();
+  program_name[program_len] = saved;
+  if (info == NULL)
     goto fail;
 
-  /* Pause until child has set value of child_bond->tid. */
-  sema_down(&child_bond->sema);
-  if (child_bond->child_tid == TID_ERROR) {
+  proc->child_bond = child_bond;
+  setup_params->process = proc;
+  setup_params->exec_info = info;
+  setup_params->cmd_line = cmd_line;
+  tid = thread_create (thread_name, PRI_DEFAULT, start_process, setup_params);
+  if (tid == TID_ERROR)
     goto fail;
-  }
-
-  palloc_free_page (cmd_line_copy);
-  free(setup_params);
 
+  child_bond->child_tid = tid;
+  list_push_back (&cur->child_bonds, &child_bond->elem);
   return tid;
-fail:
-  if (cmd_line_copy != NULL)
-    palloc_free_page (cmd_line_copy);
-  if (child_bond != NULL)
-  {
-    list_remove (&child_bond->elem);
-    free (child_bond);
-  }
-  if (setup_params != NULL)
-    free (setup_params);
 
+fail:
+  if (info != NULL)
+    {
+      acquire_filesystem_lock ();
+      put_exec_info (info);
+      release_filesystem_lock ();
+    }
+  if (proc != NULL)
+    {
+      free_pt (&proc->page_table);
+      free_process (proc);
+    }
+  free (child_bond);
+  free (setup_params);
+  free (cmd_line);
   return TID_ERROR;
 }
 
@@ -209,17 +280,22 @@ start_process (void *setup_params_v)
 {
   struct thread *curr_thread = thread_current ();
   struct process_setup_params *setup_params = (struct process_setup_params *) setup_params_v;
+  struct process *proc = setup_params->process;
+  struct exec_info *info = setup_params->exec_info;
+  char *cmd_line = setup_params->cmd_line;
   struct intr_frame if_;
   char **argument_values = NULL;
+  bool loaded;
+
+  free (setup_params);
 
   curr_thread->is_user = true;
-  curr_thread->exec_file = NULL;
   curr_thread->esp = NULL;
-  curr_thread->child_bond = NULL;
-
-
-  if(!init_pt (&curr_thread->page_table))
-    goto fail;
+  curr_thread->process = proc;
+  curr_thread->uthread = list_entry (list_front (&proc->threads),
+                                     struct uthread, elem);
+  curr_thread->uthread->tid = curr_thread->tid;
+  curr_thread->rusage = &curr_thread->uthread->rusage;
 
   process_activate ();
 
@@ -228,9 +304,15 @@ start_process (void *setup_params_v)
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
+  loaded = load (info, proc->exec_file, &if_.eip, &if_.esp);
+  acquire_filesystem_lock ();
+  put_exec_info (info);
+  release_filesystem_lock ();
+  if (!loaded)
+    goto fail;
 
   /* Argument values and count. */
-  size_t argument_count = strtok_count (setup_params->cmd_line, " ");
+  size_t argument_count = strtok_count (cmd_line, " ");
   if (argument_count == 0)
     goto fail;
   argument_values = malloc (argument_count * sizeof (char **));
@@ -241,14 +323,11 @@ start_process (void *setup_params_v)
   char *curr_token;
   char *continue_from;
   size_t i = 0;
-  for (curr_token = strtok_r (setup_params->cmd_line, " ", &continue_from); curr_token != NULL;
+  for (curr_token = strtok_r (cmd_line, " ", &continue_from); curr_token != NULL;
        curr_token = strtok_r (NULL, " ", &continue_from), i++)
   {
     ASSERT (i < argument_count);
 
-    if (i == 0 && (curr_thread->exec_file = load (curr_token, &if_.eip, &if_.esp)) == NULL)
-      goto fail;
-
     /* Copy arg onto stack. */
     if (!stack_push (&if_.esp, curr_token, strlen (curr_token) + 1))
       goto fail;
@@ -274,12 +353,7 @@ start_process (void *setup_params_v)
 
   /* Clean up. */
   free (argument_values);
-
-  /* Adjust values of child_bond and wake up parent using semaphore. */
-  curr_thread->child_bond = setup_params->child_bond;
-  curr_thread->child_bond->child_tid = curr_thread->tid;
-  curr_thread->child_bond->connections++;
-  sema_up(&curr_thread->child_bond->sema);
+  free (cmd_line);
 
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
@@ -291,22 +365,307 @@ start_process (void *setup_params_v)
   NOT_REACHED ();
 
 fail:
-  if (argument_values != NULL)
-    free (argument_values);
+  free (argument_values);
+  free (cmd_line);
+  thread_exit ();
+  NOT_REACHED ();
+}
 
-  ASSERT (setup_params->child_bond->child_tid == TID_ERROR);
-  sema_up (&curr_thread->child_bond->sema);
+/* Creates the state of a new process, with an empty page table
+   and a record for its main thread, whose tid the main thread
+   fills in when it starts.  Returns the process, or a null pointer if memory is short. */
+static struct process *
+create_process (void)
+{
+  struct process *proc = calloc (1, sizeof *proc);
+  if (proc == NULL)
+    return NULL;
+  struct uthread *ut = malloc (sizeof *ut);
+  if (ut == NULL || !init_pt (&proc->page_table))
+    {
+      free (ut);
+      free (proc);
+      return NULL;
+    }
 
-  thread_exit ();
+  lock_init (&proc->fd_lock);
+  idtable_init (&proc->open_files, STDOUT_FILENO + 1);
+  lock_init (&proc->lock);
+  idtable_init (&proc->mapped_files, 1);
+  list_init (&proc->shm_maps);
+  list_init (&proc->threads);
+  proc->thread_cnt = 1;
+
+  ut->tid = TID_ERROR;
+  ut->slot = -1;
+  ut->exited = false;
+  ut->joining = false;
+  ut->status = -1;
+  sema_init (&ut->done, 0);
+  memset (&ut->rusage, 0, sizeof ut->rusage);
+  list_push_back (&proc->threads, &ut->elem);
+  return proc;
+}
+
+/* Returns the top of the user stack in stack slot SLOT.  Each
+   slot holds THREAD_STACK_PAGES pages with an unmapped guard page
+   below them, and slots are stacked downward from the bottom of
+   the main thread's stack. */
+static void *
+thread_stack_top (int slot)
+{
+  return (uint8_t *) PHYS_BASE - STACK_LIMIT
+         - slot * (THREAD_STACK_PAGES + 1) * PGSIZE;
+}
+
+/* Starts a new thread in the current process that runs user code
+   at START, which is passed FUNC and AUX as its arguments, on a
+   stack of its own.  Returns the new thread's tid, or TID_ERROR
+   if the process has too many threads or memory is short. */
+tid_t
+process_thread_create (void *start, void *func, void *aux)
+{
+  struct thread *cur = thread_current ();
+  struct process *proc = cur->process;
+  struct page_table *pt = &proc->page_table;
+  struct thread_setup_params *params = NULL;
+  struct uthread *ut = NULL;
+  uint8_t *top, *p;
+  int slot;
+
+  /* Claim a stack slot. */
+  lock_acquire (&proc->lock);
+  for (slot = 0; slot < MAX_THREADS - 1; slot++)
+    if (!(proc->stack_slots & (1u << slot)))
+      break;
+  if (proc->exiting || slot == MAX_THREADS - 1)
+    {
+      lock_release (&proc->lock);
+      return TID_ERROR;
+    }
+  proc->stack_slots |= 1u << slot;
+  proc->thread_cnt++;
+  lock_release (&proc->lock);
+
+  /* Map the stack, which must not collide with the heap or a
+     memory mapping, and push a null return address, FUNC and
+     AUX. */
+  top = thread_stack_top (slot);
+  for (p = top - THREAD_STACK_PAGES * PGSIZE; p < top; p += PGSIZE)
+    if (!available_page (pt, p) || !create_zero_page (pt, p, true))
+      goto fail;
+  void *args[3] = { NULL, func, aux };
+  if (!copy_to_user (top - sizeof args, args, sizeof args))
+    goto fail;
+
+  ut = malloc (sizeof *ut);
+  params = malloc (sizeof *params);
+  if (ut == NULL || params == NULL)
+    goto fail;
+  ut->slot = slot;
+  ut->exited = false;
+  ut->joining = false;
+  ut->status = -1;
+  sema_init (&ut->done, 0);
+  memset (&ut->rusage, 0, sizeof ut->rusage);
+
+  params->process = proc;
+  params->uthread = ut;
+  memset (&params->if_, 0, sizeof params->if_);
+  params->if_.gs = params->if_.fs = params->if_.es = SEL_UDSEG;
+  params->if_.ds = params->if_.ss = SEL_UDSEG;
+  params->if_.cs = SEL_UCSEG;
+  params->if_.eflags = FLAG_IF | FLAG_MBS;
+  params->if_.eip = start;
+  params->if_.esp = top - sizeof args;
+
+  /* The record joins the list only once its tid is known, but
+     the new thread may run and even exit before that. */
+  lock_acquire (&proc->lock);
+  ut->tid = thread_create (cur->name, thread_get_priority (),
+                           start_thread, params);
+  if (ut->tid != TID_ERROR)
+    list_push_back (&proc->threads, &ut->elem);
+  lock_release (&proc->lock);
+  if (ut->tid == TID_ERROR)
+    goto fail;
+  return ut->tid;
+
+ fail:
+  free (params);
+  free (ut);
+  for (p = top - THREAD_STACK_PAGES * PGSIZE; p < top; p += PGSIZE)
+    delete_page (pt, p);
+  lock_acquire (&proc->lock);
+  proc->stack_slots &= ~(1u << slot);
+  proc->thread_cnt--;
+  lock_release (&proc->lock);
+  return TID_ERROR;
+}
+
+/* A thread function that starts a new thread of a process running
+   user code, as set up by process_thread_create(). */
+static void
+start_thread (void *params_)
+{
+  struct thread *cur = thread_current ();
+  struct thread_setup_params *params = params_;
+  struct intr_frame if_ = params->if_;
+
+  cur->is_user = true;
+  cur->esp = NULL;
+  cur->process = params->process;
+  cur->uthread = params->uthread;
+  cur->rusage = &cur->uthread->rusage;
+  free (params);
+  process_activate ();
+
+  if (cur->process->exiting)
+    thread_exit ();
+
+  /* Start the thread as start_process() does. */
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
   NOT_REACHED ();
 }
 
+/* Ends the current thread, leaving STATUS for a thread that joins
+   it.  If it is the process's last thread, the process exits with
+   STATUS. */
+void
+process_thread_exit (int status)
+{
+  struct uthread *ut = thread_current ()->uthread;
+  ut->status = status;
+  ut->exited = true;
+  thread_exit ();
+}
+
+/* Waits for thread TID of the current process to exit and returns
+   the status it passed to process_thread_exit(), or -1 if it was
+   killed.  Returns -1 at once if TID is not a thread of the
+   process, is the current thread, or has already been joined. */
+int
+process_thread_join (tid_t tid)
+{
+  struct thread *cur = thread_current ();
+  struct process *proc = cur->process;
+  struct uthread *ut = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&proc->lock);
+  for (e = list_begin (&proc->threads); e != list_end (&proc->threads);
+       e = list_next (e))
+    {
+      struct uthread *u = list_entry (e, struct uthread, elem);
+      if (u->tid == tid && u != cur->uthread && !u->joining)
+        {
+          ut = u;
+          ut->joining = true;
+          break;
+        }
+    }
+  lock_release (&proc->lock);
+  if (ut == NULL)
+    return -1;
+
+  sema_down (&ut->done);
+  lock_acquire (&proc->lock);
+  list_remove (&ut->elem);
+  lock_release (&proc->lock);
+
+  int status = ut->exited ? ut->status : -1;
+  free (ut);
+  return status;
+}
+
+/* Returns the queue of waiters to wake when a process starts
+   exiting.  A thread that sleeps in the kernel until some event
+   adds itself to this queue too, and gives up waiting once
+   process_exiting() returns true. */
+struct waitq *
+process_exit_waitq (void)
+{
+  return &exit_waiters;
+}
+
+/* Returns true if the current thread belongs to a process that is
+   exiting, in which case it must not return to user mode. */
+bool
+process_exiting (void)
+{
+  struct process *proc = thread_current ()->process;
+  return proc != NULL && proc->exiting;
+}
+
+/* Stores in *USAGE the resource usage of the current thread, if
+   WHO is RUSAGE_THREAD, or of all the threads of its process that
+   have run, if WHO is RUSAGE_SELF.  Returns false if WHO is
+   neither. */
+bool
+process_get_rusage (int who, struct rusage *usage)
+{
+  struct thread *cur = thread_current ();
+  struct process *proc = cur->process;
+  struct list_elem *e;
+
+  if (who == RUSAGE_THREAD)
+    {
+      *usage = cur->uthread->rusage;
+      return true;
+    }
+  if (who != RUSAGE_SELF)
+    return false;
+
+  lock_acquire (&proc->lock);
+  *usage = proc->rusage;
+  for (e = list_begin (&proc->threads); e != list_end (&proc->threads);
+       e = list_next (e))
+    add_rusage (usage, &list_entry (e, struct uthread, elem)->rusage);
+  lock_release (&proc->lock);
+  return true;
+}
+
+/* Adds each counter in SRC to the same one in DST. */
+static void
+add_rusage (struct rusage *dst, const struct rusage *src)
+{
+  unsigned long long *d = (unsigned long long *) dst;
+  const unsigned long long *s = (const unsigned long long *) src;
+  size_t i;
+
+  for (i = 0; i < sizeof *dst / sizeof *d; i++)
+    d[i] += s[i];
+}
+
+/* Prints USAGE, the resource usage of process NAME. */
+static void
+print_rusage (const char *name, const struct rusage *usage)
+{
+  unsigned long long syscalls = 0;
+  size_t i;
+
+  for (i = 0; i < RUSAGE_SYSCALLS; i++)
+    syscalls += usage->syscalls[i];
+  printf ("%s: rusage: %llu user + %llu kernel ticks, "
+          "%llu syscalls, %llu+%llu switches\n",
+          name, usage->user_ticks, usage->kernel_ticks, syscalls,
+          usage->voluntary_switches, usage->involuntary_switches);
+  printf ("%s: rusage: faults %llu zero, %llu file, %llu swap, "
+          "%llu stack; swap %llu in, %llu out; "
+          "sectors %llu read, %llu written\n",
+          name, usage->zero_faults, usage->file_faults,
+          usage->swap_faults, usage->stack_faults, usage->swap_ins,
+          usage->swap_outs, usage->block_reads, usage->block_writes);
+}
+
 /* Waits for thread TID to die and returns its exit status. 
  * If it was terminated by the kernel (i.e. killed due to an exception), 
  * returns -1.  
  * If TID is invalid or if it was not a child of the calling process, or if 
  * process_wait() has already been successfully called for the given TID, 
  * returns -1 immediately, without waiting.
+ * If the calling process starts exiting meanwhile, gives up waiting and
+ * returns -1.
  * 
  * This function will be implemented in task 2.
  * For now, it does nothing. */
@@ -320,9 +679,21 @@ process_wait (tid_t child_tid)
     struct child_bond *bond = list_entry(e, struct child_bond, elem);
     if (bond->child_tid == child_tid)
     {
-      /* Down semaphore with the child bond with the correct tid. 
-         Will continue execution when child terminates and ups semaphore. */
-      sema_down(&bond->sema);
+      /* Wait for the child to up the bond's semaphore, unless our
+         own process starts exiting first. */
+      struct waiter waiter;
+      struct waitq_entry on_child, on_exit;
+      bool exited;
+      waiter_init (&waiter);
+      waitq_add (&bond->waitq, &on_child, &waiter);
+      waitq_add (&exit_waiters, &on_exit, &waiter);
+      while (!(exited = sema_try_down (&bond->sema)) && !process_exiting ())
+        waiter_wait (&waiter);
+      waitq_remove (&on_exit);
+      waitq_remove (&on_child);
+      if (!exited)
+        return -1;
+
       /* The exit status will be set by the child before upping the semaphore. */
       int exit_status = bond->exit_status;
       /* Remove the bond from the parent's list of bonds 
@@ -337,21 +708,38 @@ process_wait (tid_t child_tid)
   return -1;
 }
 
-/* Free the current process's resources. */
+/* Free the current thread's resources, and the process's if it
+   is the last thread to exit.  A thread that exits other than
+   through process_thread_exit() ends the whole process: the other
+   threads exit the next time they would return to user mode. */
 void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
-  free_pt (&cur->page_table);
-
-  /* Write error message to console and break connection with child_bond. */
-  if (cur->child_bond != NULL) {
-    printf("%s: exit(%d)\n", cur->name, cur->child_bond->exit_status);
+  struct process *proc = cur->process;
+  struct uthread *ut = cur->uthread;
+  if (proc == NULL)
+    return;
 
-    sema_up(&cur->child_bond->sema);
-    lock_acquire(&cur->child_bond->lock);
-    process_lose_connection(cur->child_bond);
-  }
+  /* The file system lock is outside the process's locks, so let go
+     of it if we were killed holding it. */
+  if (lock_held_by_current_thread (&filesystem_lock))
+    release_filesystem_lock ();
+
+  lock_acquire (&proc->lock);
+  bool kill = !ut->exited && !proc->exiting;
+  if (kill)
+    proc->exiting = true;
+  lock_release (&proc->lock);
+  if (kill)
+    {
+      /* Wake our other threads wherever they sleep, and let go of
+         our pipe ends now, so that no thread or process waits on
+         us while they finish. */
+      futex_wake_process (proc);
+      waitq_wake (&exit_waiters);
+      close_fds (proc);
+    }
 
   /* Let go of all connections to bonds with children. */
   struct list_elem *next;
@@ -364,36 +752,71 @@ process_exit (void)
       process_lose_connection(child);
     }
 
-  /* Check if filesystem lock is held, if not, acquire the lock. */
-  if (!lock_held_by_current_thread(&filesystem_lock)) {
-    acquire_filesystem_lock ();
-  }
+  /* Free the thread's stack. */
+  if (ut->slot >= 0)
+    {
+      uint8_t *top = thread_stack_top (ut->slot);
+      uint8_t *p;
+      for (p = top - THREAD_STACK_PAGES * PGSIZE; p < top; p += PGSIZE)
+        delete_page (&proc->page_table, p);
+    }
 
-  /* If open files, close and free memory. */ 
-  for (struct list_elem *e = list_begin (&cur->open_files);
-       e != list_end (&cur->open_files); e = next)
-  {
-    struct open_file *entry = list_entry (e, struct open_file, elem);
-    file_close (entry->file);
-    next = list_next (e);
-    free (entry);
-  }
+  /* Once the count drops, the last thread may free the process.
+     Our usage joins that of the other exited threads. */
+  cur->rusage = NULL;
+  lock_acquire (&proc->lock);
+  add_rusage (&proc->rusage, &ut->rusage);
+  memset (&ut->rusage, 0, sizeof ut->rusage);
+  if (ut->slot >= 0)
+    proc->stack_slots &= ~(1u << ut->slot);
+  bool last = --proc->thread_cnt == 0;
+  if (last && !proc->exiting && proc->child_bond != NULL)
+    proc->child_bond->exit_status = ut->status;
+  sema_up (&ut->done);
+  lock_release (&proc->lock);
+  cur->process = NULL;
+  cur->uthread = NULL;
+  if (!last)
+    return;
 
-  /* Close all memory mapped files. */
-  for (struct list_elem *e = list_begin (&cur->mapped_files);
-       e != list_end (&cur->mapped_files); e = next)
-  {
-    struct mapped_file *entry = list_entry (e, struct mapped_file, elem);
-    file_close (entry->file);
-    next = list_next (e);
-    free (entry);
+  free_pt (&proc->page_table);
+  ring_exit (proc);
+  shm_exit (proc);
+
+  /* Write error message to console and break connection with child_bond. */
+  if (proc->child_bond != NULL) {
+    printf("%s: exit(%d)\n", cur->name, proc->child_bond->exit_status);
+    if (process_print_rusage)
+      print_rusage (cur->name, &proc->rusage);
+
+    sema_up(&proc->child_bond->sema);
+    waitq_wake (&proc->child_bond->waitq);
+    lock_acquire(&proc->child_bond->lock);
+    process_lose_connection(proc->child_bond);
   }
 
+  free_process (proc);
+}
+
+/* Closes PROC's files and frees it, along with the records of
+   threads never joined.  Its page table must already be freed. */
+static void
+free_process (struct process *proc)
+{
+  acquire_filesystem_lock ();
 
-  if (cur->exec_file != NULL)
-    file_close (cur->exec_file);
+  /* Close all open files and memory mapped files. */
+  idtable_destroy (&proc->open_files, close_open_file, NULL);
+  idtable_destroy (&proc->mapped_files, close_mapped_file, NULL);
+
+  if (proc->exec_file != NULL)
+    file_close (proc->exec_file);
 
   release_filesystem_lock ();
+
+  while (!list_empty (&proc->threads))
+    free (list_entry (list_pop_front (&proc->threads), struct uthread, elem));
+  free (proc);
 }
 
 
@@ -407,7 +830,10 @@ process_activate (void)
   struct thread *t = thread_current ();
 
   /* Activate thread's page tables. */
-  activate_pt (&t->page_table);
+  if (t->process != NULL)
+    activate_pt (&t->process->page_table);
+  else
+    pagedir_activate (NULL);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -477,49 +903,152 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* Most loadable segments an executable may have. */
+#define MAX_SEGMENTS 16
+
+/* Number of executables whose headers are kept cached. */
+#define EXEC_CACHE_SIZE 8
+
+/* What load() needs from an executable's headers, checked and
+   cached per inode so that launching a program again does not
+   read them again.  The cache holds each inode open, so entries
+   for removed executables are dropped as soon as the removal is
+   seen, to let their sectors be freed. */
+struct exec_info
+  {
+    struct list_elem elem;      /* Element in exec_cache. */
+    struct inode *inode;        /* The executable, held open. */
+    unsigned version;           /* inode_version() when read. */
+    int ref_cnt;                /* References: cache and loads. */
+    Elf32_Addr entry;           /* Entry point. */
+    int seg_cnt;                /* Number of loadable segments. */
+    struct Elf32_Phdr segs[MAX_SEGMENTS]; /* Loadable segments. */
+  };
+
+/* Cached executable headers, most recently used first.
+   Protected by filesystem_lock. */
+static struct list exec_cache = LIST_INITIALIZER (exec_cache);
+static size_t exec_cache_cnt;
+
+static struct exec_info *read_exec_info (struct file *);
 static bool setup_stack (void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
-struct file *
-load (const char *file_name, void (**eip) (void), void **esp) 
+/* Returns the headers of executable FILE, from the cache unless
+   FILE has been written since they were read, with a reference
+   for the caller to drop with put_exec_info().  Returns a null
+   pointer if FILE is not a valid executable or memory is short.
+   The file system lock must be held. */
+static struct exec_info *
+get_exec_info (struct file *file)
 {
-  struct Elf32_Ehdr ehdr;
-  struct file *file = NULL;
-  off_t file_ofs;
-  bool success = false;
-  int i;
+  struct inode *inode = file_get_inode (file);
+  struct exec_info *info = NULL;
+  struct list_elem *e;
 
-  acquire_filesystem_lock ();
+  ASSERT (lock_held_by_current_thread (&filesystem_lock));
 
-  /* Open executable file. */
-  file = filesys_open (file_name);
-  if (file == NULL) 
+  process_forget_removed_execs ();
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+       e = list_next (e))
+    {
+      struct exec_info *cached = list_entry (e, struct exec_info, elem);
+      if (cached->inode == inode)
+        {
+          list_remove (e);
+          exec_cache_cnt--;
+          if (cached->version == inode_version (inode))
+            info = cached;
+          else
+            put_exec_info (cached);
+          break;
+        }
+    }
+  if (info == NULL)
     {
-      printf ("load: %s: open failed\n", file_name);
-      goto done; 
+      info = read_exec_info (file);
+      if (info == NULL)
+        return NULL;
     }
 
-  file_deny_write(file);
+  list_push_front (&exec_cache, &info->elem);
+  if (++exec_cache_cnt > EXEC_CACHE_SIZE)
+    {
+      exec_cache_cnt--;
+      put_exec_info (list_entry (list_pop_back (&exec_cache),
+                                 struct exec_info, elem));
+    }
+  info->ref_cnt++;
+  return info;
+}
+
+/* Drops the cached headers of executables that have been
+   removed, so that their inodes are closed, and their sectors
+   freed, once no process is still loading them.  The file system
+   lock must be held. */
+void
+process_forget_removed_execs (void)
+{
+  struct list_elem *e, *next;
+
+  ASSERT (lock_held_by_current_thread (&filesystem_lock));
+
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache); e = next)
+    {
+      struct exec_info *cached = list_entry (e, struct exec_info, elem);
+      next = list_next (e);
+      if (inode_is_removed (cached->inode))
+        {
+          list_remove (e);
+          exec_cache_cnt--;
+          put_exec_info (cached);
+        }
+    }
+}
+
+/* Drops a reference to INFO, freeing it when none remain.  The
+   file system lock must be held. */
+static void
+put_exec_info (struct exec_info *info)
+{
+  ASSERT (lock_held_by_current_thread (&filesystem_lock));
+
+  if (--info->ref_cnt == 0)
+    {
+      inode_close (info->inode);
+      free (info);
+    }
+}
+
+/* Reads and checks the headers of executable FILE.  Returns them
+   with a reference for the cache, or a null pointer if FILE is
+   not a valid executable or memory is short. */
+static struct exec_info *
+read_exec_info (struct file *file)
+{
+  struct Elf32_Ehdr ehdr;
+  struct exec_info *info;
+  off_t file_ofs;
+  int i;
 
   /* Read and verify executable header. */
-  if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
+  if (file_read_at (file, &ehdr, sizeof ehdr, 0) != sizeof ehdr
       || memcmp (ehdr.e_ident, "\177ELF\1\1\1", 7)
       || ehdr.e_type != 2
       || ehdr.e_machine != 3
       || ehdr.e_version != 1
       || ehdr.e_phentsize != sizeof (struct Elf32_Phdr)
       || ehdr.e_phnum > 1024) 
-    {
-      printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
-    }
+    return NULL;
+
+  info = malloc (sizeof *info);
+  if (info == NULL)
+    return NULL;
+  info->entry = ehdr.e_entry;
+  info->seg_cnt = 0;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -527,12 +1056,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
     {
       struct Elf32_Phdr phdr;
 
-      if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
-      file_seek (file, file_ofs);
-
-      if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+      if (file_ofs < 0 || file_ofs > file_length (file)
+          || file_read_at (file, &phdr, sizeof phdr, file_ofs) != sizeof phdr)
+        goto fail;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -546,56 +1072,82 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          goto fail;
         case PT_LOAD:
-          if (validate_segment (&phdr, file)) 
-            {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
-              uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
-              if (phdr.p_filesz > 0)
-                {
-                  /* Normal segment.
-                     Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
-                }
-              else 
-                {
-                  /* Entirely zero.
-                     Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
-                }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
-            }
-          else
-            goto done;
+          if (!validate_segment (&phdr, file)
+              || info->seg_cnt >= MAX_SEGMENTS)
+            goto fail;
+          info->segs[info->seg_cnt++] = phdr;
           break;
         }
     }
 
+  info->inode = inode_reopen (file_get_inode (file));
+  info->version = inode_version (info->inode);
+  info->ref_cnt = 1;
+  return info;
+
+fail:
+  free (info);
+  return NULL;
+}
+
+/* Loads the executable described by INFO from FILE into the
+   current thread.  Stores the executable's entry point into *EIP
+   and its initial stack pointer into *ESP.  Returns true if
+   successful, false if memory is short. */
+static bool
+load (const struct exec_info *info, struct file *file,
+      void (**eip) (void), void **esp) 
+{
+  uint32_t image_end = 0;
+  int i;
+
+  for (i = 0; i < info->seg_cnt; i++)
+    {
+      const struct Elf32_Phdr *phdr = &info->segs[i];
+      bool writable = (phdr->p_flags & PF_W) != 0;
+      uint32_t file_page = phdr->p_offset & ~PGMASK;
+      uint32_t mem_page = phdr->p_vaddr & ~PGMASK;
+      uint32_t page_offset = phdr->p_vaddr & PGMASK;
+      uint32_t read_bytes, zero_bytes;
+      if (phdr->p_filesz > 0)
+        {
+          /* Normal segment.
+             Read initial part from disk and zero the rest. */
+          read_bytes = page_offset + phdr->p_filesz;
+          zero_bytes = (ROUND_UP (page_offset + phdr->p_memsz, PGSIZE)
+                        - read_bytes);
+        }
+      else 
+        {
+          /* Entirely zero.
+             Don't read anything from disk. */
+          read_bytes = 0;
+          zero_bytes = ROUND_UP (page_offset + phdr->p_memsz, PGSIZE);
+        }
+      if (!load_segment (file, file_page, (void *) mem_page,
+                         read_bytes, zero_bytes, writable))
+        return false;
+      if (mem_page + read_bytes + zero_bytes > image_end)
+        image_end = mem_page + read_bytes + zero_bytes;
+    }
+
   /* Set up stack. */
   if (!setup_stack (esp))
-    goto done;
-
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+    return false;
 
-  success = true;
+  /* The heap starts out empty just past the executable. */
+  heap_init ((void *) image_end);
 
-done:
-  /* We arrive here whether the load is successful or not. */
-  if (!success && file != NULL)
-    file_close (file);
+  /* Map the time page, read-only. */
+  if (!create_shared_page (&thread_current ()->process->page_table,
+                           (void *) VTIME_ADDR, timer_time_page (), false))
+    return false;
 
-  release_filesystem_lock ();
-  return success ? file : NULL;
+  /* Start address. */
+  *eip = (void (*) (void)) info->entry;
+  return true;
 }
 
 /* load() helpers. */
@@ -677,7 +1229,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       
       /* Check if virtual page already allocated */
       struct thread *t = thread_current ();
-      struct page_table *pt = &t->page_table;
+      struct page_table *pt = &t->process->page_table;
 
       bool res = (page_read_bytes == 0) ? 
                 create_zero_page (pt, upage, writable)
@@ -703,74 +1255,241 @@ setup_stack (void **esp)
   return true;
 }
 
-/* Get the open file specified by fd from the current thread's list of open files. */
+/* Returns the entry for fd in the current process's table of
+   open files, or a null pointer if there is none.  The entry
+   stays valid, even if another thread closes fd meanwhile, until
+   the caller releases it with process_put_fd(). */
+struct fd_entry *
+process_get_fd (int fd)
+{
+  struct process *proc = thread_current ()->process;
+  lock_acquire (&proc->fd_lock);
+  struct fd_entry *entry = idtable_lookup (&proc->open_files, fd);
+  if (entry != NULL)
+    {
+      enum intr_level old_level = intr_disable ();
+      entry->ref_cnt++;
+      intr_set_level (old_level);
+    }
+  lock_release (&proc->fd_lock);
+  return entry;
+}
+
+/* Get the open file specified by fd from the current process's table of open files.
+   Returns a null pointer if fd is not open or is not a file.  The caller
+   must hold the filesystem lock, which keeps the file from being closed. */
 struct file* 
 process_get_file(int fd) 
 {
-  struct list *files = &thread_current ()->open_files;
-  for (struct list_elem *e = list_begin (files); e != list_end (files); e = list_next (e))
-  {
-    struct open_file *entry = list_entry (e, struct open_file, elem);
-    if (entry->fd == fd)
-      return entry->file;
-  }
+  struct process *proc = thread_current ()->process;
+  lock_acquire (&proc->fd_lock);
+  struct fd_entry *entry = idtable_lookup (&proc->open_files, fd);
+  struct file *file = entry != NULL && entry->type == FD_FILE ? entry->file : NULL;
+  lock_release (&proc->fd_lock);
+  return file;
+}
 
-  return NULL;
+/* Adds an entry of the given type for FILE or PIPE to the current
+   process's table of open files under the lowest free fd, and
+   returns the fd, or -1 on failure. */
+static int
+add_fd (enum fd_type type, struct file *file, struct pipe *pipe)
+{
+  struct process *proc = thread_current ()->process;
+  struct fd_entry *entry = malloc (sizeof *entry);
+  if (entry == NULL)
+    return -1;
+  entry->type = type;
+  entry->file = file;
+  entry->pipe = pipe;
+  entry->flags = 0;
+  entry->ref_cnt = 1;
+
+  lock_acquire (&proc->fd_lock);
+  int fd = -1;
+  if (type == FD_FILE || proc->pipe_ends < PIPE_ENDS_MAX)
+    fd = idtable_insert (&proc->open_files, entry);
+  if (fd != -1 && type != FD_FILE)
+    proc->pipe_ends++;
+  lock_release (&proc->fd_lock);
+  if (fd == -1)
+    free (entry);
+  return fd;
 }
 
-/* Compare the fd value of two open files. */
-static bool
-compare_files (const struct list_elem *a, const struct list_elem *b,
-               void *aux UNUSED)
+/* Adds FILE to the current process's table of open files under the
+   lowest free fd.  Returns the fd, or -1 on failure, in which
+   case FILE is left open. */
+int
+process_add_file (struct file *file)
 {
-  struct open_file *fa = list_entry (a, struct open_file, elem);
-  struct open_file *fb = list_entry (b, struct open_file, elem);
-  return fa->fd < fb->fd;
+  return add_fd (FD_FILE, file, NULL);
 }
 
-/* Open file with the given filename and add it to current thread's list of open files. */
+/* Open file with the given filename and add it to current process's table of
+   open files under the lowest free fd. */
 int
 process_open_file (const char *file_name)
 {
-  struct open_file *open_file
-      = (struct open_file *) malloc (sizeof (struct open_file));
-  if (open_file == NULL)
-    return -1;
-
   struct file *file = filesys_open (file_name);
   if (file == NULL)
-  {
-    free (open_file);
     return -1;
-  }
 
-  struct list *entries = &thread_current ()->open_files;
-  struct list_elem *max = list_max (entries, compare_files, NULL);
-  int fd = (max == list_end (entries))
-                ? (STDOUT_FILENO + 1)
-                : (list_entry (max, struct open_file, elem)->fd + 1);
-
-  open_file->fd = fd;
-  open_file->file = file;
-  list_push_back (entries, &open_file->elem);
+  int fd = process_add_file (file);
+  if (fd == -1)
+    file_close (file);
   return fd;
 }
 
-/* Close the file specified by fd in the current thread's list of open files. */
+/* Creates a pipe and adds its read and write ends to the current
+   process's table of open files, storing their fds in FDS[0] and
+   FDS[1].  Returns true if successful, false on failure, which
+   includes having PIPE_ENDS_MAX pipe ends open already. */
+bool
+process_open_pipe (int fds[2])
+{
+  struct process *proc = thread_current ()->process;
+  lock_acquire (&proc->fd_lock);
+  bool room = proc->pipe_ends + 2 <= PIPE_ENDS_MAX;
+  lock_release (&proc->fd_lock);
+  if (!room)
+    return false;
+
+  struct pipe *pipe = pipe_create ();
+  if (pipe == NULL)
+    return false;
+
+  fds[0] = add_fd (FD_PIPE_READ, NULL, pipe);
+  if (fds[0] == -1)
+    {
+      pipe_close (pipe, false);
+      pipe_close (pipe, true);
+      return false;
+    }
+  fds[1] = add_fd (FD_PIPE_WRITE, NULL, pipe);
+  if (fds[1] == -1)
+    {
+      process_close_file (fds[0]);
+      pipe_close (pipe, true);
+      return false;
+    }
+  return true;
+}
+
+/* Removes fd from the current process's table of open files and
+   returns its entry, whose reference the caller must release
+   with process_put_fd(), or returns a null pointer if fd is not
+   open. */
+struct fd_entry *
+process_remove_fd (int fd)
+{
+  struct process *proc = thread_current ()->process;
+  lock_acquire (&proc->fd_lock);
+  struct fd_entry *entry = idtable_remove (&proc->open_files, fd);
+  if (entry != NULL && entry->type != FD_FILE)
+    proc->pipe_ends--;
+  lock_release (&proc->fd_lock);
+  return entry;
+}
+
+/* Releases a reference to ENTRY, closing and freeing it when the
+   last one goes.  References may be released by any thread, such
+   as a ring's worker, so the count is updated with interrupts
+   off. */
+void
+process_put_fd (struct fd_entry *entry)
+{
+  enum intr_level old_level = intr_disable ();
+  bool last = --entry->ref_cnt == 0;
+  intr_set_level (old_level);
+  if (!last)
+    return;
+
+  if (entry->type == FD_FILE)
+    {
+      bool held = lock_held_by_current_thread (&filesystem_lock);
+      if (!held)
+        acquire_filesystem_lock ();
+      file_close (entry->file);
+      if (!held)
+        release_filesystem_lock ();
+    }
+  else
+    pipe_close (entry->pipe, entry->type == FD_PIPE_WRITE);
+  free (entry);
+}
+
+/* Close the file specified by fd in the current process's table of open files. */
 void
 process_close_file (int fd)
 {
-  struct list *entries = &thread_current ()->open_files;
-  for (struct list_elem *e = list_begin (entries); e != list_end (entries);
-       e = list_next (e))
+  struct fd_entry *entry = process_remove_fd (fd);
+  if (entry != NULL)
+    process_put_fd (entry);
+}
+
+/* Closes the open files of PROC, which is exiting, leaving its
+   table empty.  The files are closed outside FD_LOCK, because
+   closing may take the file system lock. */
+static void
+close_fds (struct process *proc)
+{
+  struct idtable files;
+
+  lock_acquire (&proc->fd_lock);
+  files = proc->open_files;
+  idtable_init (&proc->open_files, STDOUT_FILENO + 1);
+  proc->pipe_ends = 0;
+  lock_release (&proc->fd_lock);
+  idtable_destroy (&files, close_open_file, NULL);
+}
+
+/* Closes ENTRY, an entry in a process's table of open files,
+   once the process is exiting. */
+static void
+close_open_file (int fd UNUSED, void *entry, void *aux UNUSED)
+{
+  process_put_fd (entry);
+}
+
+/* Adds a copy of ENTRY, an entry in the current process's table
+   of open files, to the table of the process being started under
+   the same fd if it is a pipe end, so that pipes connect the
+   processes of a pipeline.  Other open files are not inherited.
+   AUX is a struct inherit_params, whose SUCCESS is set to false
+   on failure. */
+static void
+inherit_fd (int fd, void *entry_, void *aux)
+{
+  struct fd_entry *entry = entry_;
+  struct inherit_params *params = aux;
+  if (entry->type == FD_FILE || !params->success)
+    return;
+
+  struct fd_entry *copy = malloc (sizeof *copy);
+  if (copy == NULL)
     {
-      struct open_file *entry = list_entry (e, struct open_file, elem);
-      if (entry->fd == fd)
-        {
-          list_remove (&entry->elem);
-          file_close (entry->file);
-          free (entry);
-          return;
-        }
+      params->success = false;
+      return;
+    }
+  *copy = *entry;
+  copy->ref_cnt = 1;
+  if (!idtable_insert_at (&params->process->open_files, fd, copy))
+    {
+      free (copy);
+      params->success = false;
+      return;
     }
+  params->process->pipe_ends++;
+  pipe_reopen (copy->pipe, copy->type == FD_PIPE_WRITE);
+}
+
+/* Closes and frees MAPPED_FILE, an entry in a thread's table of
+   memory mapped files. */
+static void
+close_mapped_file (int mapid UNUSED, void *mapped_file_, void *aux UNUSED)
+{
+  struct mapped_file *mapped_file = mapped_file_;
+  file_close (mapped_file->file);
+  free (mapped_file);
 }
\ No newline at end of file
@@ -1,7 +1,76 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <idtable.h>
+#include <list.h>
+#include <rusage.h>
+#include <stdint.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "vm/page.h"
+
+struct child_bond;
+struct ring_ctx;
+struct waitq;
+
+/* Most threads a process may have running at once, including its
+   main thread. */
+#define MAX_THREADS 32
+
+/* Pages in the user stack of each thread but the main one.  These
+   stacks lie below the main thread's, which may grow to
+   STACK_LIMIT bytes, and do not grow. */
+#define THREAD_STACK_PAGES 32
+
+/* A user process: the state shared by all of its threads.  It is
+   freed by the last of them to exit. */
+struct process
+  {
+    struct page_table page_table;       /* Supplemental page table. */
+    struct file *exec_file;             /* Current executable file. */
+    struct child_bond *child_bond;      /* Pointer to personal bond. */
+
+    struct lock fd_lock;                /* Protects OPEN_FILES. */
+    struct idtable open_files;          /* Open files, by fd. */
+    int pipe_ends;                      /* Pipe ends in OPEN_FILES. */
+    int stdin_flags;                    /* Flags of fd 0, from
+                                           lib/fcntl.h. */
+
+    struct lock lock;                   /* Protects the members below. */
+    struct idtable mapped_files;        /* Memory mapped files, by mapid. */
+    struct ring_ctx *ring;              /* System call ring, if any. */
+    void *heap_start;                   /* Start of heap. */
+    void *heap_brk;                     /* Current break, the end of heap. */
+    struct list shm_maps;               /* Attached shared memory. */
+    struct list threads;                /* User threads not yet joined. */
+    int thread_cnt;                     /* Threads still running. */
+    uint32_t stack_slots;               /* Thread stack slots in use. */
+    bool exiting;                       /* Process is being torn down. */
+    struct rusage rusage;               /* Usage of exited threads. */
+  };
+
+/* A user thread of a process.  The record outlives the thread
+   until another thread joins it or the process exits. */
+struct uthread
+  {
+    struct list_elem elem;              /* Element in process's THREADS. */
+    tid_t tid;                          /* Thread's tid. */
+    int slot;                           /* Stack slot, or -1 for the main
+                                           thread's stack. */
+    bool exited;                        /* Left through process_thread_exit()
+                                           rather than being killed. */
+    bool joining;                       /* Some thread is joining it. */
+    int status;                         /* Status passed to
+                                           process_thread_exit(). */
+    struct semaphore done;              /* Upped when the thread exits. */
+    struct rusage rusage;               /* Usage while running, added to
+                                           the process's and cleared
+                                           when it exits. */
+  };
+
+/* Print each process's resource usage when it exits?
+   Controlled by kernel command-line option "-rusage". */
+extern bool process_print_rusage;
 
 void process_set_exit_status(int exit_status);
 
@@ -9,21 +78,46 @@ tid_t process_execute (char *cmd_line);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
+struct waitq *process_exit_waitq (void);
+bool process_exiting (void);
+bool process_get_rusage (int who, struct rusage *);
+
+tid_t process_thread_create (void *start, void *func, void *aux);
+void process_thread_exit (int status) NO_RETURN;
+int process_thread_join (tid_t);
+
+void process_forget_removed_execs (void);
 
 void init_filesystem_lock (void);
 void acquire_filesystem_lock (void);
 void release_filesystem_lock (void);
 
-/* Element used to add a file to a list of open files. */
-struct open_file
-{
-  struct list_elem elem;  /* List element used in thread->open_files list. */
-  int fd;                 /* File descriptor. */
-  struct file *file;      /* File struct. */
-};
+/* Kinds of open file descriptor. */
+enum fd_type
+  {
+    FD_FILE,                    /* Open file. */
+    FD_PIPE_READ,               /* Read end of a pipe. */
+    FD_PIPE_WRITE               /* Write end of a pipe. */
+  };
+
+/* An entry in a process's table of open files. */
+struct fd_entry
+  {
+    enum fd_type type;          /* Kind of descriptor. */
+    struct file *file;          /* Open file, for FD_FILE. */
+    struct pipe *pipe;          /* Pipe, for pipe ends. */
+    int flags;                  /* Flags from lib/fcntl.h. */
+    int ref_cnt;                /* References, one of them the
+                                   table's while it is open. */
+  };
 
+struct fd_entry *process_get_fd (int fd);
 struct file *process_get_file(int fd);
+int process_add_file (struct file *);
 int process_open_file (const char *file_name);
+bool process_open_pipe (int fds[2]);
+struct fd_entry *process_remove_fd (int fd);
+void process_put_fd (struct fd_entry *);
 void process_close_file (int fd);
 
 #endif /* userprog/process.h */
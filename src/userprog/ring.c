@@ -0,0 +1,550 @@
+#include "userprog/ring.h"
+#include <debug.h>
+#include <fcntl.h>
+#include <list.h>
+#include <ring.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/input.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "threads/waitq.h"
+#include "userprog/process.h"
+#include "userprog/uaccess.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+
+/* Most bytes a single read or write request transfers.  Longer
+   requests complete with a short count, as read() and write()
+   are allowed to. */
+#define MAX_TRANSFER (16 * 1024)
+
+/* A process's ring.
+
+   Requests that may block are carried out in submission order
+   by a worker thread, one per ring.  Everything that touches the
+   process's memory or its file descriptors, including posting
+   completions, is done by the process itself in ring_enter(), so
+   the worker never needs the process's page table. */
+struct ring_ctx
+  {
+    struct ring *ring;          /* Shared ring, at its kernel address. */
+
+    /* Owned by the process, whose threads take turns entering
+       the ring under ENTER_LOCK. */
+    struct lock enter_lock;     /* Serializes ring_enter(). */
+    uint32_t sq_head;           /* Kernel's copy of ring->sq_head. */
+    uint32_t cq_tail;           /* Kernel's copy of ring->cq_tail. */
+    unsigned inflight;          /* Submitted but not yet completed. */
+
+    /* Shared with the worker. */
+    struct lock lock;           /* Protects the members below. */
+    struct condition work;      /* Signaled when PENDING grows or
+                                   DYING becomes true. */
+    struct waitq done_waitq;    /* Woken when DONE grows. */
+    struct list pending;        /* Requests for the worker. */
+    struct list done;           /* Requests ready to complete. */
+    bool dying;                 /* Process has exited, so the
+                                   worker must free the ring.
+                                   Setting it wakes the process
+                                   exit wait queue. */
+  };
+
+/* A submitted request. */
+struct ring_request
+  {
+    struct list_elem elem;      /* Element in PENDING or DONE. */
+    struct ring_sqe sqe;        /* Copy of the submission. */
+    struct file *file;          /* File to read or write, or the
+                                   file opened. */
+    struct fd_entry *fd_entry;  /* Descriptor to close. */
+    off_t offset;               /* Offset to read or write. */
+    void *kbuf;                 /* Kernel copy of data or name. */
+    bool nonblock;              /* Console read must not wait? */
+    int32_t res;                /* Result. */
+  };
+
+static void worker (void *ctx_);
+static void submit (struct ring_ctx *, const struct ring_sqe *);
+static bool prepare (struct ring_request *);
+static bool reopen (struct ring_request *);
+static void execute (struct ring_ctx *, struct ring_request *);
+static int read_input (struct ring_ctx *, uint8_t *buf, unsigned size,
+                       bool nonblock);
+static bool is_dying (struct ring_ctx *);
+static unsigned reap (struct ring_ctx *);
+static void complete (struct ring_ctx *, struct ring_request *);
+static void post (struct ring_ctx *, uint32_t user_data, int32_t res);
+static bool has_room (const struct ring_ctx *);
+static void free_request (struct ring_request *);
+
+/* Maps a new ring for the current process at page-aligned user
+   address UADDR.  A process may have only one ring.  Returns
+   true if successful, false on failure. */
+bool
+ring_setup (void *uaddr)
+{
+  struct process *proc = thread_current ()->process;
+  struct ring_ctx *ctx;
+
+  if (uaddr == NULL || pg_ofs (uaddr) != 0)
+    return false;
+
+  lock_acquire (&proc->lock);
+  if (proc->ring != NULL || !available_page (&proc->page_table, uaddr))
+    goto fail;
+
+  ctx = malloc (sizeof *ctx);
+  if (ctx == NULL)
+    goto fail;
+  ctx->ring = palloc_get_page (PAL_ZERO);
+  if (ctx->ring == NULL)
+    goto free_ctx;
+  lock_init (&ctx->enter_lock);
+  ctx->sq_head = ctx->cq_tail = 0;
+  ctx->inflight = 0;
+  lock_init (&ctx->lock);
+  cond_init (&ctx->work);
+  waitq_init (&ctx->done_waitq);
+  list_init (&ctx->pending);
+  list_init (&ctx->done);
+  ctx->dying = false;
+
+  if (!create_shared_page (&proc->page_table, uaddr, ctx->ring, true))
+    goto free_ring;
+  if (thread_create ("ring", thread_get_priority (), worker, ctx)
+      == TID_ERROR)
+    {
+      delete_page (&proc->page_table, uaddr);
+      goto free_ring;
+    }
+  proc->ring = ctx;
+  lock_release (&proc->lock);
+  return true;
+
+ free_ring:
+  palloc_free_page (ctx->ring);
+ free_ctx:
+  free (ctx);
+ fail:
+  lock_release (&proc->lock);
+  return false;
+}
+
+/* Submits up to TO_SUBMIT entries from the current process's
+   submission queue, then waits until at least MIN_COMPLETE
+   completions have been posted, no requests remain in flight, or
+   the process starts exiting.
+   Submission stops early if the submission queue empties or the
+   completion queue could not hold another result.  Returns the
+   number of entries submitted, or -1 if the process has no
+   ring. */
+int
+ring_enter (unsigned to_submit, unsigned min_complete)
+{
+  struct process *proc = thread_current ()->process;
+  unsigned submitted = 0;
+  unsigned completed;
+
+  lock_acquire (&proc->lock);
+  struct ring_ctx *ctx = proc->ring;
+  lock_release (&proc->lock);
+  if (ctx == NULL)
+    return -1;
+
+  lock_acquire (&ctx->enter_lock);
+  while (submitted < to_submit && has_room (ctx)
+         && ctx->sq_head != ctx->ring->sq_tail)
+    {
+      struct ring_sqe sqe;
+
+      barrier ();
+      sqe = ctx->ring->sq[ctx->sq_head % RING_ENTRIES];
+      ctx->ring->sq_head = ++ctx->sq_head;
+      submit (ctx, &sqe);
+      submitted++;
+    }
+
+  completed = reap (ctx);
+  if (completed < min_complete && ctx->inflight > 0)
+    {
+      struct waiter waiter;
+      struct waitq_entry on_done, on_exit;
+
+      waiter_init (&waiter);
+      waitq_add (&ctx->done_waitq, &on_done, &waiter);
+      waitq_add (process_exit_waitq (), &on_exit, &waiter);
+      while (completed < min_complete && ctx->inflight > 0
+             && !process_exiting ())
+        {
+          unsigned cnt = reap (ctx);
+          if (cnt == 0)
+            waiter_wait (&waiter);
+          completed += cnt;
+        }
+      waitq_remove (&on_exit);
+      waitq_remove (&on_done);
+    }
+  lock_release (&ctx->enter_lock);
+  return submitted;
+}
+
+/* Releases the ring of PROC, whose last thread is exiting, if it
+   has one.  Must be called after the process's page table is
+   gone, because the worker frees the ring's page once it
+   finishes the request it is working on, if any, which a console
+   read does at once.  Requests it has not started are
+   abandoned. */
+void
+ring_exit (struct process *proc)
+{
+  struct ring_ctx *ctx = proc->ring;
+
+  if (ctx == NULL)
+    return;
+  proc->ring = NULL;
+
+  lock_acquire (&ctx->lock);
+  ctx->dying = true;
+  cond_signal (&ctx->work, &ctx->lock);
+  lock_release (&ctx->lock);
+  waitq_wake (process_exit_waitq ());
+}
+
+/* Carries out requests for ring CTX_ until its process exits,
+   then frees it. */
+static void
+worker (void *ctx_)
+{
+  struct ring_ctx *ctx = ctx_;
+
+  lock_acquire (&ctx->lock);
+  for (;;)
+    {
+      struct ring_request *r;
+
+      while (list_empty (&ctx->pending) && !ctx->dying)
+        cond_wait (&ctx->work, &ctx->lock);
+      if (ctx->dying)
+        break;
+
+      r = list_entry (list_pop_front (&ctx->pending),
+                      struct ring_request, elem);
+      lock_release (&ctx->lock);
+      execute (ctx, r);
+      lock_acquire (&ctx->lock);
+      list_push_back (&ctx->done, &r->elem);
+      waitq_wake (&ctx->done_waitq);
+    }
+  lock_release (&ctx->lock);
+
+  while (!list_empty (&ctx->pending))
+    free_request (list_entry (list_pop_front (&ctx->pending),
+                              struct ring_request, elem));
+  while (!list_empty (&ctx->done))
+    free_request (list_entry (list_pop_front (&ctx->done),
+                              struct ring_request, elem));
+  palloc_free_page (ctx->ring);
+  free (ctx);
+}
+
+/* Submits the request in SQE, handing it to the worker if it
+   may block and otherwise finishing it at once. */
+static void
+submit (struct ring_ctx *ctx, const struct ring_sqe *sqe)
+{
+  struct ring_request *r = calloc (1, sizeof *r);
+  if (r == NULL)
+    {
+      post (ctx, sqe->user_data, -1);
+      return;
+    }
+  r->sqe = *sqe;
+  r->res = -1;
+  ctx->inflight++;
+
+  bool needs_worker = prepare (r);
+  lock_acquire (&ctx->lock);
+  if (needs_worker)
+    {
+      list_push_back (&ctx->pending, &r->elem);
+      cond_signal (&ctx->work, &ctx->lock);
+    }
+  else
+    list_push_back (&ctx->done, &r->elem);
+  lock_release (&ctx->lock);
+}
+
+/* Does the part of request R that must run in the process
+   itself.  Returns true if R still needs the worker, false if
+   it is finished, with its result in R->res. */
+static bool
+prepare (struct ring_request *r)
+{
+  struct ring_sqe *sqe = &r->sqe;
+
+  switch (sqe->op)
+    {
+    case RING_NOP:
+      r->res = 0;
+      return false;
+
+    case RING_READ:
+    case RING_WRITE:
+      if (sqe->len == 0)
+        {
+          r->res = 0;
+          return false;
+        }
+      if (sqe->len > MAX_TRANSFER)
+        sqe->len = MAX_TRANSFER;
+      r->kbuf = malloc (sqe->len);
+      if (r->kbuf == NULL)
+        return false;
+      if (sqe->op == RING_WRITE
+          && !copy_from_user (r->kbuf, sqe->buf, sqe->len))
+        return false;
+      if (sqe->fd == (sqe->op == RING_READ ? STDIN_FILENO : STDOUT_FILENO))
+        {
+          r->nonblock = (thread_current ()->process->stdin_flags
+                         & O_NONBLOCK) != 0;
+          return true;
+        }
+      return reopen (r);
+
+    case RING_OPEN:
+      r->kbuf = malloc (PGSIZE);
+      return (r->kbuf != NULL
+              && strncpy_from_user (r->kbuf, sqe->buf, PGSIZE) != -1);
+
+    case RING_CLOSE:
+      r->fd_entry = process_remove_fd (sqe->fd);
+      return r->fd_entry != NULL;
+
+    case RING_MMAP:
+      r->res = mmap (sqe->fd, sqe->buf);
+      return false;
+
+    default:
+      return false;
+    }
+}
+
+/* Gives read or write request R a file of its own, positioned
+   independently of the descriptor's, so that the worker never
+   looks up the descriptor and the process may close or seek it
+   meanwhile.  A request at the current position claims its range
+   now and advances the descriptor past it, so requests behave as
+   if carried out in submission order.  Returns true if
+   successful, false on failure. */
+static bool
+reopen (struct ring_request *r)
+{
+  struct file *file;
+
+  acquire_filesystem_lock ();
+  file = process_get_file (r->sqe.fd);
+  if (file != NULL && (r->sqe.offset >= 0
+                       || r->sqe.offset == RING_CURRENT_POS))
+    r->file = file_reopen (file);
+  if (r->file != NULL)
+    {
+      if (r->sqe.offset == RING_CURRENT_POS)
+        {
+          off_t pos = file_tell (file);
+          off_t end = pos + r->sqe.len;
+          if (r->sqe.op == RING_READ && end > file_length (file))
+            end = pos > file_length (file) ? pos : file_length (file);
+          r->offset = pos;
+          file_seek (file, end);
+        }
+      else
+        r->offset = r->sqe.offset;
+    }
+  release_filesystem_lock ();
+  return r->file != NULL;
+}
+
+/* Carries out the part of request R on CTX that may block.  Runs
+   in the worker. */
+static void
+execute (struct ring_ctx *ctx, struct ring_request *r)
+{
+  switch (r->sqe.op)
+    {
+    case RING_READ:
+      if (r->file == NULL)
+        r->res = read_input (ctx, r->kbuf, r->sqe.len, r->nonblock);
+      else
+        {
+          acquire_filesystem_lock ();
+          r->res = file_read_at (r->file, r->kbuf, r->sqe.len, r->offset);
+          file_close (r->file);
+          release_filesystem_lock ();
+          r->file = NULL;
+        }
+      break;
+
+    case RING_WRITE:
+      if (r->file == NULL)
+        {
+          putbuf (r->kbuf, r->sqe.len);
+          r->res = r->sqe.len;
+        }
+      else
+        {
+          acquire_filesystem_lock ();
+          r->res = file_write_at (r->file, r->kbuf, r->sqe.len, r->offset);
+          file_close (r->file);
+          release_filesystem_lock ();
+          r->file = NULL;
+        }
+      break;
+
+    case RING_OPEN:
+      acquire_filesystem_lock ();
+      r->file = filesys_open (r->kbuf);
+      release_filesystem_lock ();
+      break;
+
+    case RING_CLOSE:
+      acquire_filesystem_lock ();
+      process_put_fd (r->fd_entry);
+      release_filesystem_lock ();
+      r->fd_entry = NULL;
+      r->res = 0;
+      break;
+
+    default:
+      NOT_REACHED ();
+    }
+}
+
+/* Reads up to SIZE bytes of console input into BUF for CTX, as
+   read() does: waits for all SIZE bytes, unless NONBLOCK, in which
+   case takes only the bytes already typed, or CTX's process has
+   exited.  Returns the number of bytes read, or -1 if none could
+   be read without waiting. */
+static int
+read_input (struct ring_ctx *ctx, uint8_t *buf, unsigned size,
+            bool nonblock)
+{
+  struct waiter waiter;
+  struct waitq_entry on_input, on_exit;
+  unsigned i;
+
+  waiter_init (&waiter);
+  waitq_add (input_waitq (), &on_input, &waiter);
+  waitq_add (process_exit_waitq (), &on_exit, &waiter);
+  for (i = 0; i < size; i++)
+    {
+      bool got;
+      while (!(got = input_try_getc (&buf[i])) && !nonblock
+             && !is_dying (ctx))
+        waiter_wait (&waiter);
+      if (!got)
+        break;
+    }
+  waitq_remove (&on_exit);
+  waitq_remove (&on_input);
+  return nonblock && i == 0 ? -1 : (int) i;
+}
+
+/* Returns true if CTX's process has exited. */
+static bool
+is_dying (struct ring_ctx *ctx)
+{
+  lock_acquire (&ctx->lock);
+  bool dying = ctx->dying;
+  lock_release (&ctx->lock);
+  return dying;
+}
+
+/* Completes every request in CTX that is ready, returning the
+   number completed. */
+static unsigned
+reap (struct ring_ctx *ctx)
+{
+  unsigned cnt = 0;
+
+  for (;;)
+    {
+      struct ring_request *r;
+
+      lock_acquire (&ctx->lock);
+      if (list_empty (&ctx->done))
+        {
+          lock_release (&ctx->lock);
+          return cnt;
+        }
+      r = list_entry (list_pop_front (&ctx->done), struct ring_request,
+                      elem);
+      lock_release (&ctx->lock);
+
+      complete (ctx, r);
+      cnt++;
+    }
+}
+
+/* Finishes request R in the process, posts its completion, and
+   frees it. */
+static void
+complete (struct ring_ctx *ctx, struct ring_request *r)
+{
+  if (r->sqe.op == RING_READ && r->res > 0
+      && !copy_to_user (r->sqe.buf, r->kbuf, r->res))
+    r->res = -1;
+  else if (r->sqe.op == RING_OPEN && r->file != NULL)
+    {
+      r->res = process_add_file (r->file);
+      if (r->res != -1)
+        r->file = NULL;
+    }
+
+  post (ctx, r->sqe.user_data, r->res);
+  ctx->inflight--;
+  free_request (r);
+}
+
+/* Appends a completion to CTX's completion queue. */
+static void
+post (struct ring_ctx *ctx, uint32_t user_data, int32_t res)
+{
+  struct ring_cqe *cqe = &ctx->ring->cq[ctx->cq_tail % RING_ENTRIES];
+
+  cqe->user_data = user_data;
+  cqe->res = res;
+  barrier ();
+  ctx->ring->cq_tail = ++ctx->cq_tail;
+}
+
+/* Returns true if CTX's completion queue is sure to have room
+   for the results of every request in flight plus one more. */
+static bool
+has_room (const struct ring_ctx *ctx)
+{
+  uint32_t used = ctx->cq_tail - ctx->ring->cq_head;
+  return used <= RING_ENTRIES && used + ctx->inflight < RING_ENTRIES;
+}
+
+/* Frees request R and anything it still holds. */
+static void
+free_request (struct ring_request *r)
+{
+  if (r->file != NULL || r->fd_entry != NULL)
+    {
+      acquire_filesystem_lock ();
+      if (r->file != NULL)
+        file_close (r->file);
+      if (r->fd_entry != NULL)
+        process_put_fd (r->fd_entry);
+      release_filesystem_lock ();
+    }
+  free (r->kbuf);
+  free (r);
+}
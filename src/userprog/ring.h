@@ -0,0 +1,12 @@
+#ifndef USERPROG_RING_H
+#define USERPROG_RING_H
+
+#include <stdbool.h>
+
+struct process;
+
+bool ring_setup (void *uaddr);
+int ring_enter (unsigned to_submit, unsigned min_complete);
+void ring_exit (struct process *);
+
+#endif /* userprog/ring.h */
@@ -1,22 +1,43 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <inttypes.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <futex.h>
+#include <poll.h>
+#include <rusage.h>
 #include <syscall-nr.h>
+#include <uio.h>
+#include <sysenter.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "threads/waitq.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "devices/shutdown.h"
+#include "userprog/futex.h"
+#include "userprog/pipe.h"
+#include "userprog/poll.h"
 #include "userprog/process.h"
+#include "userprog/ring.h"
+#include "userprog/tss.h"
+#include "userprog/uaccess.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "devices/input.h"
+#include "devices/block.h"
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/heap.h"
 #include "vm/mmap.h"
+#include "vm/shm.h"
 
 typedef void (*sys_call) (struct intr_frame *);
 
+/* Bytes of console output copied out of user memory at a time. */
+#define CONSOLE_CHUNK 256
+
 static void sys_halt (struct intr_frame *f);
 static void sys_exit (struct intr_frame *f);
 static void sys_exec (struct intr_frame *f);
@@ -32,40 +53,120 @@ static void sys_tell (struct intr_frame *f);
 static void sys_close (struct intr_frame *f);
 static void sys_mmap (struct intr_frame *f);
 static void sys_munmap (struct intr_frame *f);
+static void sys_iostat (struct intr_frame *f);
+static void sys_ring_setup (struct intr_frame *f);
+static void sys_ring_enter (struct intr_frame *f);
+static void sys_pread (struct intr_frame *f);
+static void sys_pwrite (struct intr_frame *f);
+static void sys_readv (struct intr_frame *f);
+static void sys_writev (struct intr_frame *f);
+static void sys_pipe (struct intr_frame *f);
+static void sys_splice (struct intr_frame *f);
+static void sys_sbrk (struct intr_frame *f);
+static void sys_madvise (struct intr_frame *f);
+static void sys_thread_create (struct intr_frame *f);
+static void sys_thread_exit (struct intr_frame *f);
+static void sys_thread_join (struct intr_frame *f);
+static void sys_futex (struct intr_frame *f);
+static void sys_shm_create (struct intr_frame *f);
+static void sys_shm_remove (struct intr_frame *f);
+static void sys_shm_attach (struct intr_frame *f);
+static void sys_shm_detach (struct intr_frame *f);
+static void sys_poll (struct intr_frame *f);
+static void sys_fcntl (struct intr_frame *f);
+static void sys_getrusage (struct intr_frame *f);
+static int read_console (void *buffer, unsigned size);
+static void write_console (const void *buffer, size_t size);
+static char *copy_user_string (const char *ustr, size_t size);
+static bool is_pipe_fd (int fd);
+static enum pipe_wait pipe_wait_mode (const struct fd_entry *,
+                                      enum pipe_wait);
+static bool copy_shm_name (char name[SHM_NAME_MAX + 2], const char *uname);
+static int file_xfer (struct file *, const struct iovec *, int iovcnt,
+                      bool write, bool *fault);
+static int file_xfer_at (struct file *, const struct iovec *, int iovcnt,
+                         off_t offset, bool write, bool *fault);
 
-#define NUM_SYS_CALLS 15
-static const sys_call sys_calls[NUM_SYS_CALLS]
-    = { &sys_halt,   &sys_exit, &sys_exec,     &sys_wait, &sys_create,
-        &sys_remove, &sys_open, &sys_filesize, &sys_read, &sys_write,
-        &sys_seek,   &sys_tell, &sys_close,    &sys_mmap, &sys_munmap };
+static pipe_xfer_func xfer_to_user, xfer_from_user, xfer_to_console;
+static pipe_xfer_func xfer_to_file, xfer_from_file;
 
+/* System calls by number.  Unimplemented ones are null. */
+static const sys_call sys_calls[]
+    = { [SYS_HALT] = &sys_halt,       [SYS_EXIT] = &sys_exit,
+        [SYS_EXEC] = &sys_exec,       [SYS_WAIT] = &sys_wait,
+        [SYS_CREATE] = &sys_create,   [SYS_REMOVE] = &sys_remove,
+        [SYS_OPEN] = &sys_open,       [SYS_FILESIZE] = &sys_filesize,
+        [SYS_READ] = &sys_read,       [SYS_WRITE] = &sys_write,
+        [SYS_SEEK] = &sys_seek,       [SYS_TELL] = &sys_tell,
+        [SYS_CLOSE] = &sys_close,     [SYS_MMAP] = &sys_mmap,
+        [SYS_MUNMAP] = &sys_munmap,   [SYS_IOSTAT] = &sys_iostat,
+        [SYS_RING_SETUP] = &sys_ring_setup,
+        [SYS_RING_ENTER] = &sys_ring_enter,
+        [SYS_PREAD] = &sys_pread,     [SYS_PWRITE] = &sys_pwrite,
+        [SYS_READV] = &sys_readv,     [SYS_WRITEV] = &sys_writev,
+        [SYS_PIPE] = &sys_pipe,       [SYS_SPLICE] = &sys_splice,
+        [SYS_SBRK] = &sys_sbrk,       [SYS_MADVISE] = &sys_madvise,
+        [SYS_THREAD_CREATE] = &sys_thread_create,
+        [SYS_THREAD_EXIT] = &sys_thread_exit,
+        [SYS_THREAD_JOIN] = &sys_thread_join,
+        [SYS_FUTEX] = &sys_futex,
+        [SYS_SHM_CREATE] = &sys_shm_create,
+        [SYS_SHM_REMOVE] = &sys_shm_remove,
+        [SYS_SHM_ATTACH] = &sys_shm_attach,
+        [SYS_SHM_DETACH] = &sys_shm_detach,
+        [SYS_POLL] = &sys_poll,       [SYS_FCNTL] = &sys_fcntl,
+        [SYS_GETRUSAGE] = &sys_getrusage };
+#define NUM_SYS_CALLS (sizeof sys_calls / sizeof *sys_calls)
 
-static void syscall_handler (struct intr_frame *f);
-static int get_user (const uint8_t *uaddr);
-static bool put_user (uint8_t *udst, uint8_t byte) UNUSED;
-static bool read_write_user (void *src, void *dst, size_t buf_size);
-static int safe_user_copy (void *src, char *dst, size_t buf_size);
+/* Entry point for SYSENTER, in userprog/sysenter.S. */
+void sysenter_entry (void);
 
 void
 syscall_init (void)
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  futex_init ();
+  shm_init ();
+  ASSERT (NUM_SYS_CALLS <= RUSAGE_SYSCALLS);
+
+  /* Also take system calls through the faster SYSENTER
+     instruction.  sysenter_entry builds a partial frame, so its
+     offsets must match. */
+  ASSERT (offsetof (struct intr_frame, eax) == 28);
+  ASSERT (offsetof (struct intr_frame, eip) == 60);
+  ASSERT (offsetof (struct intr_frame, cs) == 64);
+  ASSERT (offsetof (struct intr_frame, esp) == 72);
+  ASSERT (offsetof (struct intr_frame, ss) == 76);
+  ASSERT (sizeof (struct intr_frame) == 80);
+  if (sysenter_supported ())
+    tss_enable_sysenter (sysenter_entry);
 }
 
-static void
+/* Handles the system call whose number and arguments are on the
+   user stack at F->ESP.  Called for "int $0x30" and, with a
+   partial frame, for SYSENTER. */
+void
 syscall_handler (struct intr_frame *f)
 {
   int syscall_num;
-  if (!read_write_user (f->esp, &syscall_num, sizeof (syscall_num)))
+  if (!copy_from_user (&syscall_num, f->esp, sizeof (syscall_num)))
     thread_exit ();
-  if (syscall_num < 0 || syscall_num >= NUM_SYS_CALLS)
+  if (syscall_num < 0 || (size_t) syscall_num >= NUM_SYS_CALLS
+      || sys_calls[syscall_num] == NULL)
     thread_exit ();
 
   /* Save user stack pointer so that we can deal with stack growth happening
      from within system calls. */
   thread_current ()->esp = f->esp;
 
+  thread_rusage ()->syscalls[syscall_num]++;
   (*sys_calls[syscall_num]) (f);
+
+  /* Another thread may have ended the process meanwhile.
+     Interrupt returns check this in intr_handler(), but SYSENTER
+     returns straight to user mode. */
+  if (process_exiting ())
+    thread_exit ();
 }
 
 static void
@@ -78,7 +179,7 @@ static void
 sys_exit (struct intr_frame *f)
 {
   int status;
-  if (!read_write_user (f->esp + 4, &status, sizeof (status)))
+  if (!copy_from_user (&status, f->esp + 4, sizeof (status)))
     thread_exit ();
 
   process_set_exit_status (status);
@@ -89,27 +190,19 @@ static void
 sys_exec (struct intr_frame *f)
 {
   void *cmd_line;
-  if (!read_write_user (f->esp + 4, &cmd_line, sizeof (cmd_line)))
+  if (!copy_from_user (&cmd_line, f->esp + 4, sizeof (cmd_line)))
     thread_exit ();
 
-  char *cmd_line_copy = palloc_get_page (0);
-  if (cmd_line_copy == NULL)
-    thread_exit ();
-  if (safe_user_copy (cmd_line, cmd_line_copy, PGSIZE) == -1)
-    {
-      palloc_free_page (cmd_line_copy);
-      thread_exit ();
-    }
-
-  f->eax = process_execute (cmd_line_copy);
-  palloc_free_page (cmd_line_copy);
+  /* process_execute() takes the copy and frees it. */
+  char *cmd_line_copy = copy_user_string (cmd_line, PGSIZE);
+  f->eax = cmd_line_copy != NULL ? process_execute (cmd_line_copy) : TID_ERROR;
 }
 
 static void
 sys_wait (struct intr_frame *f)
 {
   pid_t pid;
-  if (!read_write_user (f->esp + 4, &pid, sizeof (pid)))
+  if (!copy_from_user (&pid, f->esp + 4, sizeof (pid)))
     thread_exit ();
 
   f->eax = process_wait (pid);
@@ -120,74 +213,70 @@ sys_create (struct intr_frame *f)
 {
   char *file;
   unsigned initial_size;
-  if (!read_write_user (f->esp + 4, &file, sizeof (file))
-      || !read_write_user (f->esp + 8, &initial_size, sizeof (initial_size)))
+  if (!copy_from_user (&file, f->esp + 4, sizeof (file))
+      || !copy_from_user (&initial_size, f->esp + 8, sizeof (initial_size)))
     thread_exit ();
 
-  char *file_copy = palloc_get_page (0);
+  char *file_copy = copy_user_string (file, PGSIZE);
   if (file_copy == NULL)
-    thread_exit ();
-  if (safe_user_copy (file, file_copy, PGSIZE) == -1)
     {
-      palloc_free_page (file_copy);
-      thread_exit ();
+      f->eax = false;
+      return;
     }
 
   acquire_filesystem_lock ();
-  f->eax = filesys_create (file, initial_size);
+  f->eax = filesys_create (file_copy, initial_size);
   release_filesystem_lock ();
-  palloc_free_page (file_copy);
+  free (file_copy);
 }
 
 static void
 sys_remove (struct intr_frame *f)
 {
   char *file;
-  if (!read_write_user (f->esp + 4, &file, sizeof (file)))
+  if (!copy_from_user (&file, f->esp + 4, sizeof (file)))
     thread_exit ();
 
-  char *file_copy = palloc_get_page (0);
+  char *file_copy = copy_user_string (file, PGSIZE);
   if (file_copy == NULL)
-    thread_exit ();
-  if (safe_user_copy (file, file_copy, PGSIZE) == -1)
     {
-      palloc_free_page (file_copy);
-      thread_exit ();
+      f->eax = false;
+      return;
     }
 
   acquire_filesystem_lock ();
-  f->eax = filesys_remove (file);
+  f->eax = filesys_remove (file_copy);
+  if (f->eax)
+    process_forget_removed_execs ();
   release_filesystem_lock ();
-  palloc_free_page (file_copy);
+  free (file_copy);
 }
 
 static void
 sys_open (struct intr_frame *f)
 {
   char *file;
-  if (!read_write_user (f->esp + 4, &file, sizeof (file)))
+  if (!copy_from_user (&file, f->esp + 4, sizeof (file)))
     thread_exit ();
 
-  char *file_copy = palloc_get_page (0);
+  char *file_copy = copy_user_string (file, PGSIZE);
   if (file_copy == NULL)
-    thread_exit ();
-  if (safe_user_copy (file, file_copy, PGSIZE) == -1)
     {
-      palloc_free_page (file_copy);
-      thread_exit ();
+      f->eax = -1;
+      return;
     }
 
   acquire_filesystem_lock ();
   f->eax = process_open_file (file_copy);
   release_filesystem_lock ();
-  palloc_free_page (file_copy);
+  free (file_copy);
 }
 
 static void
 sys_filesize (struct intr_frame *f)
 {
   int fd;
-  if (!read_write_user (f->esp + 4, &fd, sizeof (fd)))
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd)))
     thread_exit ();
 
   acquire_filesystem_lock ();
@@ -195,7 +284,10 @@ sys_filesize (struct intr_frame *f)
   if (file == NULL)
     {
       release_filesystem_lock ();
-      thread_exit ();
+      if (!is_pipe_fd (fd))
+        thread_exit ();
+      f->eax = -1;
+      return;
     }
   f->eax = file_length (file);
   release_filesystem_lock ();
@@ -207,31 +299,40 @@ sys_read (struct intr_frame *f UNUSED)
   int fd;
   void *buffer;
   unsigned size;
-  if (!read_write_user (f->esp + 4, &fd, sizeof (fd))
-      || !read_write_user (f->esp + 8, &buffer, sizeof (buffer))
-      || !read_write_user (f->esp + 12, &size, sizeof (size)))
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd))
+      || !copy_from_user (&buffer, f->esp + 8, sizeof (buffer))
+      || !copy_from_user (&size, f->esp + 12, sizeof (size)))
     thread_exit ();
 
-  if (get_user (buffer) == -1 || get_user (buffer + size - 1) == -1)
+  if (!check_user_buffer (buffer, size, true))
     thread_exit ();
 
   if (fd == 0)
-    {
-      for (unsigned i = 0; i < size; i++)
-        ((char *) buffer)[i] = input_getc ();
-      f->eax = size;
-    }
+    f->eax = read_console (buffer, size);
   else
     {
-      acquire_filesystem_lock ();
-      struct file *file = process_get_file (fd);
-      if (file == NULL)
+      struct fd_entry *entry = process_get_fd (fd);
+      if (entry != NULL && entry->type == FD_PIPE_READ)
         {
-          release_filesystem_lock ();
+          f->eax = pipe_read (entry->pipe, size,
+                              pipe_wait_mode (entry, PIPE_WAIT_SOME),
+                              xfer_to_user, &buffer);
+          process_put_fd (entry);
+          return;
+        }
+      if (entry == NULL || entry->type != FD_FILE)
+        {
+          if (entry != NULL)
+            process_put_fd (entry);
           thread_exit ();
         }
-      f->eax = file_read (file, buffer, size);
-      release_filesystem_lock ();
+
+      struct iovec iov = { buffer, size };
+      bool fault;
+      f->eax = file_xfer (entry->file, &iov, 1, false, &fault);
+      process_put_fd (entry);
+      if (fault)
+        thread_exit ();
     }
 }
 
@@ -241,31 +342,44 @@ sys_write (struct intr_frame *f)
   int fd;
   void *buffer;
   unsigned size;
-  if (!(read_write_user (f->esp + 4, &fd, sizeof (fd))
-        && read_write_user (f->esp + 8, &buffer, sizeof (buffer))
-        && read_write_user (f->esp + 12, &size, sizeof (size))))
+  if (!(copy_from_user (&fd, f->esp + 4, sizeof (fd))
+        && copy_from_user (&buffer, f->esp + 8, sizeof (buffer))
+        && copy_from_user (&size, f->esp + 12, sizeof (size))))
     thread_exit ();
 
-  if (get_user (buffer) == -1 || get_user (buffer + size - 1) == -1)
+  if (!check_user_buffer (buffer, size, false))
     thread_exit ();
 
   if (fd == 1)
     {
-      putbuf (buffer, size);
+      write_console (buffer, size);
       f->eax = size;
       return;
     }
   else
     {
-      acquire_filesystem_lock ();
-      struct file *file = process_get_file (fd);
-      if (file == NULL)
+      struct fd_entry *entry = process_get_fd (fd);
+      if (entry != NULL && entry->type == FD_PIPE_WRITE)
         {
-          release_filesystem_lock ();
+          f->eax = pipe_write (entry->pipe, size,
+                               pipe_wait_mode (entry, PIPE_WAIT_ALL),
+                               xfer_from_user, &buffer);
+          process_put_fd (entry);
+          return;
+        }
+      if (entry == NULL || entry->type != FD_FILE)
+        {
+          if (entry != NULL)
+            process_put_fd (entry);
           thread_exit ();
         }
-      f->eax = file_write (file, buffer, size);
-      release_filesystem_lock ();
+
+      struct iovec iov = { buffer, size };
+      bool fault;
+      f->eax = file_xfer (entry->file, &iov, 1, true, &fault);
+      process_put_fd (entry);
+      if (fault)
+        thread_exit ();
     }
 }
 
@@ -274,8 +388,8 @@ sys_seek (struct intr_frame *f UNUSED)
 {
   int fd;
   unsigned position;
-  if (!read_write_user (f->esp + 4, &fd, sizeof (fd))
-      || !read_write_user (f->esp + 8, &position, sizeof (position)))
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd))
+      || !copy_from_user (&position, f->esp + 8, sizeof (position)))
     thread_exit ();
 
   acquire_filesystem_lock ();
@@ -283,7 +397,9 @@ sys_seek (struct intr_frame *f UNUSED)
   if (file == NULL)
     {
       release_filesystem_lock ();
-      thread_exit ();
+      if (!is_pipe_fd (fd))
+        thread_exit ();
+      return;
     }
   file_seek (file, position);
   release_filesystem_lock ();
@@ -293,7 +409,7 @@ static void
 sys_tell (struct intr_frame *f UNUSED)
 {
   int fd;
-  if (!read_write_user (f->esp + 4, &fd, sizeof (fd)))
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd)))
     thread_exit ();
 
   acquire_filesystem_lock ();
@@ -301,7 +417,10 @@ sys_tell (struct intr_frame *f UNUSED)
   if (file == NULL)
     {
       release_filesystem_lock ();
-      thread_exit ();
+      if (!is_pipe_fd (fd))
+        thread_exit ();
+      f->eax = -1;
+      return;
     }
   f->eax = file_tell (file);
   release_filesystem_lock ();
@@ -311,7 +430,7 @@ static void
 sys_close (struct intr_frame *f)
 {
   int fd;
-  if (!read_write_user (f->esp + 4, &fd, sizeof (fd)))
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd)))
     thread_exit ();
 
   acquire_filesystem_lock ();
@@ -324,8 +443,8 @@ sys_mmap (struct intr_frame *f)
 {
   int fd;
   void *addr;
-  if (!read_write_user (f->esp + 4, &fd, sizeof (fd))
-      || !read_write_user (f->esp + 8, &addr, sizeof (addr)))
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd))
+      || !copy_from_user (&addr, f->esp + 8, sizeof (addr)))
     thread_exit ();
 
   f->eax = mmap (fd, addr);
@@ -335,61 +454,841 @@ static void
 sys_munmap (struct intr_frame *f)
 {
   mapid_t map_id;
-  if (!read_write_user (f->esp + 4, &map_id, sizeof (map_id)))
+  if (!copy_from_user (&map_id, f->esp + 4, sizeof (map_id)))
     thread_exit ();
 
   munmap (map_id);
 }
 
+static void
+sys_iostat (struct intr_frame *f)
+{
+  int idx;
+  void *st_user;
+  struct iostat st;
+  if (!copy_from_user (&idx, f->esp + 4, sizeof (idx))
+      || !copy_from_user (&st_user, f->esp + 8, sizeof (st_user)))
+    thread_exit ();
+
+  if (!block_get_stats (idx, &st))
+    {
+      f->eax = false;
+      return;
+    }
+  if (!copy_to_user (st_user, &st, sizeof st))
+    thread_exit ();
+  f->eax = true;
+}
+
+static void
+sys_ring_setup (struct intr_frame *f)
+{
+  void *addr;
+  if (!copy_from_user (&addr, f->esp + 4, sizeof (addr)))
+    thread_exit ();
+
+  f->eax = ring_setup (addr);
+}
+
+static void
+sys_ring_enter (struct intr_frame *f)
+{
+  unsigned to_submit, min_complete;
+  if (!copy_from_user (&to_submit, f->esp + 4, sizeof (to_submit))
+      || !copy_from_user (&min_complete, f->esp + 8, sizeof (min_complete)))
+    thread_exit ();
+
+  f->eax = ring_enter (to_submit, min_complete);
+}
+
+static void
+sys_pread (struct intr_frame *f)
+{
+  int fd;
+  void *buffer;
+  unsigned size;
+  int offset;
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd))
+      || !copy_from_user (&buffer, f->esp + 8, sizeof (buffer))
+      || !copy_from_user (&size, f->esp + 12, sizeof (size))
+      || !copy_from_user (&offset, f->esp + 16, sizeof (offset)))
+    thread_exit ();
+
+  if (!check_user_buffer (buffer, size, true))
+    thread_exit ();
+  if (offset < 0)
+    {
+      f->eax = -1;
+      return;
+    }
+
+  struct fd_entry *entry = process_get_fd (fd);
+  if (entry == NULL || entry->type != FD_FILE)
+    {
+      if (entry == NULL)
+        thread_exit ();
+      process_put_fd (entry);
+      f->eax = -1;
+      return;
+    }
+
+  struct iovec iov = { (void *) buffer, size };
+  bool fault;
+  f->eax = file_xfer_at (entry->file, &iov, 1, offset, false, &fault);
+  process_put_fd (entry);
+  if (fault)
+    thread_exit ();
+}
+
+static void
+sys_pwrite (struct intr_frame *f)
+{
+  int fd;
+  const void *buffer;
+  unsigned size;
+  int offset;
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd))
+      || !copy_from_user (&buffer, f->esp + 8, sizeof (buffer))
+      || !copy_from_user (&size, f->esp + 12, sizeof (size))
+      || !copy_from_user (&offset, f->esp + 16, sizeof (offset)))
+    thread_exit ();
+
+  if (!check_user_buffer (buffer, size, false))
+    thread_exit ();
+  if (offset < 0)
+    {
+      f->eax = -1;
+      return;
+    }
+
+  struct fd_entry *entry = process_get_fd (fd);
+  if (entry == NULL || entry->type != FD_FILE)
+    {
+      if (entry == NULL)
+        thread_exit ();
+      process_put_fd (entry);
+      f->eax = -1;
+      return;
+    }
+
+  struct iovec iov = { (void *) buffer, size };
+  bool fault;
+  f->eax = file_xfer_at (entry->file, &iov, 1, offset, true, &fault);
+  process_put_fd (entry);
+  if (fault)
+    thread_exit ();
+}
+
+/* Fetches the arguments of readv or writev from F into *FD and
+   IOV, which must have room for IOV_MAX entries, and checks that
+   each buffer may be written if WRITE is true or read otherwise.
+   Returns the number of buffers, or -1 if there are too many or
+   their total length does not fit in an int.  Kills the process
+   if any of its memory is invalid. */
 static int
-get_user (const uint8_t *uaddr)
+get_iovec (struct intr_frame *f, int *fd, struct iovec *iov, bool write)
 {
-  if (!is_user_vaddr (uaddr))
+  const struct iovec *uiov;
+  int iovcnt;
+  if (!copy_from_user (fd, f->esp + 4, sizeof (*fd))
+      || !copy_from_user (&uiov, f->esp + 8, sizeof (uiov))
+      || !copy_from_user (&iovcnt, f->esp + 12, sizeof (iovcnt)))
+    thread_exit ();
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
     return -1;
-  int result;
-  asm("movl $1f, %0; movzbl %1, %0; 1:" : "=&a"(result) : "m"(*uaddr));
-  return result;
+  if (!copy_from_user (iov, uiov, iovcnt * sizeof *iov))
+    thread_exit ();
+
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      if (!check_user_buffer (iov[i].iov_base, iov[i].iov_len, write))
+        thread_exit ();
+      if (iov[i].iov_len > INT32_MAX - total)
+        return -1;
+      total += iov[i].iov_len;
+    }
+  return iovcnt;
 }
 
-static bool
-put_user (uint8_t *udst, uint8_t byte)
+static void
+sys_readv (struct intr_frame *f)
+{
+  int fd;
+  struct iovec iov[IOV_MAX];
+  int iovcnt = get_iovec (f, &fd, iov, true);
+  int total = 0;
+  if (iovcnt == -1)
+    {
+      f->eax = -1;
+      return;
+    }
+
+  struct fd_entry *entry = fd != 0 ? process_get_fd (fd) : NULL;
+  if (fd == 0)
+    {
+      for (int i = 0; i < iovcnt; i++)
+        {
+          int n = read_console (iov[i].iov_base, iov[i].iov_len);
+          if (n < 0)
+            {
+              if (total == 0)
+                total = -1;
+              break;
+            }
+          total += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+    }
+  else if (entry != NULL && entry->type == FD_PIPE_READ)
+    {
+      /* Wait only for data for the first buffer; later buffers
+         take whatever else is there already. */
+      for (int i = 0; i < iovcnt; i++)
+        {
+          uint8_t *base = iov[i].iov_base;
+          enum pipe_wait wait = (i == 0
+                                 ? pipe_wait_mode (entry, PIPE_WAIT_SOME)
+                                 : PIPE_NOWAIT);
+          int n = pipe_read (entry->pipe, iov[i].iov_len, wait,
+                             xfer_to_user, &base);
+          if (n < 0)
+            {
+              if (total == 0)
+                total = -1;
+              break;
+            }
+          total += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+    }
+  else
+    {
+      if (entry == NULL || entry->type != FD_FILE)
+        {
+          if (entry != NULL)
+            process_put_fd (entry);
+          thread_exit ();
+        }
+
+      bool fault;
+      total = file_xfer (entry->file, iov, iovcnt, false, &fault);
+      if (fault)
+        {
+          process_put_fd (entry);
+          thread_exit ();
+        }
+    }
+  if (entry != NULL)
+    process_put_fd (entry);
+  f->eax = total;
+}
+
+static void
+sys_writev (struct intr_frame *f)
+{
+  int fd;
+  struct iovec iov[IOV_MAX];
+  int iovcnt = get_iovec (f, &fd, iov, false);
+  int total = 0;
+  if (iovcnt == -1)
+    {
+      f->eax = -1;
+      return;
+    }
+
+  struct fd_entry *entry = fd != 1 ? process_get_fd (fd) : NULL;
+  if (fd == 1)
+    {
+      for (int i = 0; i < iovcnt; i++)
+        {
+          write_console (iov[i].iov_base, iov[i].iov_len);
+          total += iov[i].iov_len;
+        }
+    }
+  else if (entry != NULL && entry->type == FD_PIPE_WRITE)
+    {
+      for (int i = 0; i < iovcnt; i++)
+        {
+          const uint8_t *base = iov[i].iov_base;
+          int n = pipe_write (entry->pipe, iov[i].iov_len,
+                              pipe_wait_mode (entry, PIPE_WAIT_ALL),
+                              xfer_from_user, &base);
+          if (n < 0)
+            {
+              if (total == 0)
+                total = -1;
+              break;
+            }
+          total += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+    }
+  else
+    {
+      if (entry == NULL || entry->type != FD_FILE)
+        {
+          if (entry != NULL)
+            process_put_fd (entry);
+          thread_exit ();
+        }
+
+      bool fault;
+      total = file_xfer (entry->file, iov, iovcnt, true, &fault);
+      if (fault)
+        {
+          process_put_fd (entry);
+          thread_exit ();
+        }
+    }
+  if (entry != NULL)
+    process_put_fd (entry);
+  f->eax = total;
+}
+
+static void
+sys_pipe (struct intr_frame *f)
+{
+  int *fds_user;
+  int fds[2];
+  if (!copy_from_user (&fds_user, f->esp + 4, sizeof (fds_user)))
+    thread_exit ();
+  if (!check_user_buffer (fds_user, sizeof fds, true))
+    thread_exit ();
+
+  if (!process_open_pipe (fds))
+    {
+      f->eax = false;
+      return;
+    }
+  if (!copy_to_user (fds_user, fds, sizeof fds))
+    thread_exit ();
+  f->eax = true;
+}
+
+/* Moves up to SIZE bytes from the read end of a pipe to an open
+   file or the console, or from an open file to the write end of a
+   pipe, without copying them through user memory.  Waits only
+   until some data can be moved, or not at all if the pipe end is
+   non-blocking. */
+static void
+sys_splice (struct intr_frame *f)
+{
+  int fd_in, fd_out;
+  unsigned size;
+  if (!copy_from_user (&fd_in, f->esp + 4, sizeof (fd_in))
+      || !copy_from_user (&fd_out, f->esp + 8, sizeof (fd_out))
+      || !copy_from_user (&size, f->esp + 12, sizeof (size)))
+    thread_exit ();
+
+  struct fd_entry *in = process_get_fd (fd_in);
+  struct fd_entry *out = process_get_fd (fd_out);
+  if (in != NULL && in->type == FD_PIPE_READ && fd_out == 1)
+    f->eax = pipe_read (in->pipe, size, pipe_wait_mode (in, PIPE_WAIT_SOME),
+                        xfer_to_console, NULL);
+  else if (in != NULL && in->type == FD_PIPE_READ
+           && out != NULL && out->type == FD_FILE)
+    f->eax = pipe_read (in->pipe, size, pipe_wait_mode (in, PIPE_WAIT_SOME),
+                        xfer_to_file, out->file);
+  else if (in != NULL && in->type == FD_FILE
+           && out != NULL && out->type == FD_PIPE_WRITE)
+    f->eax = pipe_write (out->pipe, size, pipe_wait_mode (out, PIPE_WAIT_SOME),
+                         xfer_from_file, in->file);
+  else
+    f->eax = -1;
+
+  if (in != NULL)
+    process_put_fd (in);
+  if (out != NULL)
+    process_put_fd (out);
+}
+
+static void
+sys_sbrk (struct intr_frame *f)
+{
+  intptr_t increment;
+  if (!copy_from_user (&increment, f->esp + 4, sizeof (increment)))
+    thread_exit ();
+
+  f->eax = (uint32_t) heap_sbrk (increment);
+}
+
+static void
+sys_madvise (struct intr_frame *f)
+{
+  void *addr;
+  size_t length;
+  int advice;
+  if (!copy_from_user (&addr, f->esp + 4, sizeof (addr))
+      || !copy_from_user (&length, f->esp + 8, sizeof (length))
+      || !copy_from_user (&advice, f->esp + 12, sizeof (advice)))
+    thread_exit ();
+
+  f->eax = heap_madvise (addr, length, advice);
+}
+
+static void
+sys_thread_create (struct intr_frame *f)
+{
+  void *start, *func, *aux;
+  if (!copy_from_user (&start, f->esp + 4, sizeof (start))
+      || !copy_from_user (&func, f->esp + 8, sizeof (func))
+      || !copy_from_user (&aux, f->esp + 12, sizeof (aux)))
+    thread_exit ();
+
+  f->eax = process_thread_create (start, func, aux);
+}
+
+static void
+sys_thread_exit (struct intr_frame *f)
+{
+  int status;
+  if (!copy_from_user (&status, f->esp + 4, sizeof (status)))
+    thread_exit ();
+
+  process_thread_exit (status);
+}
+
+static void
+sys_thread_join (struct intr_frame *f)
 {
-  if (!is_user_vaddr (udst))
-    return false;
-  int error_code;
-  asm ("movl $1f, %0; movb %b2, %1; 1:"
-       : "=&a"(error_code), "=m"(*udst)
-       : "q"(byte));
-  return error_code != -1;
+  tid_t tid;
+  if (!copy_from_user (&tid, f->esp + 4, sizeof (tid)))
+    thread_exit ();
+
+  f->eax = process_thread_join (tid);
 }
 
+static void
+sys_futex (struct intr_frame *f)
+{
+  uint32_t *addr;
+  int op;
+  uint32_t val;
+  if (!copy_from_user (&addr, f->esp + 4, sizeof (addr))
+      || !copy_from_user (&op, f->esp + 8, sizeof (op))
+      || !copy_from_user (&val, f->esp + 12, sizeof (val)))
+    thread_exit ();
+
+  switch (op)
+    {
+    case FUTEX_WAIT:
+      f->eax = futex_wait (addr, val);
+      break;
+    case FUTEX_WAKE:
+      f->eax = futex_wake (addr, val);
+      break;
+    default:
+      f->eax = -1;
+      break;
+    }
+}
+
+/* Copies the shared memory object name at UNAME into NAME.  A
+   name too long to fit is copied truncated to SHM_NAME_MAX + 1
+   characters, which shm_create() and lookups reject.  Returns
+   false if UNAME is not a valid user string. */
 static bool
-read_write_user (void *src, void *dst, size_t buf_size)
+copy_shm_name (char name[SHM_NAME_MAX + 2], const char *uname)
+{
+  return strncpy_from_user (name, uname, SHM_NAME_MAX + 2) != -1;
+}
+
+static void
+sys_shm_create (struct intr_frame *f)
+{
+  const char *uname;
+  size_t size;
+  char name[SHM_NAME_MAX + 2];
+  if (!copy_from_user (&uname, f->esp + 4, sizeof (uname))
+      || !copy_from_user (&size, f->esp + 8, sizeof (size))
+      || !copy_shm_name (name, uname))
+    thread_exit ();
+
+  f->eax = shm_create (name, size);
+}
+
+static void
+sys_shm_remove (struct intr_frame *f)
+{
+  const char *uname;
+  char name[SHM_NAME_MAX + 2];
+  if (!copy_from_user (&uname, f->esp + 4, sizeof (uname))
+      || !copy_shm_name (name, uname))
+    thread_exit ();
+
+  f->eax = shm_remove (name);
+}
+
+static void
+sys_shm_attach (struct intr_frame *f)
+{
+  const char *uname;
+  void *addr;
+  char name[SHM_NAME_MAX + 2];
+  if (!copy_from_user (&uname, f->esp + 4, sizeof (uname))
+      || !copy_from_user (&addr, f->esp + 8, sizeof (addr))
+      || !copy_shm_name (name, uname))
+    thread_exit ();
+
+  f->eax = (uint32_t) shm_attach (name, addr);
+}
+
+static void
+sys_shm_detach (struct intr_frame *f)
+{
+  void *addr;
+  if (!copy_from_user (&addr, f->esp + 4, sizeof (addr)))
+    thread_exit ();
+
+  f->eax = shm_detach (addr);
+}
+
+/* Waits for events on several descriptors, as poll_fds()
+   describes. */
+static void
+sys_poll (struct intr_frame *f)
 {
-  for (size_t i = 0; i < buf_size; i++)
+  struct pollfd *ufds;
+  unsigned nfds;
+  int timeout;
+  struct pollfd fds[POLL_MAX];
+  if (!copy_from_user (&ufds, f->esp + 4, sizeof (ufds))
+      || !copy_from_user (&nfds, f->esp + 8, sizeof (nfds))
+      || !copy_from_user (&timeout, f->esp + 12, sizeof (timeout)))
+    thread_exit ();
+  if (nfds > POLL_MAX)
     {
-      int value = get_user (src + i);
-      if (value == -1)
-        return false;
-      ((char *) dst)[i] = value & 0xff;
+      f->eax = -1;
+      return;
     }
-  return true;
+
+  if (!copy_from_user (fds, ufds, nfds * sizeof *fds))
+    thread_exit ();
+  f->eax = poll_fds (fds, nfds, timeout);
+  if (!copy_to_user (ufds, fds, nfds * sizeof *fds))
+    thread_exit ();
 }
 
+/* Gets or sets the flags of fd 0 or an open file or pipe end.
+   O_NONBLOCK is the only flag. */
+static void
+sys_fcntl (struct intr_frame *f)
+{
+  int fd, cmd, arg;
+  if (!copy_from_user (&fd, f->esp + 4, sizeof (fd))
+      || !copy_from_user (&cmd, f->esp + 8, sizeof (cmd))
+      || !copy_from_user (&arg, f->esp + 12, sizeof (arg)))
+    thread_exit ();
+
+  struct fd_entry *entry = NULL;
+  int *flags;
+  if (fd == STDIN_FILENO)
+    flags = &thread_current ()->process->stdin_flags;
+  else if (fd > STDOUT_FILENO && (entry = process_get_fd (fd)) != NULL)
+    flags = &entry->flags;
+  else
+    {
+      f->eax = -1;
+      return;
+    }
+
+  if (cmd == F_GETFL)
+    f->eax = *flags;
+  else if (cmd == F_SETFL && (arg & ~O_NONBLOCK) == 0)
+    {
+      *flags = arg;
+      f->eax = 0;
+    }
+  else
+    f->eax = -1;
+
+  if (entry != NULL)
+    process_put_fd (entry);
+}
+
+/* Copies the resource usage of the calling process or thread,
+   as chosen by WHO, to user memory.  Returns false if WHO is not
+   RUSAGE_SELF or RUSAGE_THREAD. */
+static void
+sys_getrusage (struct intr_frame *f)
+{
+  int who;
+  struct rusage *usage_user;
+  struct rusage usage;
+  if (!copy_from_user (&who, f->esp + 4, sizeof (who))
+      || !copy_from_user (&usage_user, f->esp + 8, sizeof (usage_user)))
+    thread_exit ();
+
+  if (!process_get_rusage (who, &usage))
+    {
+      f->eax = false;
+      return;
+    }
+  if (!copy_to_user (usage_user, &usage, sizeof usage))
+    thread_exit ();
+  f->eax = true;
+}
+
+/* Reads up to SIZE bytes of console input into user BUFFER.
+   Waits for all SIZE bytes, unless fd 0 is non-blocking, in which
+   case takes only the bytes already typed, or the process starts
+   exiting.  Keys are gathered in a kernel buffer and copied out a
+   chunk at a time, because another thread may unmap BUFFER while
+   this one waits for input.  Kills the process if BUFFER is
+   invalid.  Returns the number of bytes read, or -1 if none could
+   be read without waiting. */
 static int
-safe_user_copy (void *src, char *dst, size_t buf_size)
+read_console (void *buffer, unsigned size)
 {
-  size_t i = 0;
-  for (; i < buf_size; i++)
+  bool nonblock = thread_current ()->process->stdin_flags & O_NONBLOCK;
+  struct waiter waiter;
+  struct waitq_entry on_input, on_exit;
+  char chunk[CONSOLE_CHUNK];
+  size_t chunk_cnt = 0;
+  bool fault = false;
+  unsigned i;
+
+  waiter_init (&waiter);
+  waitq_add (input_waitq (), &on_input, &waiter);
+  waitq_add (process_exit_waitq (), &on_exit, &waiter);
+  for (i = 0; i < size; i++)
     {
-      int value = get_user (src + i);
-      if (value == -1)
-        return -1;
-      dst[i] = value & 0xff;
-      if (dst[i] == 0)
+      uint8_t key;
+      bool got;
+      while (!(got = input_try_getc (&key)) && !nonblock
+             && !process_exiting ())
+        waiter_wait (&waiter);
+      if (!got)
         break;
+      chunk[chunk_cnt++] = key;
+      if (chunk_cnt == sizeof chunk)
+        {
+          fault = !copy_to_user ((char *) buffer + i + 1 - chunk_cnt,
+                                 chunk, chunk_cnt);
+          chunk_cnt = 0;
+          if (fault)
+            break;
+        }
+    }
+  waitq_remove (&on_exit);
+  waitq_remove (&on_input);
+
+  if (fault || !copy_to_user ((char *) buffer + i - chunk_cnt,
+                              chunk, chunk_cnt))
+    thread_exit ();
+  return nonblock && i == 0 && size > 0 ? -1 : (int) i;
+}
+
+/* Writes SIZE bytes from user BUFFER to the console, a chunk at
+   a time through a kernel buffer.  The console copies its input
+   with interrupts off, so it must never be handed user memory
+   that might fault.  Kills the process if BUFFER is invalid. */
+static void
+write_console (const void *buffer, size_t size)
+{
+  char chunk[CONSOLE_CHUNK];
+
+  while (size > 0)
+    {
+      size_t n = size < sizeof chunk ? size : sizeof chunk;
+      if (!copy_from_user (chunk, buffer, n))
+        thread_exit ();
+      putbuf (chunk, n);
+      buffer = (const char *) buffer + n;
+      size -= n;
+    }
+}
+
+/* Copies the user string USTR, truncated to SIZE - 1 bytes, into
+   a new malloc()'d buffer just big enough for it.  Kills the
+   process if USTR is invalid.  Returns a null pointer if memory
+   is short. */
+static char *
+copy_user_string (const char *ustr, size_t size)
+{
+  int len = strnlen_user (ustr, size);
+  char *copy;
+
+  if (len < 0)
+    thread_exit ();
+  copy = malloc (len + 1);
+  if (copy != NULL && strncpy_from_user (copy, ustr, len + 1) == -1)
+    {
+      free (copy);
+      thread_exit ();
     }
-  if (i == buf_size)
-    dst[--i] = 0;
-  return i;
+  return copy;
+}
+
+/* Reads from FILE into the user buffers in IOV, or writes the
+   buffers to FILE if WRITE is true, at FILE's current position.
+   The bytes that can be transferred before the end of the file,
+   which never grows, are claimed up front by advancing the
+   position past them, so that other threads using FILE meanwhile
+   take the bytes after them; any left untransferred are given
+   back if no other thread has moved the position since.  Returns
+   as file_xfer_at() does. */
+static int
+file_xfer (struct file *file, const struct iovec *iov, int iovcnt,
+           bool write, bool *fault)
+{
+  size_t size = 0;
+  off_t pos, claimed;
+  int n;
+
+  for (int i = 0; i < iovcnt; i++)
+    size += iov[i].iov_len;
+
+  acquire_filesystem_lock ();
+  pos = file_tell (file);
+  claimed = file_length (file) > pos ? file_length (file) - pos : 0;
+  if ((size_t) claimed > size)
+    claimed = size;
+  file_seek (file, pos + claimed);
+  release_filesystem_lock ();
+
+  n = file_xfer_at (file, iov, iovcnt, pos, write, fault);
+  if (n < claimed)
+    {
+      acquire_filesystem_lock ();
+      if (file_tell (file) == pos + claimed)
+        file_seek (file, pos + (n > 0 ? n : 0));
+      release_filesystem_lock ();
+    }
+  return n;
+}
+
+/* Reads from FILE into the user buffers in IOV, or writes the
+   buffers to FILE if WRITE is true, starting at OFFSET, until the
+   buffers are done or the file ends.
+
+   User memory is never handed to the file system, which copies
+   with plain memcpy() and holds the file system lock that page
+   faults take.  Instead, data goes a page at a time through a
+   kernel bounce page, and user memory is copied to or from it
+   with the lock released, so that a buffer that another thread
+   unmaps meanwhile makes only the copy fail.  If it does, sets
+   *FAULT to true and stops; otherwise sets *FAULT to false.
+   Returns the number of bytes transferred, or -1 if memory is
+   short. */
+static int
+file_xfer_at (struct file *file, const struct iovec *iov, int iovcnt,
+              off_t offset, bool write, bool *fault)
+{
+  uint8_t *bounce = palloc_get_page (0);
+  int total = 0;
+
+  *fault = false;
+  if (bounce == NULL)
+    return -1;
+  for (int i = 0; i < iovcnt; i++)
+    {
+      uint8_t *ubuf = iov[i].iov_base;
+      size_t left = iov[i].iov_len;
+
+      while (left > 0)
+        {
+          size_t chunk = left < PGSIZE ? left : PGSIZE;
+          off_t n;
+
+          if (write && !copy_from_user (bounce, ubuf, chunk))
+            goto fault;
+          acquire_filesystem_lock ();
+          n = (write
+               ? file_write_at (file, bounce, chunk, offset)
+               : file_read_at (file, bounce, chunk, offset));
+          release_filesystem_lock ();
+          if (!write && n > 0 && !copy_to_user (ubuf, bounce, n))
+            goto fault;
+
+          total += n;
+          offset += n;
+          if ((size_t) n < chunk)
+            goto done;
+          ubuf += n;
+          left -= n;
+        }
+    }
+  goto done;
+
+ fault:
+  *fault = true;
+ done:
+  palloc_free_page (bounce);
+  return total;
+}
+
+/* Returns true if FD is a pipe end open in the current process,
+   on which positional operations fail rather than being errors
+   that kill the process. */
+static bool
+is_pipe_fd (int fd)
+{
+  struct fd_entry *entry = process_get_fd (fd);
+  bool pipe = entry != NULL && entry->type != FD_FILE;
+  if (entry != NULL)
+    process_put_fd (entry);
+  return pipe;
+}
+
+/* Returns how an operation on pipe end ENTRY should wait: as WAIT
+   says, or not at all if ENTRY is non-blocking. */
+static enum pipe_wait
+pipe_wait_mode (const struct fd_entry *entry, enum pipe_wait wait)
+{
+  return entry->flags & O_NONBLOCK ? PIPE_NOWAIT : wait;
+}
+
+/* Pipe transfer functions.  For the user memory ones, AUX points
+   to the user address, which is advanced past the bytes moved.
+   For the file ones, AUX is the file, whose position advances. */
+
+static int
+xfer_to_user (void *kaddr, size_t size, void *aux)
+{
+  uint8_t **udst = aux;
+  if (!copy_to_user (*udst, kaddr, size))
+    return -1;
+  *udst += size;
+  return size;
+}
+
+static int
+xfer_from_user (void *kaddr, size_t size, void *aux)
+{
+  const uint8_t **usrc = aux;
+  if (!copy_from_user (kaddr, *usrc, size))
+    return -1;
+  *usrc += size;
+  return size;
+}
+
+static int
+xfer_to_console (void *kaddr, size_t size, void *aux UNUSED)
+{
+  putbuf (kaddr, size);
+  return size;
+}
+
+static int
+xfer_to_file (void *kaddr, size_t size, void *file)
+{
+  acquire_filesystem_lock ();
+  int n = file_write (file, kaddr, size);
+  release_filesystem_lock ();
+  return n;
+}
+
+static int
+xfer_from_file (void *kaddr, size_t size, void *file)
+{
+  acquire_filesystem_lock ();
+  int n = file_read (file, kaddr, size);
+  release_filesystem_lock ();
+  return n;
 }
@@ -7,6 +7,9 @@
 
 typedef int pid_t;
 
+struct intr_frame;
+
 void syscall_init (void);
+void syscall_handler (struct intr_frame *);
 
 #endif /* userprog/syscall.h */
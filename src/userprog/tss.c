@@ -75,6 +75,20 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* SYSENTER model-specific registers.
+   See [IA32-v3a] 5.8.7 "Performing Fast Calls to System
+   Procedures with the SYSENTER and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174   /* Kernel code selector. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+wrmsr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -104,3 +118,19 @@ tss_update (void)
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
+
+/* Enables the SYSENTER instruction, which enters the kernel at
+   ENTRY.  SYSENTER_ESP is set once, to point at the TSS's ESP0
+   member, so ENTRY's first instruction can switch to the same
+   kernel stack as an interrupt from user mode would use.  Writing
+   the MSR on every context switch instead would cost a
+   serializing WRMSR each time.  The caller must have checked that
+   the CPU supports SYSENTER. */
+void
+tss_enable_sysenter (void (*entry) (void))
+{
+  ASSERT (tss != NULL);
+  wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+  wrmsr (MSR_SYSENTER_ESP, (uint32_t) &tss->esp0);
+  wrmsr (MSR_SYSENTER_EIP, (uint32_t) entry);
+}
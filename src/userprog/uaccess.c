@@ -0,0 +1,208 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/vaddr.h"
+
+/* An exception table entry.  If the instruction at INSN faults
+   on a user address, execution resumes at FIXUP. */
+struct ex_entry
+  {
+    uintptr_t insn;
+    uintptr_t fixup;
+  };
+
+/* Bounds of the exception table, from the linker script. */
+extern const struct ex_entry _start_ex_table[], _end_ex_table[];
+
+/* Adds an exception table entry for the instruction at label
+   INSN with fixup code at label FIXUP, e.g. EX_ENTRY(1b, 3b). */
+#define EX_ENTRY(INSN, FIXUP)                                   \
+        ".pushsection __ex_table, \"a\"\n\t"                    \
+        ".long " #INSN ", " #FIXUP "\n\t"                       \
+        ".popsection\n\t"
+
+/* Returns true if the SIZE bytes starting at UADDR all lie in
+   user virtual memory. */
+static bool
+is_user_range (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+/* Copies SIZE bytes from SRC to DST, a word at a time and then
+   the remaining bytes.  Either may be in user memory.  Returns
+   true if successful, false if an access faulted. */
+static inline bool
+copy_bytes (void *dst, const void *src, size_t size)
+{
+  size_t left;
+  int edi, esi;
+
+  asm volatile ("1: rep movsl\n\t"
+                "movl %[rest], %%ecx\n"
+                "2: rep movsb\n"
+                "3:\n\t"
+                EX_ENTRY (1b, 3b)
+                EX_ENTRY (2b, 3b)
+                : "=&c" (left), "=&D" (edi), "=&S" (esi)
+                : "0" (size / 4), "1" (dst), "2" (src),
+                  [rest] "rm" (size % 4)
+                : "memory");
+  return left == 0;
+}
+
+/* Copies SIZE bytes from user address USRC to DST.  Returns true
+   if successful, false if USRC is not a valid user range. */
+bool
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  return is_user_range (usrc, size) && copy_bytes (dst, usrc, size);
+}
+
+/* Copies SIZE bytes from SRC to user address UDST.  Returns true
+   if successful, false if UDST is not a valid, writable user
+   range.  Bytes before the invalid part may have been copied. */
+bool
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  return is_user_range (udst, size) && copy_bytes (udst, src, size);
+}
+
+/* Returns the length of the null-terminated string at user
+   address USRC, scanning at most SIZE bytes, which must be
+   nonzero and lie in user memory.  Returns SIZE if there is no
+   null terminator within them, or -1 if an access faults. */
+static int
+user_strnlen (const char *usrc, size_t size)
+{
+  size_t left;
+  const char *end;
+  bool found = false;
+  bool fault = false;
+
+  asm volatile ("1: repne scasb\n\t"
+                "setz %[found]\n\t"
+                "jmp 3f\n"
+                "2: movb $1, %[fault]\n"
+                "3:\n\t"
+                EX_ENTRY (1b, 2b)
+                : "=&c" (left), "=&D" (end),
+                  [found] "+qm" (found), [fault] "+qm" (fault)
+                : "0" (size), "1" (usrc), "a" (0)
+                : "cc");
+  if (fault)
+    return -1;
+  return found ? end - usrc - 1 : (int) size;
+}
+
+/* Returns the length of the null-terminated string at user
+   address USRC, counting at most SIZE - 1 bytes, which is how
+   much of it strncpy_from_user() would copy into a buffer of SIZE
+   bytes.  Returns -1 if USRC is not a valid user string. */
+int
+strnlen_user (const char *usrc, size_t size)
+{
+  size_t max_len;
+  int len;
+
+  ASSERT (size > 0);
+
+  /* Scan no further than the end of user memory. */
+  if (!is_user_vaddr (usrc))
+    return -1;
+  max_len = (const char *) PHYS_BASE - usrc;
+  if (max_len > size)
+    max_len = size;
+
+  len = user_strnlen (usrc, max_len);
+  if (len < 0)
+    return -1;
+  if ((size_t) len == max_len)
+    {
+      /* No terminator in range: if it is because we reached the
+         end of user memory, the string is invalid. */
+      if (max_len < size)
+        return -1;
+      len = size - 1;
+    }
+  return len;
+}
+
+/* Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes, truncating it if
+   necessary.  DST is always null-terminated.  Returns the length
+   of the string copied, or -1 if USRC is not a valid user
+   string. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  int len = strnlen_user (usrc, size);
+
+  if (len < 0 || !copy_bytes (dst, usrc, len))
+    return -1;
+  dst[len] = '\0';
+  return len;
+}
+
+/* Touches one byte in each page of the SIZE bytes at user
+   address UBUF, faulting them in as needed, writing to them
+   without changing them if WRITE is true.  Returns true if every
+   page is accessible, false otherwise. */
+bool
+check_user_buffer (const void *ubuf, size_t size, bool write)
+{
+  const uint8_t *p = ubuf;
+  const uint8_t *last = p + size - 1;
+  bool fault = false;
+
+  if (size == 0)
+    return true;
+  if (!is_user_range (ubuf, size))
+    return false;
+
+  for (;;)
+    {
+      if (write)
+        asm volatile ("1: lock orb $0, %[byte]\n\t"
+                      "jmp 3f\n"
+                      "2: movb $1, %[fault]\n"
+                      "3:\n\t"
+                      EX_ENTRY (1b, 2b)
+                      : [fault] "+qm" (fault)
+                      : [byte] "m" (*p)
+                      : "memory");
+      else
+        asm volatile ("1: cmpb $0, %[byte]\n\t"
+                      "jmp 3f\n"
+                      "2: movb $1, %[fault]\n"
+                      "3:\n\t"
+                      EX_ENTRY (1b, 2b)
+                      : [fault] "+qm" (fault)
+                      : [byte] "m" (*p)
+                      : "cc");
+      if (fault)
+        return false;
+      if (pg_no (p) == pg_no (last))
+        return true;
+      p = pg_round_down (p) + PGSIZE;
+    }
+}
+
+/* Called by the page fault handler for a kernel fault on a user
+   address.  If the faulting instruction has an exception table
+   entry, redirects F to its fixup code and returns true.
+   Otherwise, returns false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct ex_entry *e;
+
+  for (e = _start_ex_table; e < _end_ex_table; e++)
+    if (e->insn == (uintptr_t) f->eip)
+      {
+        f->eip = (void *) e->fixup;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,26 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct intr_frame;
+
+/* Access to user memory from the kernel.
+
+   Each function checks that the user range lies below PHYS_BASE
+   and then simply accesses it.  Pages that are not yet present
+   are brought in by the page fault handler as usual.  If an
+   access faults for good, the page fault handler finds the
+   faulting instruction in the exception table and resumes at its
+   fixup code, which makes the function return failure. */
+
+bool copy_from_user (void *dst, const void *usrc, size_t size);
+bool copy_to_user (void *udst, const void *src, size_t size);
+int strnlen_user (const char *usrc, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+bool check_user_buffer (const void *ubuf, size_t size, bool write);
+
+bool uaccess_fixup (struct intr_frame *);
+
+#endif /* userprog/uaccess.h */
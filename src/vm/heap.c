@@ -0,0 +1,124 @@
+#include "vm/heap.h"
+#include <mman.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+/* The heap is the region from the end of a process's executable
+   up to its break, which the process moves with sbrk().  Pages
+   below the break are added to the supplemental page table as
+   zero pages, so no memory is allocated for them until they are
+   touched.  The process lock keeps its threads from moving the
+   break at the same time. */
+
+static void *sbrk_locked (struct process *, intptr_t increment);
+static void delete_pages (uint8_t *start, uint8_t *end);
+
+/* Starts the current process's heap, empty, at page-aligned
+   address START. */
+void
+heap_init (void *start)
+{
+  struct process *proc = thread_current ()->process;
+  proc->heap_start = proc->heap_brk = start;
+}
+
+/* Moves the current process's break by INCREMENT bytes.  Returns
+   the old break, or (void *) -1 if the new break would lie below
+   the start of the heap or the heap cannot grow that far. */
+void *
+heap_sbrk (intptr_t increment)
+{
+  struct process *proc = thread_current ()->process;
+  void *old_brk;
+
+  lock_acquire (&proc->lock);
+  old_brk = sbrk_locked (proc, increment);
+  lock_release (&proc->lock);
+  return old_brk;
+}
+
+/* Does the work of heap_sbrk() for PROC, whose lock is held. */
+static void *
+sbrk_locked (struct process *proc, intptr_t increment)
+{
+  struct page_table *pt = &proc->page_table;
+  uint8_t *old_brk = proc->heap_brk;
+  uint8_t *new_brk = old_brk + increment;
+  uint8_t *old_top, *new_top, *p;
+
+  if (increment < 0
+      ? new_brk > old_brk || new_brk < (uint8_t *) proc->heap_start
+      : new_brk < old_brk)
+    return (void *) -1;
+
+  old_top = pg_round_up (old_brk);
+  new_top = pg_round_up (new_brk);
+  if (new_top > old_top)
+    {
+      for (p = old_top; p < new_top; p += PGSIZE)
+        if (!available_page (pt, p))
+          return (void *) -1;
+      for (p = old_top; p < new_top; p += PGSIZE)
+        if (!create_zero_page (pt, p, true))
+          {
+            delete_pages (old_top, p);
+            return (void *) -1;
+          }
+    }
+  else
+    delete_pages (new_top, old_top);
+
+  proc->heap_brk = new_brk;
+  return old_brk;
+}
+
+/* Gives the kernel ADVICE about the LENGTH bytes of the current
+   process's heap starting at page-aligned ADDR.  With
+   MADV_DONTNEED, the pages in the range are discarded, freeing
+   their frames or swap slots, and read as zeros when next
+   touched.  Returns 0 if successful, -1 if the range is not
+   within the heap or ADVICE is unknown. */
+int
+heap_madvise (void *addr, size_t length, int advice)
+{
+  struct process *proc = thread_current ()->process;
+  uint8_t *start = addr;
+  uint8_t *end = pg_round_up (start + length);
+  uint8_t *p;
+  int result = -1;
+
+  lock_acquire (&proc->lock);
+  if (pg_ofs (addr) != 0 || start < (uint8_t *) proc->heap_start
+      || end < start || end > (uint8_t *) pg_round_up (proc->heap_brk))
+    goto done;
+
+  switch (advice)
+    {
+    case MADV_NORMAL:
+      result = 0;
+      break;
+
+    case MADV_DONTNEED:
+      for (p = start; p < end; p += PGSIZE)
+        create_zero_page (&proc->page_table, p, true);
+      result = 0;
+      break;
+    }
+
+ done:
+  lock_release (&proc->lock);
+  return result;
+}
+
+/* Removes the current process's pages from START up to END. */
+static void
+delete_pages (uint8_t *start, uint8_t *end)
+{
+  struct page_table *pt = &thread_current ()->process->page_table;
+  uint8_t *p;
+
+  for (p = start; p < end; p += PGSIZE)
+    delete_page (pt, p);
+}
@@ -0,0 +1,11 @@
+#ifndef VM_HEAP_H
+#define VM_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+void heap_init (void *start);
+void *heap_sbrk (intptr_t increment);
+int heap_madvise (void *addr, size_t length, int advice);
+
+#endif /* vm/heap.h */
@@ -10,14 +10,6 @@
 
 #define MAP_FAILED ((mapid_t) -1)
 
-static bool
-compare_mapid (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
-{
-  struct mapped_file *file_a = list_entry (a, struct mapped_file, elem);
-  struct mapped_file *file_b = list_entry (b, struct mapped_file, elem);
-  return file_a->mapid < file_b->mapid;
-}
-
 mapid_t mmap (int fd, void *addr)  {
 
   /* Check validity of inputs */
@@ -25,16 +17,12 @@ mapid_t mmap (int fd, void *addr)  {
     return MAP_FAILED; 
   }
 
-  /* Get file using fd */
+  /* Get file using fd, reopening it before another thread can
+     close it. */
   acquire_filesystem_lock();
   struct file *file = process_get_file(fd);
-  release_filesystem_lock();
-  if (file == NULL) {
-    return MAP_FAILED;
-  }
-
-  acquire_filesystem_lock();
-  file = file_reopen(file);
+  if (file != NULL)
+    file = file_reopen(file);
   release_filesystem_lock();
   if (file == NULL) {
     return MAP_FAILED;
@@ -53,11 +41,14 @@ mapid_t mmap (int fd, void *addr)  {
     page_count++;
   }
   
-  /* Check that the pages required to store the file are all available. */
-  struct thread *current = thread_current();
+  /* Check that the pages required to store the file are all available,
+     holding the process lock so that other threads cannot take them. */
+  struct process *current = thread_current()->process;
   struct page_table *page_table = &current->page_table;
+  lock_acquire (&current->lock);
   for (size_t i = 0; i < page_count; i++) {
     if (!available_page(page_table, addr + PGSIZE * i)) {
+      lock_release (&current->lock);
       return MAP_FAILED;
     }
   }
@@ -66,16 +57,20 @@ mapid_t mmap (int fd, void *addr)  {
   struct mapped_file *new_mapped_file;
   new_mapped_file = (struct mapped_file *) malloc (sizeof(struct mapped_file));
   if (new_mapped_file == NULL) {
+    lock_release (&current->lock);
     return MAP_FAILED;
   }
 
   /* Set initial values for the new mapped file. */
-  struct list_elem *max = list_max (&current->mapped_files, compare_mapid, NULL);
-  mapid_t mapid = (max == list_end (&current->mapped_files))
-                   ? 1
-                   : (list_entry (max, struct mapped_file, elem)->mapid + 1);
-                   
-  list_push_back(&current->mapped_files, &new_mapped_file->elem);
+  mapid_t mapid = idtable_insert (&current->mapped_files, new_mapped_file);
+  if (mapid == MAP_FAILED) {
+    lock_release (&current->lock);
+    free (new_mapped_file);
+    acquire_filesystem_lock();
+    file_close(file);
+    release_filesystem_lock();
+    return MAP_FAILED;
+  }
   new_mapped_file->mapid = mapid;
   new_mapped_file->file = file;
   new_mapped_file->addr = addr;
@@ -94,24 +89,20 @@ mapid_t mmap (int fd, void *addr)  {
     offset += PGSIZE;
     bytes_left -= bytes_to_read;
   }
+  lock_release (&current->lock);
 
   return mapid;
 }
 
 void munmap(mapid_t id) {
-  struct thread *current = thread_current();
-  struct list *mapped_files = &current->mapped_files;
-  struct list_elem *e;
-  struct mapped_file *target_mapped_file = NULL;
-
-  /* Find the mapped file with the same mapid in the list of mapped files. */
-  for (e = list_begin(mapped_files); e != list_end(mapped_files); e = list_next(e)) {
-    struct mapped_file *mf = list_entry(e, struct mapped_file, elem);
-    if (mf->mapid == id) {
-      target_mapped_file = mf;
-      break;
-    }
-  }
+  struct process *current = thread_current()->process;
+
+  /* Find the mapped file with the given mapid, removing it from the
+     process's table of mapped files. */
+  lock_acquire (&current->lock);
+  struct mapped_file *target_mapped_file
+      = idtable_remove (&current->mapped_files, id);
+  lock_release (&current->lock);
 
   /* No mapping found. */
   if (target_mapped_file == NULL) {
@@ -127,9 +118,6 @@ void munmap(mapid_t id) {
   file_close(target_mapped_file->file);
   release_filesystem_lock();
 
-  /* Remove the mapping from the process's list of mapped files. */ 
-  list_remove(&target_mapped_file->elem);
-
   /* Free the resources associated with the mapped file structure. */ 
   free(target_mapped_file);
 }
@@ -16,7 +16,6 @@ struct mapped_file
     struct file *file;      /* File that is being mapped. */
     void *addr;             /* Address of file in user space. */
     size_t page_count;      /* Number of pages in the file. */
-    struct list_elem elem;  /* Used for adding to thread->mapped_files list. */
 };
 
 mapid_t mmap (int fd, void *addr);
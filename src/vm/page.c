@@ -12,6 +12,8 @@
 #include "threads/palloc.h"
 #include "devices/swap.h"
 #include "userprog/process.h"
+#include "filesys/inode.h"
+#include <rusage.h>
 
 static bool compare_pages (const struct hash_elem *elem_a, 
                            const struct hash_elem *elem_b, void *aux);
@@ -23,6 +25,8 @@ static struct page *make_page (struct page_table *page_table,
 static void swap_page_in (struct page *p, struct frame *frame);
 static void swap_page_out (struct page *p, bool dirty);
 static void destroy_page (struct page *p, bool dirty);
+static bool map_cache_page (struct page_table *pt, struct page *p);
+static void count_fault (enum page_type type);
 
 /* Compare the hash uaddr of two pages. */
 static bool
@@ -72,7 +76,7 @@ remove_page (struct hash_elem *elem, void *aux UNUSED)
   if (present_status)
     dirty = pagedir_is_dirty (pd, page->uaddr);
   destroy_page (page, dirty);
-  if (present_status)
+  if (present_status && page->frame != NULL)
     free_frame (page->frame);
   free (page);
 }
@@ -160,7 +164,7 @@ make_page (struct page_table *page_table, void *uaddr, bool init)
     dirty = pagedir_is_dirty (page_table->pd, uaddr);
   }
   destroy_page (page, dirty);
-  if (present_status)
+  if (present_status && page->frame != NULL)
     free_frame (page->frame);
   return page;
 }
@@ -216,6 +220,41 @@ create_zero_page (struct page_table *page_table, void *uaddr, bool writable)
   return true;
 }
 
+/* Maps kernel page KPAGE at the given user address.  The page
+   stays present and is never evicted; freeing KPAGE is left to
+   its owner, which must not do so while it is still mapped. */
+bool
+create_shared_page (struct page_table *page_table, void *uaddr, void *kpage,
+                    bool writable)
+{
+  lock_acquire (&page_table->lock);
+
+  struct page *page = make_page (page_table, uaddr, true);
+  if (page == NULL)
+  {
+    lock_release (&page_table->lock);
+    return false;
+  }
+
+  page->uaddr = uaddr;
+  page->type = SHARED;
+  page->kpage = kpage;
+  page->writable = writable;
+  page->frame = NULL;
+  page->present = pagedir_set_page (page_table->pd, uaddr, kpage, writable);
+  if (!page->present)
+  {
+    hash_delete (&page_table->spt, &page->elem);
+    free (page);
+    lock_release (&page_table->lock);
+    return false;
+  }
+
+  lock_release (&page_table->lock);
+
+  return true;
+}
+
 /* Deletes the page at the given user address from the page table. */
 bool
 delete_page (struct page_table *page_table, void *uaddr)
@@ -261,6 +300,23 @@ already_mapped (struct page_table *page_table, void *uaddr)
   return page != NULL;
 }
 
+/* Returns the kernel address of the byte at UADDR if it lies in a
+   SHARED page, whose memory stays put for as long as the page is
+   mapped and which other page tables may map too.  Returns a null
+   pointer for other pages. */
+void *
+shared_kaddr (struct page_table *pt, const void *uaddr)
+{
+  void *kaddr = NULL;
+
+  lock_acquire (&pt->lock);
+  struct page *page = search_pt (pt, pg_round_down (uaddr));
+  if (page != NULL && page->type == SHARED)
+    kaddr = (uint8_t *) page->kpage + pg_ofs (uaddr);
+  lock_release (&pt->lock);
+  return kaddr;
+}
+
 /* Returns true if uaddr is within the stack. */
 bool
 in_stack (void *uaddr)
@@ -272,6 +328,19 @@ in_stack (void *uaddr)
 bool
 load_page (struct page_table *pt, void *uaddr)
 {
+  /* Memory mapped files share the page cache's copy of their
+     data when it has room. */
+  lock_acquire (&pt->lock);
+  struct page *cached = search_pt (pt, uaddr);
+  if (cached != NULL && !cached->present && cached->type == FILE
+      && cached->write_back && map_cache_page (pt, cached))
+  {
+    lock_release (&pt->lock);
+    count_fault (FILE);
+    return true;
+  }
+  lock_release (&pt->lock);
+
   acquire_frame_table_lock ();
   lock_acquire (&pt->lock);
 
@@ -334,6 +403,7 @@ load_page (struct page_table *pt, void *uaddr)
   }
 
   /* Swap the page into the frame and set dirty and accessed bits to false. */
+  count_fault (page->type);
   swap_page_in (page, frame);
   pagedir_set_page (pt->pd, uaddr, frame->page_phys_addr, page->writable);
   pagedir_set_dirty (pt->pd, uaddr, false);
@@ -343,6 +413,63 @@ load_page (struct page_table *pt, void *uaddr)
   return true;
 }
 
+/* Maps the page cache page holding P's file data at P's user
+   address, without a frame.  Returns false if the page cache
+   cannot provide one. */
+static bool
+map_cache_page (struct page_table *pt, struct page *p)
+{
+  struct inode *inode = file_get_inode (p->file);
+
+  acquire_filesystem_lock ();
+  void *kpage = inode_map_page (inode, p->offset);
+  release_filesystem_lock ();
+  if (kpage == NULL)
+    return false;
+
+  if (!pagedir_set_page (pt->pd, p->uaddr, kpage, p->writable))
+  {
+    acquire_filesystem_lock ();
+    inode_unmap_page (inode, p->offset, false);
+    release_filesystem_lock ();
+    return false;
+  }
+  pagedir_set_dirty (pt->pd, p->uaddr, false);
+  pagedir_set_accessed (pt->pd, p->uaddr, false);
+
+  p->present = true;
+  p->frame = NULL;
+  return true;
+}
+
+/* Charges the current thread with a fault that brings in a page
+   of the given TYPE. */
+static void
+count_fault (enum page_type type)
+{
+  struct rusage *ru = thread_rusage ();
+  if (ru == NULL)
+    return;
+
+  switch (type)
+  {
+    case ZERO:
+      ru->zero_faults++;
+      break;
+
+    case FILE:
+      ru->file_faults++;
+      break;
+
+    case SWAP:
+      ru->swap_faults++;
+      break;
+
+    case SHARED:
+      break;
+  }
+}
+
 /* Load data from the page's address and set present to true. */
 static void
 swap_page_in (struct page *p, struct frame *frame)
@@ -366,6 +493,9 @@ swap_page_in (struct page *p, struct frame *frame)
     case SWAP:
       swap_in (p->frame->page_phys_addr, p->slot);
       break;
+
+    case SHARED:
+      NOT_REACHED ();
   }
 }
 
@@ -403,6 +533,9 @@ swap_page_out (struct page *p, bool dirty)
         p->slot = swap_out (p->frame->page_phys_addr);
       }
       break;
+
+    case SHARED:
+      NOT_REACHED ();
   }
 }
 
@@ -413,6 +546,7 @@ destroy_page (struct page *p, bool dirty)
   switch (p->type)
   {
     case ZERO:
+    case SHARED:
       break;
 
     case SWAP:
@@ -421,7 +555,14 @@ destroy_page (struct page *p, bool dirty)
       break;
 
     case FILE:
-      if (p->present && dirty && p->write_back)
+      if (p->present && p->frame == NULL)
+      {
+        /* Hand the page and its dirty bit back to the cache. */
+        acquire_filesystem_lock ();
+        inode_unmap_page (file_get_inode (p->file), p->offset, dirty);
+        release_filesystem_lock ();
+      }
+      else if (p->present && dirty && p->write_back)
       {
         acquire_filesystem_lock ();
         file_write_at (p->file, p->frame->page_phys_addr, p->length, p->offset);
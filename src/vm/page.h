@@ -13,7 +13,8 @@ enum page_type
 {
   FILE,
   SWAP,
-  ZERO
+  ZERO,
+  SHARED
 };
 
 /* One page for the supplemental page table. */
@@ -27,9 +28,10 @@ struct page
   enum page_type type;        /* Type of file being paged. */
   bool present;               /* Flags if page can be accessed. */
   bool write_back;            /* Flags if page can write back. */
-  struct frame *frame;        /* Frame struct. */
+  struct frame *frame;        /* Frame struct, null if a page cache page. */
   off_t length;               /* Length of segment. */
   size_t slot;                /* Swap slot. */
+  void *kpage;                /* Kernel page mapped by a SHARED page. */
 };
 
 struct page_table
@@ -45,11 +47,14 @@ void free_pt (struct page_table *page_table);
 bool create_file_page (struct page_table *page_table, void *uaddr, struct file *id, off_t offset,
                        uint32_t length, bool writable, bool write_back);
 bool create_zero_page (struct page_table *page_table, void *uaddr, bool writable);
+bool create_shared_page (struct page_table *page_table, void *uaddr, void *kpage,
+                         bool writable);
 bool delete_page (struct page_table *page_table, void *uaddr);
 bool available_page (struct page_table *page_table, void *uaddr);
 void activate_pt (struct page_table *page_table);
 bool already_mapped (struct page_table *page_table, void *uaddr);
 bool in_stack (void *uaddr);
 bool load_page (struct page_table *pt, void *uaddr);
+void *shared_kaddr (struct page_table *pt, const void *uaddr);
 
 #endif
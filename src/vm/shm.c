@@ -0,0 +1,359 @@
+#include "vm/shm.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "devices/swap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+/* Shared memory objects.
+
+   A shared memory object is a named run of anonymous pages that
+   any process may attach at an address of its choosing, mapping
+   the very same kernel pages as SHARED pages in every attaching
+   page table, so that data written by one process is seen by the
+   others without copying.
+
+   Pages are allocated, zeroed, from the user pool when the object
+   is first attached, and no more than SHM_PAGES_MAX of them are in
+   memory at once.  While attached anywhere, an object stays in
+   memory.  Once its
+   last attachment goes, an object that still has a name is
+   swapped out as a unit, and swapped back in by the next attach;
+   an object with no name is freed.  shm_remove() takes away the
+   name, so the object disappears once no process has it
+   attached. */
+
+/* A shared memory object. */
+struct shm_object
+  {
+    struct list_elem elem;          /* Element in OBJECTS, while named. */
+    char name[SHM_NAME_MAX + 1];    /* Name. */
+    bool named;                     /* Still in OBJECTS? */
+    int attach_cnt;                 /* Attachments in all processes. */
+    size_t page_cnt;                /* Size in pages. */
+    void **kpages;                  /* Pages, if RESIDENT. */
+    size_t *slots;                  /* Swap slots, if SWAPPED. */
+    bool resident;                  /* Pages are in memory. */
+    bool swapped;                   /* Pages are in swap. */
+  };
+
+/* An attachment of an object in a process. */
+struct shm_map
+  {
+    struct list_elem elem;          /* Element in process's SHM_MAPS. */
+    struct shm_object *object;      /* Attached object. */
+    void *addr;                     /* User address of first page. */
+  };
+
+/* Named objects, and the lock for every object. */
+static struct list objects;
+static struct lock shm_lock;
+
+/* Pages of all resident objects, at most SHM_PAGES_MAX. */
+static size_t resident_pages;
+
+static struct shm_object *lookup (const char *name);
+static bool make_resident (struct shm_object *);
+static void settle (struct shm_object *);
+static void swap_out_object (struct shm_object *);
+static void free_pages (struct shm_object *);
+
+/* Initializes the table of shared memory objects. */
+void
+shm_init (void)
+{
+  list_init (&objects);
+  lock_init (&shm_lock);
+}
+
+/* Creates a shared memory object called NAME of SIZE bytes,
+   rounded up to whole pages.  Returns true if successful, false
+   if NAME is taken or invalid, SIZE is 0 or too big, or memory is
+   short. */
+bool
+shm_create (const char *name, size_t size)
+{
+  struct shm_object *obj;
+  size_t name_len = strlen (name);
+
+  if (name_len == 0 || name_len > SHM_NAME_MAX
+      || size == 0 || size > SHM_SIZE_MAX)
+    return false;
+
+  obj = calloc (1, sizeof *obj);
+  if (obj == NULL)
+    return false;
+  strlcpy (obj->name, name, sizeof obj->name);
+  obj->named = true;
+  obj->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  obj->kpages = calloc (obj->page_cnt, sizeof *obj->kpages);
+  obj->slots = calloc (obj->page_cnt, sizeof *obj->slots);
+  if (obj->kpages == NULL || obj->slots == NULL)
+    goto fail;
+
+  lock_acquire (&shm_lock);
+  if (lookup (name) != NULL)
+    {
+      lock_release (&shm_lock);
+      goto fail;
+    }
+  list_push_back (&objects, &obj->elem);
+  lock_release (&shm_lock);
+  return true;
+
+ fail:
+  free (obj->slots);
+  free (obj->kpages);
+  free (obj);
+  return false;
+}
+
+/* Removes the name of the shared memory object called NAME.  The
+   object lives on until it is no longer attached anywhere.
+   Returns true if successful, false if there is no such
+   object. */
+bool
+shm_remove (const char *name)
+{
+  struct shm_object *obj;
+
+  lock_acquire (&shm_lock);
+  obj = lookup (name);
+  if (obj != NULL)
+    {
+      list_remove (&obj->elem);
+      obj->named = false;
+      settle (obj);
+    }
+  lock_release (&shm_lock);
+  return obj != NULL;
+}
+
+/* Attaches the shared memory object called NAME to the current
+   process at page-aligned user address ADDR.  Returns ADDR if
+   successful, or a null pointer if there is no such object, its
+   pages would overlap others, or memory is short. */
+void *
+shm_attach (const char *name, void *addr)
+{
+  struct process *proc = thread_current ()->process;
+  struct page_table *pt = &proc->page_table;
+  struct shm_object *obj;
+  struct shm_map *map = NULL;
+  void *result = NULL;
+  size_t i;
+
+  if (addr == NULL || pg_ofs (addr) != 0)
+    return NULL;
+
+  /* The process lock keeps other threads from mapping the same
+     pages meanwhile. */
+  lock_acquire (&proc->lock);
+  lock_acquire (&shm_lock);
+  obj = lookup (name);
+  if (obj == NULL)
+    goto done;
+  for (i = 0; i < obj->page_cnt; i++)
+    if (!available_page (pt, (uint8_t *) addr + i * PGSIZE))
+      break;
+  if (i < obj->page_cnt)
+    goto done;
+
+  map = malloc (sizeof *map);
+  if (map == NULL || !make_resident (obj))
+    goto done;
+  for (i = 0; i < obj->page_cnt; i++)
+    if (!create_shared_page (pt, (uint8_t *) addr + i * PGSIZE,
+                             obj->kpages[i], true))
+      break;
+  if (i < obj->page_cnt)
+    {
+      while (i-- > 0)
+        delete_page (pt, (uint8_t *) addr + i * PGSIZE);
+      settle (obj);
+      goto done;
+    }
+
+  obj->attach_cnt++;
+  map->object = obj;
+  map->addr = addr;
+  list_push_back (&proc->shm_maps, &map->elem);
+  result = addr;
+
+ done:
+  lock_release (&shm_lock);
+  lock_release (&proc->lock);
+  if (result == NULL)
+    free (map);
+  return result;
+}
+
+/* Detaches the shared memory object attached at ADDR in the
+   current process.  Returns true if successful, false if no
+   object is attached there. */
+bool
+shm_detach (void *addr)
+{
+  struct process *proc = thread_current ()->process;
+  struct shm_map *map = NULL;
+  struct list_elem *e;
+  size_t i;
+
+  lock_acquire (&proc->lock);
+  for (e = list_begin (&proc->shm_maps); e != list_end (&proc->shm_maps);
+       e = list_next (e))
+    if (list_entry (e, struct shm_map, elem)->addr == addr)
+      {
+        map = list_entry (e, struct shm_map, elem);
+        list_remove (e);
+        break;
+      }
+  if (map != NULL)
+    for (i = 0; i < map->object->page_cnt; i++)
+      delete_page (&proc->page_table, (uint8_t *) addr + i * PGSIZE);
+  lock_release (&proc->lock);
+  if (map == NULL)
+    return false;
+
+  lock_acquire (&shm_lock);
+  map->object->attach_cnt--;
+  settle (map->object);
+  lock_release (&shm_lock);
+  free (map);
+  return true;
+}
+
+/* Detaches every object attached to PROC, whose last thread is
+   exiting.  Must be called after PROC's page table is gone. */
+void
+shm_exit (struct process *proc)
+{
+  while (!list_empty (&proc->shm_maps))
+    {
+      struct shm_map *map = list_entry (list_pop_front (&proc->shm_maps),
+                                        struct shm_map, elem);
+      lock_acquire (&shm_lock);
+      map->object->attach_cnt--;
+      settle (map->object);
+      lock_release (&shm_lock);
+      free (map);
+    }
+}
+
+/* Returns the named object called NAME, or a null pointer if
+   there is none. */
+static struct shm_object *
+lookup (const char *name)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&objects); e != list_end (&objects);
+       e = list_next (e))
+    {
+      struct shm_object *obj = list_entry (e, struct shm_object, elem);
+      if (!strcmp (obj->name, name))
+        return obj;
+    }
+  return NULL;
+}
+
+/* Brings OBJ's pages into memory, allocating them zeroed the
+   first time.  Returns false if memory is short or OBJ would take
+   shared memory past SHM_PAGES_MAX pages. */
+static bool
+make_resident (struct shm_object *obj)
+{
+  size_t i;
+
+  if (obj->resident)
+    return true;
+  if (obj->page_cnt > SHM_PAGES_MAX - resident_pages)
+    return false;
+  for (i = 0; i < obj->page_cnt; i++)
+    {
+      obj->kpages[i] = palloc_get_page (PAL_USER
+                                        | (obj->swapped ? 0 : PAL_ZERO));
+      if (obj->kpages[i] == NULL)
+        {
+          while (i-- > 0)
+            palloc_free_page (obj->kpages[i]);
+          return false;
+        }
+    }
+  if (obj->swapped)
+    for (i = 0; i < obj->page_cnt; i++)
+      swap_in (obj->kpages[i], obj->slots[i]);
+  obj->swapped = false;
+  obj->resident = true;
+  resident_pages += obj->page_cnt;
+  return true;
+}
+
+/* Frees OBJ if it is neither attached nor named, or swaps it out
+   if it is only named. */
+static void
+settle (struct shm_object *obj)
+{
+  if (obj->attach_cnt > 0)
+    return;
+  if (obj->named)
+    {
+      if (obj->resident)
+        swap_out_object (obj);
+      return;
+    }
+
+  if (obj->swapped)
+    {
+      size_t i;
+      for (i = 0; i < obj->page_cnt; i++)
+        swap_drop (obj->slots[i]);
+    }
+  free_pages (obj);
+  free (obj->slots);
+  free (obj->kpages);
+  free (obj);
+}
+
+/* Writes OBJ's pages to swap and frees them.  If swap is full,
+   OBJ stays in memory. */
+static void
+swap_out_object (struct shm_object *obj)
+{
+  size_t i;
+
+  for (i = 0; i < obj->page_cnt; i++)
+    {
+      obj->slots[i] = swap_out (obj->kpages[i]);
+      if (obj->slots[i] == BITMAP_ERROR)
+        {
+          while (i-- > 0)
+            swap_drop (obj->slots[i]);
+          return;
+        }
+    }
+  free_pages (obj);
+  obj->swapped = true;
+}
+
+/* Frees OBJ's pages, if they are in memory. */
+static void
+free_pages (struct shm_object *obj)
+{
+  size_t i;
+
+  if (!obj->resident)
+    return;
+  for (i = 0; i < obj->page_cnt; i++)
+    palloc_free_page (obj->kpages[i]);
+  obj->resident = false;
+  resident_pages -= obj->page_cnt;
+}
@@ -0,0 +1,26 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Longest name of a shared memory object. */
+#define SHM_NAME_MAX 31
+
+/* Largest shared memory object, in bytes. */
+#define SHM_SIZE_MAX (1024 * 1024)
+
+/* Most pages that all shared memory objects together may keep in
+   memory at once. */
+#define SHM_PAGES_MAX 512
+
+struct process;
+
+void shm_init (void);
+bool shm_create (const char *name, size_t size);
+bool shm_remove (const char *name);
+void *shm_attach (const char *name, void *addr);
+bool shm_detach (void *addr);
+void shm_exit (struct process *);
+
+#endif /* vm/shm.h */